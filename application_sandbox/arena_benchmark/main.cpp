@@ -0,0 +1,410 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "support/entry/entry.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+namespace {
+// Every trace starts out with an arena of this size, and grows if needed.
+const ::VkDeviceSize kArenaSize = 64 * 1024 * 1024;
+// The number of allocations that may be live at the same time.
+const uint32_t kMaxLiveAllocations = 4096;
+// The number of allocate/free operations in every trace.
+const uint32_t kNumOperations = 400000;
+// The number of times each trace is replayed, the fastest run is reported.
+const uint32_t kNumRuns = 5;
+// The number of allocations that each thread of the multithreaded
+// benchmark may keep alive at the same time.
+const uint32_t kMaxLiveAllocationsPerThread = 512;
+
+struct TraceOperation {
+  bool allocate;
+  uint32_t slot;
+  ::VkDeviceSize size;
+  ::VkDeviceSize alignment;
+};
+
+using Trace = containers::vector<TraceOperation>;
+
+// A tiny deterministic generator, so that every strategy replays
+// exactly the same trace.
+class Random {
+ public:
+  Random() : state_(0x1234567u) {}
+  uint32_t Next() {
+    state_ = state_ * 1664525u + 1013904223u;
+    return state_ >> 8;
+  }
+  // Returns a size between 64 bytes and 64 KiB, biased towards small
+  // sizes.
+  ::VkDeviceSize NextSize() {
+    const uint32_t log2 = 6 + Next() % 11;
+    return (::VkDeviceSize(1) << log2) + Next() % (1u << log2);
+  }
+  ::VkDeviceSize NextAlignment() { return ::VkDeviceSize(1) << (Next() % 9); }
+
+ private:
+  uint32_t state_;
+};
+
+// Allocates and frees in random order, keeping at most max_live
+// allocations alive.
+Trace RandomTrace(containers::Allocator* allocator, uint32_t max_live) {
+  Trace trace(allocator);
+  containers::vector<bool> live(max_live, false, allocator);
+  Random random;
+  for (uint32_t i = 0; i < kNumOperations; ++i) {
+    const uint32_t slot = random.Next() % max_live;
+    trace.push_back({!live[slot], slot, random.NextSize(),
+                     random.NextAlignment()});
+    live[slot] = !live[slot];
+  }
+  for (uint32_t slot = 0; slot < max_live; ++slot) {
+    if (live[slot]) {
+      trace.push_back({false, slot, 0, 0});
+    }
+  }
+  return trace;
+}
+
+Trace RandomTrace(containers::Allocator* allocator) {
+  return RandomTrace(allocator, kMaxLiveAllocations);
+}
+
+// Frees allocations in the same order that they were made.
+Trace FifoTrace(containers::Allocator* allocator) {
+  Trace trace(allocator);
+  Random random;
+  uint32_t head = 0;
+  uint32_t tail = 0;
+  for (uint32_t i = 0; i < kNumOperations; ++i) {
+    const bool full = head - tail == kMaxLiveAllocations;
+    const bool empty = head == tail;
+    if (!full && (empty || random.Next() % 2)) {
+      trace.push_back({true, head++ % kMaxLiveAllocations, random.NextSize(),
+                       random.NextAlignment()});
+    } else {
+      trace.push_back({false, tail++ % kMaxLiveAllocations, 0, 0});
+    }
+  }
+  while (tail != head) {
+    trace.push_back({false, tail++ % kMaxLiveAllocations, 0, 0});
+  }
+  return trace;
+}
+
+// Allocates kMaxLiveAllocations blocks and then frees all of them, over
+// and over.
+Trace FrameTrace(containers::Allocator* allocator) {
+  Trace trace(allocator);
+  Random random;
+  while (trace.size() < kNumOperations) {
+    for (uint32_t slot = 0; slot < kMaxLiveAllocations; ++slot) {
+      trace.push_back(
+          {true, slot, random.NextSize(), random.NextAlignment()});
+    }
+    for (uint32_t slot = 0; slot < kMaxLiveAllocations; ++slot) {
+      trace.push_back({false, slot, 0, 0});
+    }
+  }
+  return trace;
+}
+
+// Fills a new arena with equally sized allocations, frees them so that
+// every free range has to be coalesced with its neighbours, and checks that
+// the arena is left with a single free range. This is done twice, so that
+// the second round allocates out of the coalesced range, and would hand out
+// the same memory twice if a stale free range had been left behind.
+void CheckCoalescing(const entry::EntryData* data, vulkan::VkDevice* device,
+                     uint32_t memory_index,
+                     vulkan::VulkanArenaStrategy strategy) {
+  const uint32_t kNumAllocations = 64;
+  const ::VkDeviceSize kAllocationSize = kArenaSize / kNumAllocations;
+  vulkan::VulkanArena arena(data->allocator(), data->logger(), kArenaSize,
+                            memory_index, device, false, 0, 0,
+                            vulkan::VulkanArenaGrowthPolicy(), strategy);
+  containers::vector<vulkan::AllocationToken*> tokens(
+      kNumAllocations, nullptr, data->allocator());
+  containers::vector<::VkDeviceSize> offsets(kNumAllocations, 0,
+                                             data->allocator());
+  ::VkDeviceMemory memory;
+  for (uint32_t round = 0; round < 2; ++round) {
+    for (uint32_t i = 0; i < kNumAllocations; ++i) {
+      tokens[i] = arena.AllocateMemory(kAllocationSize, 1, &memory,
+                                       &offsets[i], nullptr);
+    }
+    LOG_ASSERT(==, data->logger(), 1u, arena.num_blocks());
+    std::sort(offsets.begin(), offsets.end());
+    for (uint32_t i = 0; i < kNumAllocations; ++i) {
+      LOG_ASSERT(==, data->logger(), i * kAllocationSize, offsets[i]);
+    }
+
+    // Free every other allocation first, so that each of the rest is
+    // coalesced with the free ranges on both sides of it.
+    for (uint32_t first = 0; first < 2; ++first) {
+      for (uint32_t i = 1 - first; i < kNumAllocations; i += 2) {
+        arena.FreeMemory(tokens[i]);
+      }
+    }
+    vulkan::VulkanArenaStats stats;
+    arena.GetStats(&stats);
+    LOG_ASSERT(==, data->logger(), 1u, stats.num_free_ranges);
+    LOG_ASSERT(==, data->logger(), kArenaSize, stats.largest_free_range);
+  }
+}
+
+// Fills the device-only arena of the application with movable buffers,
+// frees every other one, and defragments the arena. Checks that the buffers
+// that are left kept their contents, wherever they were moved, and that the
+// largest free range did not shrink.
+void CheckDefragmentation(const entry::EntryData* data,
+                          vulkan::VulkanApplication* app) {
+  const uint32_t kNumBuffers = 32;
+  const ::VkDeviceSize kBufferSize = 16 * 1024;
+  VkBufferCreateInfo create_info{
+      /* sType = */ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      /* pNext = */ nullptr,
+      /* flags = */ 0,
+      /* size = */ kBufferSize,
+      /* usage = */ VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      /* sharingMode = */ VK_SHARING_MODE_EXCLUSIVE,
+      /* queueFamilyIndexCount = */ 0,
+      /* pQueueFamilyIndices = */ nullptr,
+  };
+  containers::vector<containers::unique_ptr<vulkan::VulkanApplication::Buffer>>
+      buffers(data->allocator());
+  for (uint32_t i = 0; i < kNumBuffers; ++i) {
+    buffers.push_back(app->CreateAndBindDeviceBuffer(&create_info));
+    app->MarkMovable(buffers.back().get(), &create_info);
+  }
+
+  // Give every buffer that is kept its own contents.
+  vulkan::VkCommandBuffer fill_command_buffer = app->GetCommandBuffer();
+  app->BeginCommandBuffer(&fill_command_buffer);
+  for (uint32_t i = 1; i < kNumBuffers; i += 2) {
+    fill_command_buffer->vkCmdFillBuffer(fill_command_buffer, *buffers[i], 0,
+                                         VK_WHOLE_SIZE, i);
+  }
+  LOG_ASSERT(==, data->logger(), VK_SUCCESS,
+             app->EndAndSubmitCommandBufferAndWaitForQueueIdle(
+                 &fill_command_buffer, &app->render_queue()));
+  for (uint32_t i = 0; i < kNumBuffers; i += 2) {
+    buffers[i].reset();
+  }
+
+  vulkan::VulkanApplication::DefragmentationStats stats;
+  vulkan::VkCommandBuffer command_buffer = app->GetCommandBuffer();
+  app->BeginCommandBuffer(&command_buffer);
+  app->DefragmentDeviceMemory(&command_buffer, kNumBuffers * kBufferSize,
+                              &stats);
+
+  // Read the buffers back from where they are now.
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> readback =
+      app->CreateAndBindDefaultExclusiveHostBuffer(
+          kNumBuffers / 2 * kBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  for (uint32_t i = 1; i < kNumBuffers; i += 2) {
+    VkBufferCopy region{0, i / 2 * kBufferSize, kBufferSize};
+    command_buffer->vkCmdCopyBuffer(command_buffer, *buffers[i], *readback, 1,
+                                    &region);
+  }
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
+                          VK_ACCESS_TRANSFER_WRITE_BIT,
+                          VK_ACCESS_HOST_READ_BIT};
+  command_buffer->vkCmdPipelineBarrier(
+      command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+  LOG_ASSERT(==, data->logger(), VK_SUCCESS,
+             app->EndAndSubmitCommandBufferAndWaitForQueueIdle(
+                 &command_buffer, &app->render_queue()));
+  app->FinishDefragmentation(&stats);
+
+  readback->invalidate();
+  const uint32_t* values =
+      reinterpret_cast<const uint32_t*>(readback->base_address());
+  const ::VkDeviceSize values_per_buffer = kBufferSize / sizeof(uint32_t);
+  for (uint32_t i = 1; i < kNumBuffers; i += 2) {
+    for (::VkDeviceSize j = 0; j < values_per_buffer; ++j) {
+      LOG_ASSERT(==, data->logger(), i, values[i / 2 * values_per_buffer + j]);
+    }
+  }
+  LOG_ASSERT(>=, data->logger(), stats.largest_free_range_after,
+             stats.largest_free_range_before);
+  data->logger()->LogInfo("Defragmentation moved ", stats.allocations_moved,
+                          " buffers, ", stats.bytes_moved,
+                          " bytes, largest free range ",
+                          stats.largest_free_range_before, " -> ",
+                          stats.largest_free_range_after, " bytes, ",
+                          stats.bytes_released, " bytes released");
+}
+
+// Replays the trace against a new arena using the given strategy and
+// returns the average number of nanoseconds per operation. Sets
+// *steady_state_root_allocations to the number of times the arena went to
+// the root allocator for its bookkeeping after the first run.
+double ReplayTrace(const entry::EntryData* data, vulkan::VkDevice* device,
+                   uint32_t memory_index, vulkan::VulkanArenaStrategy strategy,
+                   const Trace& trace,
+                   uint64_t* steady_state_root_allocations) {
+  vulkan::VulkanArena arena(data->allocator(), data->logger(), kArenaSize,
+                            memory_index, device, false, 0, 0,
+                            vulkan::VulkanArenaGrowthPolicy(), strategy);
+  containers::vector<vulkan::AllocationToken*> tokens(
+      kMaxLiveAllocations, nullptr, data->allocator());
+  ::VkDeviceMemory memory;
+  ::VkDeviceSize offset;
+
+  double best = 0.0;
+  uint64_t warm_root_allocations = 0;
+  for (uint32_t run = 0; run < kNumRuns; ++run) {
+    if (run == 1) {
+      warm_root_allocations = arena.bookkeeping_root_allocations();
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const TraceOperation& operation : trace) {
+      if (operation.allocate) {
+        tokens[operation.slot] =
+            arena.AllocateMemory(operation.size, operation.alignment, &memory,
+                                 &offset, nullptr);
+      } else {
+        arena.FreeMemory(tokens[operation.slot]);
+        tokens[operation.slot] = nullptr;
+      }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    const double nanoseconds_per_operation =
+        std::chrono::duration<double, std::nano>(end - start).count() /
+        trace.size();
+    if (run == 0 || nanoseconds_per_operation < best) {
+      best = nanoseconds_per_operation;
+    }
+  }
+  *steady_state_root_allocations =
+      arena.bookkeeping_root_allocations() - warm_root_allocations;
+  return best;
+}
+
+// Replays the trace on num_threads threads at the same time, all sharing a
+// single arena, and returns the total number of operations per second.
+double ReplayTraceOnThreads(const entry::EntryData* data,
+                            vulkan::VkDevice* device, uint32_t memory_index,
+                            bool thread_caches, uint32_t num_threads,
+                            const Trace& trace) {
+  vulkan::VulkanArena arena(data->allocator(), data->logger(), kArenaSize,
+                            memory_index, device, false, 0, 0,
+                            vulkan::VulkanArenaGrowthPolicy(),
+                            vulkan::VulkanArenaStrategy::kTLSF, thread_caches);
+
+  auto replay = [&arena, &trace, data]() {
+    containers::vector<vulkan::AllocationToken*> tokens(
+        kMaxLiveAllocationsPerThread, nullptr, data->allocator());
+    ::VkDeviceMemory memory;
+    ::VkDeviceSize offset;
+    for (const TraceOperation& operation : trace) {
+      if (operation.allocate) {
+        tokens[operation.slot] =
+            arena.AllocateMemory(operation.size, operation.alignment, &memory,
+                                 &offset, nullptr);
+      } else {
+        arena.FreeMemory(tokens[operation.slot]);
+        tokens[operation.slot] = nullptr;
+      }
+    }
+  };
+
+  containers::vector<std::thread> threads(data->allocator());
+  auto start = std::chrono::high_resolution_clock::now();
+  for (uint32_t i = 0; i < num_threads; ++i) {
+    threads.push_back(std::thread(replay));
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  const double seconds = std::chrono::duration<double>(end - start).count();
+  return static_cast<double>(trace.size()) * num_threads / seconds;
+}
+}  // anonymous namespace
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  vulkan::VulkanApplication app(data->allocator(), data->logger(), data,
+                                vulkan::VulkanApplicationOptions());
+  vulkan::VkDevice& device = app.device();
+
+  const uint32_t memory_index =
+      vulkan::GetMemoryIndex(&device, data->logger(), 0xFFFFFFFF,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  struct {
+    const char* name;
+    Trace (*generate)(containers::Allocator*);
+  } traces[] = {
+      {"random", &RandomTrace},
+      {"fifo", &FifoTrace},
+      {"frame", &FrameTrace},
+  };
+  struct {
+    const char* name;
+    vulkan::VulkanArenaStrategy strategy;
+  } strategies[] = {
+      {"ordered_map", vulkan::VulkanArenaStrategy::kOrderedMap},
+      {"tlsf", vulkan::VulkanArenaStrategy::kTLSF},
+  };
+
+  for (auto& strategy_info : strategies) {
+    CheckCoalescing(data, &device, memory_index, strategy_info.strategy);
+  }
+  CheckDefragmentation(data, &app);
+
+  for (auto& trace_info : traces) {
+    Trace trace = trace_info.generate(data->allocator());
+    for (auto& strategy_info : strategies) {
+      uint64_t root_allocations;
+      const double nanoseconds =
+          ReplayTrace(data, &device, memory_index, strategy_info.strategy,
+                      trace, &root_allocations);
+      data->logger()->LogInfo(trace_info.name, " trace, ", strategy_info.name,
+                              ": ", nanoseconds, " ns per operation, ",
+                              root_allocations,
+                              " root allocations after warm-up");
+    }
+  }
+
+  // Every thread replays the same trace against one shared arena. With the
+  // thread caches, most operations never touch the central lock, so the
+  // throughput should keep growing with the number of threads.
+  Trace thread_trace =
+      RandomTrace(data->allocator(), kMaxLiveAllocationsPerThread);
+  const uint32_t thread_counts[] = {1, 2, 4, 8};
+  for (bool thread_caches : {false, true}) {
+    for (uint32_t num_threads : thread_counts) {
+      const double operations_per_second =
+          ReplayTraceOnThreads(data, &device, memory_index, thread_caches,
+                               num_threads, thread_trace);
+      data->logger()->LogInfo(
+          num_threads, " threads, ",
+          thread_caches ? "thread caches: " : "central lock: ",
+          operations_per_second / 1000000.0, " million operations per second");
+    }
+  }
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
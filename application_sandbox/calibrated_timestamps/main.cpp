@@ -313,8 +313,10 @@ class CalibratedTimestampsSample
     frame_count_++;
 
     if (frame_count_ % 60 == 0) {
+      // The scratch memory comes from the frame allocator, so that taking
+      // the timestamps does not allocate once the frames are warmed up.
       containers::vector<VkCalibratedTimestampInfoEXT> timestamp_infos(
-          time_domains_.size(), {}, data_->allocator());
+          time_domains_.size(), {}, frame_allocator());
       for (uint32_t i = 0; i < time_domains_.size(); i++) {
         timestamp_infos[i].sType =
             VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
@@ -322,9 +324,9 @@ class CalibratedTimestampsSample
         timestamp_infos[i].timeDomain = time_domains_[i];
       }
       containers::vector<uint64_t> timestamps(time_domains_.size(), 0,
-                                              data_->allocator());
+                                              frame_allocator());
       containers::vector<uint64_t> max_deviation(time_domains_.size(), 0,
-                                                 data_->allocator());
+                                                 frame_allocator());
 
       VkResult result = app()->device()->vkGetCalibratedTimestampsEXT(
           app()->device(), static_cast<uint32_t>(time_domains_.size()),
@@ -100,8 +100,8 @@ class ComputeTask {
     std::chrono::duration<float> time_since_last_notify =
         current_time - last_notify_time_;
     if (time_since_last_notify.count() > 1.0f) {
-      app_->GetLogger()->LogInfo("Simulated ", simulation_count_, " steps in ",
-                                 time_since_last_notify.count(), "s.");
+      LOG_INFO(app_->GetLogger(), "Simulated ", simulation_count_,
+               " steps in ", time_since_last_notify.count(), "s.");
       last_notify_time_ = current_time;
       simulation_count_ = 0;
     }
@@ -667,8 +667,8 @@ class ComputeParticlesSample
     time_since_last_notify_ += delta_time;
     frames_since_last_notify_ += 1;
     if (time_since_last_notify_ > 1.0f) {
-      app()->GetLogger()->LogInfo("Rendered ", frames_since_last_notify_,
-                                  " frames in ", time_since_last_notify_, "s.");
+      LOG_INFO(app()->GetLogger(), "Rendered ", frames_since_last_notify_,
+               " frames in ", time_since_last_notify_, "s.");
       frames_since_last_notify_ = 0;
       time_since_last_notify_ = 0;
     }
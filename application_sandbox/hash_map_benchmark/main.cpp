@@ -0,0 +1,208 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+
+#include "support/containers/allocator.h"
+#include "support/containers/flat_hash_map.h"
+#include "support/containers/unordered_map.h"
+#include "support/containers/vector.h"
+#include "support/entry/entry.h"
+
+namespace {
+// The number of keys in the lookup workload, one for each queue family.
+const uint32_t kNumLookupKeys = 4;
+const uint32_t kNumLookups = 10000000;
+// The number of bindings that are counted in every run of the count
+// workload, spread over kNumCountKeys descriptor types.
+const uint32_t kNumCountBindings = 6;
+const uint32_t kNumCountKeys = 4;
+const uint32_t kNumCounts = 1000000;
+// The number of distinct keys in the random workload.
+const uint32_t kNumRandomKeys = 200000;
+// The number of times each workload is run, the fastest run is reported.
+const uint32_t kNumRuns = 5;
+
+// A tiny deterministic generator, so that every map sees exactly the same
+// keys.
+class Random {
+ public:
+  Random() : state_(0x1234567u) {}
+  uint32_t Next() {
+    state_ = state_ * 1664525u + 1013904223u;
+    return state_ >> 8;
+  }
+
+ private:
+  uint32_t state_;
+};
+
+struct Result {
+  double nanoseconds_per_operation;
+  // The number of allocations made by the fastest run.
+  uint64_t allocations;
+  // Depends on every operation, so that none of them can be optimized away.
+  uint64_t checksum;
+};
+
+// Runs workload kNumRuns times, and returns the fastest run. workload
+// returns the number of operations it did.
+template <typename Workload>
+Result Measure(containers::Allocator* allocator, const Workload& workload) {
+  Result result = {0.0, 0, 0};
+  for (uint32_t run = 0; run < kNumRuns; ++run) {
+    containers::CountingAllocator counter(allocator);
+    uint64_t checksum = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    const uint64_t operations = workload(&counter, &checksum);
+    auto end = std::chrono::high_resolution_clock::now();
+    const double nanoseconds_per_operation =
+        std::chrono::duration<double, std::nano>(end - start).count() /
+        operations;
+    if (run == 0 || nanoseconds_per_operation <
+                        result.nanoseconds_per_operation) {
+      result.nanoseconds_per_operation = nanoseconds_per_operation;
+      result.allocations = counter.num_allocations();
+    }
+    result.checksum = checksum;
+  }
+  return result;
+}
+
+// Looks up a handful of keys over and over.
+template <typename Map>
+uint64_t Lookup(containers::Allocator* allocator, uint64_t* checksum) {
+  Map map(allocator);
+  for (uint32_t i = 0; i < kNumLookupKeys; ++i) {
+    map[i] = i + 1;
+  }
+  for (uint32_t i = 0; i < kNumLookups; ++i) {
+    auto it = map.find(i % kNumLookupKeys);
+    if (it != map.end()) {
+      *checksum += it->second;
+    }
+  }
+  return kNumLookups;
+}
+
+// Builds a small map of counts, iterates over it and destroys it.
+template <typename Map>
+uint64_t Count(containers::Allocator* allocator, uint64_t* checksum) {
+  for (uint32_t i = 0; i < kNumCounts; ++i) {
+    Map map(allocator);
+    for (uint32_t binding = 0; binding < kNumCountBindings; ++binding) {
+      map[(i + binding) % kNumCountKeys] += binding + 1;
+    }
+    for (auto& count : map) {
+      *checksum += count.first * count.second;
+    }
+  }
+  return kNumCounts;
+}
+
+// Inserts random keys, looks up every key along with as many keys that
+// are not in the map, then erases every key.
+template <typename Map>
+uint64_t RandomKeys(containers::Allocator* allocator, uint64_t* checksum) {
+  Map map(allocator);
+  Random random;
+  containers::vector<uint32_t> keys(allocator);
+  keys.reserve(kNumRandomKeys);
+  for (uint32_t i = 0; i < kNumRandomKeys; ++i) {
+    // Even keys are inserted, odd keys are never in the map.
+    keys.push_back(random.Next() & ~1u);
+  }
+  for (uint32_t key : keys) {
+    map[key] += 1;
+  }
+  for (uint32_t key : keys) {
+    auto hit = map.find(key);
+    if (hit != map.end()) {
+      *checksum += hit->second;
+    }
+    *checksum += map.find(key | 1) == map.end();
+  }
+  for (uint32_t key : keys) {
+    *checksum += map.erase(key);
+  }
+  return 4 * static_cast<uint64_t>(kNumRandomKeys);
+}
+
+// Makes every key collide.
+struct ConstantHash {
+  size_t operator()(uint32_t) const { return 0; }
+};
+
+// Checks that flat_hash_map keeps working when so many keys share a hash
+// that their run is longer than 255 slots.
+void CheckCollisions(const entry::EntryData* data) {
+  const uint32_t kNumCollidingKeys = 1000;
+  containers::flat_hash_map<uint32_t, uint32_t, ConstantHash> map(
+      data->allocator());
+  for (uint32_t i = 0; i < kNumCollidingKeys; ++i) {
+    map[i] = i + 1;
+  }
+  LOG_ASSERT(==, data->logger(), kNumCollidingKeys, map.size());
+  for (uint32_t i = 0; i < kNumCollidingKeys; i += 2) {
+    LOG_ASSERT(==, data->logger(), 1u, map.erase(i));
+  }
+  for (uint32_t i = 0; i < kNumCollidingKeys; ++i) {
+    auto it = map.find(i);
+    if (i % 2) {
+      LOG_ASSERT(==, data->logger(), true, it != map.end());
+      LOG_ASSERT(==, data->logger(), i + 1, it->second);
+    } else {
+      LOG_ASSERT(==, data->logger(), true, it == map.end());
+    }
+  }
+}
+
+typedef containers::unordered_map<uint32_t, uint32_t> StdMap;
+typedef containers::flat_hash_map<uint32_t, uint32_t> FlatMap;
+}  // anonymous namespace
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  CheckCollisions(data);
+
+  struct {
+    const char* name;
+    uint64_t (*std_map)(containers::Allocator*, uint64_t*);
+    uint64_t (*flat_map)(containers::Allocator*, uint64_t*);
+  } workloads[] = {
+      {"lookup", &Lookup<StdMap>, &Lookup<FlatMap>},
+      {"count", &Count<StdMap>, &Count<FlatMap>},
+      {"random", &RandomKeys<StdMap>, &RandomKeys<FlatMap>},
+  };
+
+  for (auto& workload : workloads) {
+    const Result std_result = Measure(data->allocator(), workload.std_map);
+    const Result flat_result = Measure(data->allocator(), workload.flat_map);
+    if (std_result.checksum != flat_result.checksum) {
+      data->logger()->LogError(workload.name,
+                               " workload: the maps gave different results");
+    }
+    data->logger()->LogInfo(
+        workload.name, " workload, unordered_map: ",
+        std_result.nanoseconds_per_operation, " ns per operation, ",
+        std_result.allocations, " allocations");
+    data->logger()->LogInfo(
+        workload.name, " workload, flat_hash_map: ",
+        flat_result.nanoseconds_per_operation, " ns per operation, ",
+        flat_result.allocations, " allocations");
+  }
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
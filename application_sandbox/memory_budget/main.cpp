@@ -53,7 +53,10 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
       : data_(data),
         Sample<CubeFrameData>(
             data->allocator(), data, 1, 512, 1, 1,
-            sample_application::SampleOptions().EnableMultisampling(), {0},
+            sample_application::SampleOptions()
+                .EnableMultisampling()
+                .EnableMemoryBudget(),
+            {0},
             {VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME},
             {VK_EXT_MEMORY_BUDGET_EXTENSION_NAME}),
         cube_(data->allocator(), data->logger(), cube_data) {}
@@ -169,6 +172,22 @@ class CubeSample : public sample_application::Sample<CubeFrameData> {
       app()->GetLogger()->LogInfo("HeapUsage:  ",
                                   memory_budget_properties.heapUsage[i]);
     }
+
+    // The arenas of the application are sized from the same budget, let us
+    // know when they get close to using it up.
+    vulkan::VulkanMemoryBudget* budget = app()->memory_budget();
+    if (budget) {
+      budget->SetHighWaterMarks({0.75f, 0.9f}, &OnHighWaterMark, this);
+    }
+  }
+
+  static void OnHighWaterMark(void* user_data, uint32_t heap_index,
+                              float mark, ::VkDeviceSize usage,
+                              ::VkDeviceSize budget) {
+    CubeSample* sample = static_cast<CubeSample*>(user_data);
+    sample->data_->logger()->LogInfo("Heap ", heap_index, " is above ",
+                                     mark * 100.0f, "% of its budget: ",
+                                     usage, " of ", budget, " bytes used");
   }
 
   virtual void InitializeFrameData(
@@ -18,7 +18,9 @@
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <utility>
 
+#include "support/containers/frame_allocator.h"
 #include "support/entry/entry.h"
 #include "vulkan_helpers/helper_functions.h"
 #include "vulkan_helpers/vulkan_application.h"
@@ -45,12 +47,14 @@ struct SampleOptions {
   bool sparse_binding = false;
   bool protected_memory = false;
   bool host_query_reset = false;
+  bool memory_budget = false;
   bool extended_swapchain_color_space = false;
   bool shared_presentation = false;
   bool mutable_swapchain_format = false;
   bool enable_display_timing = false;
   bool enable_10bit_hdr = false;
   bool use_high_precision_depth = false;
+  bool transient_attachments = false;
   void* device_extension_structures = nullptr;
   // The default value of zero means there is no application
   // enforced minimum and the number of swapchains images
@@ -95,6 +99,10 @@ struct SampleOptions {
     host_query_reset = true;
     return *this;
   }
+  SampleOptions& EnableMemoryBudget() {
+    memory_budget = true;
+    return *this;
+  }
   SampleOptions& EnableExtendedSwapchainColorSpace() {
     extended_swapchain_color_space = true;
     return *this;
@@ -119,6 +127,13 @@ struct SampleOptions {
     use_high_precision_depth = true;
     return *this;
   }
+  // Creates the depth buffer as a transient attachment, so that it can live
+  // in lazily allocated memory. The depth image can then not be used as a
+  // transfer destination, or be loaded or stored by a render pass.
+  SampleOptions& EnableTransientAttachments() {
+    transient_attachments = true;
+    return *this;
+  }
   SampleOptions& AddDeviceExtensionStructure(void* device_extension_structure) {
     device_extension_structures = device_extension_structure;
     return *this;
@@ -171,12 +186,14 @@ vulkan::VulkanApplicationOptions buildVulkanApplicationOptions(
   ret.SetHostBufferSize(host_buffer_size_in_MB * 1024 * 1024)
       .SetDeviceImageSize(image_memory_size_in_MB * 1024 * 1024)
       .SetDeviceBufferSize(device_buffer_size_in_MB * 1024 * 1024)
-      .SetCoherentBufferSize(coherent_buffer_size_in_MB * 1024 * 1024);
+      .SetCoherentBufferSize(coherent_buffer_size_in_MB * 1024 * 1024)
+      .EnableTransientHostRing();
 
   if (options.async_compute) ret.EnableAsyncComputeQueue();
   if (options.sparse_binding) ret.EnableSparseBinding();
   if (options.protected_memory) ret.EnableProtectedMemory();
   if (options.host_query_reset) ret.EnableHostQueryReset();
+  if (options.memory_budget) ret.EnableMemoryBudget();
   if (options.shared_presentation) ret.EnableSharedPresentation();
   if (options.enable_10bit_hdr) ret.Enable10BitHDR();
   if (options.mutable_swapchain_format) ret.EnableMutableSwapchainFormat();
@@ -250,11 +267,13 @@ class Sample {
                 host_buffer_size_in_MB, image_memory_size_in_MB,
                 device_buffer_size_in_MB, coherent_buffer_size_in_MB, options),
             instance_extensions, device_extensions, physical_device_features),
+        frame_allocator_(allocator),
         frame_data_(allocator),
         swapchain_images_(application_.swapchain_images()),
         last_frame_time_(std::chrono::high_resolution_clock::now()),
         initialization_command_buffer_(application_.GetCommandBuffer()),
         average_frame_time_(0),
+        frame_number_(0),
         is_valid_(true) {
     if (data_->fixed_timestep()) {
       app()->GetLogger()->LogInfo("Running with a fixed timestep of 0.1s");
@@ -334,6 +353,8 @@ class Sample {
       InitializeLocalFrameData(&frame_data_.back(),
                                &initialization_command_buffer_, i);
     }
+    acquire_semaphore_ = containers::make_unique<vulkan::VkSemaphore>(
+        allocator_, vulkan::CreateSemaphore(&application_.device()));
 
     initialization_command_buffer_->vkEndCommandBuffer(
         initialization_command_buffer_);
@@ -385,6 +406,10 @@ class Sample {
   vulkan::VulkanApplication* app() { return &application_; }
   const vulkan::VulkanApplication* app() const { return &application_; }
 
+  // An allocator for scratch memory that only lives until the end of the
+  // current frame. It is reset at the start of every ProcessFrame.
+  containers::FrameAllocator* frame_allocator() { return &frame_allocator_; }
+
   const VkViewport& viewport() const { return default_viewport_; }
   const VkRect2D& scissor() const { return default_scissor_; }
 
@@ -393,6 +418,11 @@ class Sample {
   // application. Render() is used to actually process the commands
   // for rendering this particular frame.
   void ProcessFrame() {
+    const containers::CountingAllocator* allocation_counter =
+        data_->allocation_counter();
+    const uint64_t allocations_before =
+        allocation_counter ? allocation_counter->num_allocations() : 0;
+    frame_allocator_.Reset();
     auto current_time = std::chrono::high_resolution_clock::now();
     std::chrono::duration<float> elapsed_time = current_time - last_frame_time_;
     last_frame_time_ = current_time;
@@ -408,20 +438,20 @@ class Sample {
     static uint32_t present_id = 0;
 
     if (options_.enable_display_timing) {
-      VkResult res = app()->instance()->vkGetRefreshCycleDurationGOOGLE(
+      VkResult res = app()->device()->vkGetRefreshCycleDurationGOOGLE(
           app()->device(), app()->swapchain(), &rc_dur);
 
       VkPastPresentationTimingGOOGLE past[256] = {};
       uint32_t count = 0;
 
-      res = app()->instance()->vkGetPastPresentationTimingGOOGLE(
+      res = app()->device()->vkGetPastPresentationTimingGOOGLE(
           app()->device(), app()->swapchain(), &count, nullptr);
 
       if (count) {
         static unsigned early_frame_count = 0;
         static uint32_t last_late_frame_id = 0;
         bool increase_refresh_multiplier = false;
-        res = app()->instance()->vkGetPastPresentationTimingGOOGLE(
+        res = app()->device()->vkGetPastPresentationTimingGOOGLE(
             app()->device(), app()->swapchain(), &count, &past[0]);
 
         for (uint32_t i = 0; i < count; ++i) {
@@ -473,16 +503,13 @@ class Sample {
 
     uint32_t image_idx;
 
-    // This is a bit weird as we have to make new semaphores every frame, but
-    // for now this will do. It will get cleaned up the next time
-    // this image is used.
-    vulkan::VkSemaphore temp_semaphore =
-        vulkan::CreateSemaphore(&app()->device());
-
+    // We do not know which image we will get until it has been acquired, so
+    // the acquire signals the spare semaphore, which is then swapped with
+    // the semaphore of the image below.
     LOG_ASSERT(==, app()->GetLogger(), VK_SUCCESS,
                app()->device()->vkAcquireNextImageKHR(
                    app()->device(), app()->swapchain(), 0xFFFFFFFFFFFFFFFF,
-                   temp_semaphore.get_raw_object(),
+                   *acquire_semaphore_,
                    static_cast<::VkFence>(VK_NULL_HANDLE), &image_idx));
 
     ::VkFence ready_fence = *frame_data_[image_idx].ready_fence_;
@@ -491,18 +518,21 @@ class Sample {
         ==, app()->GetLogger(), VK_SUCCESS,
         app()->device()->vkWaitForFences(app()->device(), 1, &ready_fence,
                                          VK_FALSE, 0xFFFFFFFFFFFFFFFF));
+    // Everything that the last use of this fence waited for is done, so the
+    // transient memory from that frame can be reused.
+    application_.RetireTransientFrames(ready_fence);
     LOG_ASSERT(
         ==, app()->GetLogger(), VK_SUCCESS,
         app()->device()->vkResetFences(app()->device(), 1, &ready_fence));
     if (options_.verbose_output) {
-      app()->GetLogger()->LogInfo("Rendering frame <", elapsed_time.count(),
-                                  ">: <", image_idx, ">", " Average: <",
-                                  average_frame_time_, ">");
+      LOG_INFO(app()->GetLogger(), "Rendering frame <", elapsed_time.count(),
+               ">: <", image_idx, ">", " Average: <", average_frame_time_,
+               ">");
     }
 
-    frame_data_[image_idx].ready_semaphore_ =
-        containers::make_unique<vulkan::VkSemaphore>(allocator_,
-                                                     std::move(temp_semaphore));
+    // The last submission that waited on the old semaphore of this image is
+    // done, now that its fence has signaled, so it becomes the spare.
+    std::swap(acquire_semaphore_, frame_data_[image_idx].ready_semaphore_);
     ::VkSemaphore ready_semaphore = *frame_data_[image_idx].ready_semaphore_;
 
     ::VkSemaphore render_wait_semaphore = ready_semaphore;
@@ -564,6 +594,7 @@ class Sample {
 
     app()->render_queue()->vkQueueSubmit(
         app()->render_queue(), 1, &init_submit_info, ::VkFence(ready_fence));
+    application_.EndTransientFrame(ready_fence);
 
     if (application_.HasSeparatePresentQueue()) {
       ::VkSemaphore transfer_semaphore =
@@ -618,6 +649,12 @@ class Sample {
                app()->present_queue()->vkQueuePresentKHR(app()->present_queue(),
                                                          &present_info),
                VK_SUCCESS);
+
+    if (allocation_counter) {
+      CheckFrameAllocations(allocation_counter->num_allocations() -
+                            allocations_before);
+    }
+    ++frame_number_;
   }
 
   void set_invalid(bool invaid) { is_valid_ = false; }
@@ -657,6 +694,17 @@ class Sample {
   }
 
  private:
+  // Reports the given number of allocations that the current frame made,
+  // once every swapchain image has been used twice, and the sample has had
+  // the chance to allocate everything that it reuses.
+  void CheckFrameAllocations(uint64_t num_allocations) {
+    if (num_allocations == 0 || frame_number_ < 2 * frame_data_.size()) {
+      return;
+    }
+    app()->GetLogger()->LogError("Frame ", frame_number_, " made ",
+                                 num_allocations, " allocations");
+  }
+
   // This will be called during Initialize(). The application is expected
   // to initialize any frame-specific data that it needs.
   virtual void InitializeFrameData(
@@ -749,6 +797,11 @@ class Sample {
       if (options_.enable_mixed_multisampling) {
         image_create_info.samples = num_depth_stencil_samples_;
       }
+      if (options_.transient_attachments) {
+        image_create_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                  VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+                                  VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+      }
 
       data->depth_stencil_ =
           application_.CreateAndBindImage(&image_create_info);
@@ -768,6 +821,8 @@ class Sample {
     }
 
     if (options_.enable_multisampling && !options_.enable_mixed_multisampling) {
+      // The multisampled target is resolved with vkCmdResolveImage, which
+      // needs TRANSFER_SRC, so it cannot be a transient attachment.
       image_create_info.format = render_target_format_;
       image_create_info.usage =
           VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
@@ -1015,6 +1070,8 @@ class Sample {
   // The VulkanApplication that we build on, we want this to be the
   // last thing deleted, it goes at the top.
   vulkan::VulkanApplication application_;
+  // Scratch memory for the current frame, see frame_allocator().
+  containers::FrameAllocator frame_allocator_;
 
   // This contains one SampleFrameData per swapchain image. It will be used
   // to render frames to the appropriate swapchains
@@ -1042,6 +1099,10 @@ class Sample {
   vulkan::VkCommandBuffer initialization_command_buffer_;
   // The exponentially smoothed average frame time.
   float average_frame_time_;
+  // The semaphore that the next swapchain image acquire signals.
+  containers::unique_ptr<vulkan::VkSemaphore> acquire_semaphore_;
+  // The number of frames that have been processed.
+  uint64_t frame_number_;
   // If this is set to false, the application cannot be safely run.
   bool is_valid_;
   // The format used for depth stencil attachment.
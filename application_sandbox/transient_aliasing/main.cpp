@@ -0,0 +1,139 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "support/entry/entry.h"
+#include "vulkan_helpers/aliased_image_allocator.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+namespace {
+const char* kPassNames[] = {"gbuffer", "lighting", "bloom_down",
+                            "bloom_blur", "tonemap"};
+const uint32_t kNumPasses = sizeof(kPassNames) / sizeof(kPassNames[0]);
+
+struct TransientImage {
+  const char* name;
+  VkFormat format;
+  // The image is 1 / divisor of the size of the swapchain in each
+  // dimension.
+  uint32_t divisor;
+  uint32_t first_pass;
+  uint32_t last_pass;
+};
+
+const TransientImage kImages[] = {
+    {"albedo", VK_FORMAT_R8G8B8A8_UNORM, 1, 0, 1},
+    {"normal", VK_FORMAT_R16G16B16A16_SFLOAT, 1, 0, 1},
+    {"hdr", VK_FORMAT_R16G16B16A16_SFLOAT, 1, 1, 4},
+    {"bloom", VK_FORMAT_R16G16B16A16_SFLOAT, 2, 2, 3},
+    {"bloom_blur", VK_FORMAT_R16G16B16A16_SFLOAT, 2, 3, 4},
+    {"ldr", VK_FORMAT_R8G8B8A8_UNORM, 1, 4, 4},
+};
+const uint32_t kNumImages = sizeof(kImages) / sizeof(kImages[0]);
+}  // anonymous namespace
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  vulkan::VulkanApplication app(data->allocator(), data->logger(), data,
+                                vulkan::VulkanApplicationOptions());
+  vulkan::VkDevice& device = app.device();
+
+  vulkan::AliasedImageAllocator aliased_images(data->allocator(),
+                                               data->logger(), &device);
+  uint32_t indices[kNumImages];
+  for (uint32_t i = 0; i < kNumImages; ++i) {
+    VkImageCreateInfo create_info{
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+        nullptr,                              // pNext
+        0,                                    // flags
+        VK_IMAGE_TYPE_2D,                     // imageType
+        kImages[i].format,                    // format
+        {
+            app.swapchain().width() / kImages[i].divisor,   // width
+            app.swapchain().height() / kImages[i].divisor,  // height
+            1                                               // depth
+        },
+        1,                        // mipLevels
+        1,                        // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,    // samples
+        VK_IMAGE_TILING_OPTIMAL,  // tiling
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT,  // usage
+        VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+        0,                                    // queueFamilyIndexCount
+        nullptr,                              // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+    };
+    indices[i] = aliased_images.AddImage(
+        create_info, kImages[i].first_pass, kImages[i].last_pass,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  }
+  aliased_images.Allocate();
+
+  for (uint32_t i = 0; i < kNumImages; ++i) {
+    data->logger()->LogInfo(
+        kImages[i].name, ": passes ", kPassNames[kImages[i].first_pass], " to ",
+        kPassNames[kImages[i].last_pass],
+        aliased_images.is_aliased(indices[i]) ? ", aliased" : ", not aliased");
+  }
+  data->logger()->LogInfo("Separate allocations: ",
+                          aliased_images.separate_size(), " bytes");
+  data->logger()->LogInfo("Aliased allocation:   ",
+                          aliased_images.aliased_size(), " bytes");
+  data->logger()->LogInfo("Saved:                ",
+                          aliased_images.saved_size(), " bytes");
+
+  // Every pass writes the images that it starts using. The clears stand in
+  // for the rendering that a real frame would do.
+  vulkan::VkCommandBuffer cmd = app.GetCommandBuffer();
+  VkCommandBufferBeginInfo begin_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // sType
+      nullptr,                                      // pNext
+      VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // flags
+      nullptr                                       // pInheritanceInfo
+  };
+  cmd->vkBeginCommandBuffer(cmd, &begin_info);
+  VkClearColorValue clear_color{{0.0f, 0.0f, 0.0f, 1.0f}};
+  VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  for (uint32_t pass = 0; pass < kNumPasses; ++pass) {
+    aliased_images.RecordAliasingBarriers(&cmd, pass);
+    for (uint32_t i = 0; i < kNumImages; ++i) {
+      if (kImages[i].first_pass != pass) {
+        continue;
+      }
+      cmd->vkCmdClearColorImage(cmd, aliased_images.image(indices[i]),
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                &clear_color, 1, &range);
+    }
+  }
+  cmd->vkEndCommandBuffer(cmd);
+
+  VkSubmitInfo submit_info{
+      VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+      nullptr,                        // pNext
+      0,                              // waitSemaphoreCount
+      nullptr,                        // pWaitSemaphores
+      nullptr,                        // pWaitDstStageMask,
+      1,                              // commandBufferCount
+      &cmd.get_command_buffer(),      // pCommandBuffers
+      0,                              // signalSemaphoreCount
+      nullptr                         // pSignalSemaphores
+  };
+  app.render_queue()->vkQueueSubmit(app.render_queue(), 1, &submit_info,
+                                    static_cast<VkFence>(VK_NULL_HANDLE));
+  app.render_queue()->vkQueueWaitIdle(app.render_queue());
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -47,4 +47,13 @@ endif()
 set(CMAKE_CXX_STANDARD 11)
 set(CMAKE_CXX_STANDARD_REQUIRED ON)
 
+# Times every call through the Vulkan function tables, see
+# vulkan_wrapper/call_stats.h. Samples record the calls with
+# -vulkan-call-stats.
+option(VULKAN_CALL_PROFILING
+  "Should calls to Vulkan functions be counted and timed" OFF)
+if (VULKAN_CALL_PROFILING)
+  add_definitions(-DVULKAN_CALL_PROFILING)
+endif()
+
 include(${CMAKE_CURRENT_LIST_DIR}/build_apk.cmake)
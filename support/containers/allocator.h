@@ -17,11 +17,17 @@
 #define SUPPORT_CONTAINERS_ALLOCATOR_H_
 
 #include <assert.h>
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
-#include <map>
+#include <mutex>
+#include <string>
 #include <utility>
 
+#include "support/containers/stack_trace.h"
+
 namespace containers {
 struct Allocator {
   virtual void* malloc(size_t val) = 0;
@@ -88,6 +94,27 @@ struct LeakCheckAllocator : public Allocator {
   std::atomic<uint64_t> total_number_of_allocations_;
 };
 
+// This allocator passes every request on to its root allocator, and counts
+// the number of allocations that are made through it.
+struct CountingAllocator : public Allocator {
+  CountingAllocator(Allocator* root) : root_(root), num_allocations_(0) {}
+
+  void* malloc(size_t val) override {
+    num_allocations_.fetch_add(1, std::memory_order_relaxed);
+    return root_->malloc(val);
+  }
+
+  void free(void* val, size_t bytes) override { root_->free(val, bytes); }
+
+  uint64_t num_allocations() const {
+    return num_allocations_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  Allocator* root_;
+  std::atomic<uint64_t> num_allocations_;
+};
+
 #define RELEASE_ASSERT(x)                              \
   do {                                                 \
     if (!(x)) {                                          \
@@ -95,22 +122,311 @@ struct LeakCheckAllocator : public Allocator {
     }                                                  \
   } while (false)
 
+namespace internal {
+// An open-addressed hash table from pointers to Entry, which must be a
+// plain struct whose first member is the void* key. A key of nullptr marks
+// an empty entry. The memory for the table comes straight from ::malloc,
+// so that it does not show up in the allocator that is being checked.
+template <typename Entry>
+class PointerHashTable {
+ public:
+  PointerHashTable() : entries_(nullptr), capacity_(0), size_(0) {}
+  ~PointerHashTable() { ::free(entries_); }
+
+  PointerHashTable(const PointerHashTable&) = delete;
+  PointerHashTable& operator=(const PointerHashTable&) = delete;
+
+  static uint64_t Hash(const void* key) {
+    uint64_t hash = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key));
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return hash;
+  }
+
+  // Returns the entry for the given key, or nullptr if there is none.
+  Entry* Find(const void* key) {
+    if (size_ == 0) {
+      return nullptr;
+    }
+    const size_t mask = capacity_ - 1;
+    for (size_t i = Hash(key) & mask;; i = (i + 1) & mask) {
+      if (entries_[i].key == key) {
+        return &entries_[i];
+      }
+      if (!entries_[i].key) {
+        return nullptr;
+      }
+    }
+  }
+
+  // Returns the entry for the given key, adding a zeroed entry if there is
+  // none. Pointers to entries are invalidated by Insert and Erase.
+  Entry* Insert(void* key) {
+    if ((size_ + 1) * 2 > capacity_) {
+      Grow();
+    }
+    const size_t mask = capacity_ - 1;
+    for (size_t i = Hash(key) & mask;; i = (i + 1) & mask) {
+      if (entries_[i].key == key) {
+        return &entries_[i];
+      }
+      if (!entries_[i].key) {
+        entries_[i] = Entry();
+        entries_[i].key = key;
+        ++size_;
+        return &entries_[i];
+      }
+    }
+  }
+
+  // Removes the given entry, and moves back the entries that follow it so
+  // that no lookup has to step over a hole.
+  void Erase(Entry* entry) {
+    const size_t mask = capacity_ - 1;
+    size_t hole = static_cast<size_t>(entry - entries_);
+    for (size_t i = (hole + 1) & mask; entries_[i].key; i = (i + 1) & mask) {
+      const size_t home = Hash(entries_[i].key) & mask;
+      // The entry at i can only move into the hole if the hole is
+      // between its home and i.
+      const bool stays =
+          hole <= i ? (hole < home && home <= i) : (hole < home || home <= i);
+      if (!stays) {
+        entries_[hole] = entries_[i];
+        hole = i;
+      }
+    }
+    entries_[hole] = Entry();
+    --size_;
+  }
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  // Returns the entry at the given index, which may be empty.
+  const Entry& at(size_t index) const { return entries_[index]; }
+
+ private:
+  void Grow() {
+    Entry* old_entries = entries_;
+    const size_t old_capacity = capacity_;
+    capacity_ = capacity_ ? capacity_ * 2 : 64;
+    entries_ = static_cast<Entry*>(::malloc(capacity_ * sizeof(Entry)));
+    for (size_t i = 0; i < capacity_; ++i) {
+      entries_[i] = Entry();
+    }
+    size_ = 0;
+    for (size_t i = 0; i < old_capacity; ++i) {
+      if (old_entries[i].key) {
+        *Insert(old_entries[i].key) = old_entries[i];
+      }
+    }
+    ::free(old_entries);
+  }
+
+  Entry* entries_;
+  size_t capacity_;
+  size_t size_;
+};
+}  // namespace internal
+
+// This allocator checks that every free is given the same size as the
+// malloc that it frees, and crashes if it is not, or if the pointer was
+// not allocated by this allocator.
+// The allocations are kept in hash tables that are split into shards by
+// pointer, each with its own lock, so this allocator is thread-safe and
+// threads rarely wait on each other.
+// If track_callsites is set, the bytes that are allocated are also counted
+// per call stack of malloc, and the call stacks of any memory that is still
+// allocated are written to stderr when this allocator is destroyed. Every
+// malloc then unwinds the stack, which makes allocations much slower.
 struct CheckedAllocator : public Allocator {
-  CheckedAllocator(Allocator* _alloc) : m_root_allocator(_alloc) {}
+  CheckedAllocator(Allocator* _alloc, bool track_callsites = false)
+      : m_root_allocator(_alloc), m_track_callsites(track_callsites) {}
+
+  ~CheckedAllocator() {
+    if (m_track_callsites && num_allocations() != 0) {
+      WriteCallsiteReport(stderr, true);
+    }
+  }
+
   void* malloc(size_t val) override {
+    void* frames[kCallsiteFrames];
+    uint32_t num_frames = 0;
+    void* callsite = nullptr;
+    if (m_track_callsites) {
+      num_frames = internal::CaptureStack(frames, kCallsiteFrames, 0);
+      callsite = CallsiteKey(frames, num_frames);
+    }
     void* ret_val = m_root_allocator->malloc(val);
-    m_allocations[ret_val] = val;
+    Shard& shard = GetShard(ret_val);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    AllocationRecord* record = shard.allocations.Insert(ret_val);
+    record->size = val;
+    record->callsite = callsite;
+    if (callsite) {
+      CallsiteRecord* site = shard.callsites.Insert(callsite);
+      if (site->total_allocations == 0) {
+        std::copy(frames, frames + num_frames, site->frames);
+        site->num_frames = num_frames;
+      }
+      site->live_bytes += val;
+      site->live_allocations += 1;
+      site->total_bytes += val;
+      site->total_allocations += 1;
+    }
     return ret_val;
   }
 
   void free(void* val, size_t bytes) override {
-    RELEASE_ASSERT(m_allocations[val] == bytes);
-    m_allocations.erase(val);
+    {
+      Shard& shard = GetShard(val);
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      AllocationRecord* record = shard.allocations.Find(val);
+      RELEASE_ASSERT(record != nullptr && record->size == bytes);
+      if (record->callsite) {
+        CallsiteRecord* site = shard.callsites.Find(record->callsite);
+        site->live_bytes -= bytes;
+        site->live_allocations -= 1;
+      }
+      shard.allocations.Erase(record);
+    }
     return m_root_allocator->free(val, bytes);
   }
 
-  std::map<void*, size_t> m_allocations;
+  // Returns the number of allocations that have not been freed yet.
+  uint64_t num_allocations() {
+    uint64_t count = 0;
+    for (auto& shard : m_shards) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      count += shard.allocations.size();
+    }
+    return count;
+  }
+
+  // Writes the bytes allocated from every call site to the given file,
+  // largest first. If leaks_only is set, only call sites that still have
+  // memory allocated are written. Only available with track_callsites.
+  void WriteCallsiteReport(std::FILE* file, bool leaks_only) {
+    internal::PointerHashTable<CallsiteRecord> merged;
+    for (auto& shard : m_shards) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (size_t i = 0; i < shard.callsites.capacity(); ++i) {
+        const CallsiteRecord& site = shard.callsites.at(i);
+        if (!site.key || (leaks_only && site.live_allocations == 0)) {
+          continue;
+        }
+        CallsiteRecord* total = merged.Insert(site.key);
+        std::copy(site.frames, site.frames + site.num_frames, total->frames);
+        total->num_frames = site.num_frames;
+        total->live_bytes += site.live_bytes;
+        total->live_allocations += site.live_allocations;
+        total->total_bytes += site.total_bytes;
+        total->total_allocations += site.total_allocations;
+      }
+    }
+
+    const CallsiteRecord** sorted = static_cast<const CallsiteRecord**>(
+        ::malloc((merged.size() + 1) * sizeof(CallsiteRecord*)));
+    size_t num_sites = 0;
+    uint64_t live_bytes = 0;
+    uint64_t live_allocations = 0;
+    for (size_t i = 0; i < merged.capacity(); ++i) {
+      if (merged.at(i).key) {
+        sorted[num_sites++] = &merged.at(i);
+        live_bytes += merged.at(i).live_bytes;
+        live_allocations += merged.at(i).live_allocations;
+      }
+    }
+    std::sort(sorted, sorted + num_sites,
+              [leaks_only](const CallsiteRecord* a, const CallsiteRecord* b) {
+                return leaks_only ? a->live_bytes > b->live_bytes
+                                  : a->total_bytes > b->total_bytes;
+              });
+
+    std::fprintf(file, "%llu bytes in %llu allocations are still allocated\n",
+                 static_cast<unsigned long long>(live_bytes),
+                 static_cast<unsigned long long>(live_allocations));
+    for (size_t i = 0; i < num_sites; ++i) {
+      const CallsiteRecord* site = sorted[i];
+      std::fprintf(file,
+                   "  %llu bytes live in %llu allocations, %llu bytes total "
+                   "in %llu allocations, from:\n",
+                   static_cast<unsigned long long>(site->live_bytes),
+                   static_cast<unsigned long long>(site->live_allocations),
+                   static_cast<unsigned long long>(site->total_bytes),
+                   static_cast<unsigned long long>(site->total_allocations));
+      // The innermost frames are the allocators and the containers that
+      // call them, skip those up to the code that asked for the memory.
+      uint32_t first_frame = 0;
+      std::string names[kCallsiteFrames];
+      for (uint32_t j = 0; j < site->num_frames; ++j) {
+        names[j] = internal::FrameName(site->frames[j]);
+        if (first_frame == j && j + 1 < site->num_frames &&
+            (names[j].compare(0, 12, "containers::") == 0 ||
+             names[j].compare(0, 5, "std::") == 0)) {
+          first_frame = j + 1;
+        }
+      }
+      for (uint32_t j = first_frame; j < site->num_frames; ++j) {
+        std::fprintf(file, "    %s\n", names[j].c_str());
+      }
+    }
+    ::free(sorted);
+  }
+
   Allocator* m_root_allocator;
+
+ private:
+  static const size_t kNumShards = 64;
+  // The number of frames of the call stack that a call site is told apart
+  // by. The allocators and containers take the first few of them.
+  static const uint32_t kCallsiteFrames = 12;
+
+  struct AllocationRecord {
+    void* key;
+    size_t size;
+    void* callsite;
+  };
+
+  struct CallsiteRecord {
+    void* key;
+    uint64_t live_bytes;
+    uint64_t live_allocations;
+    uint64_t total_bytes;
+    uint64_t total_allocations;
+    void* frames[kCallsiteFrames];
+    uint32_t num_frames;
+  };
+
+  // Returns a hash of the given call stack, which is never nullptr. Call
+  // stacks with the same hash are counted as one call site.
+  static void* CallsiteKey(void* const* frames, uint32_t num_frames) {
+    uint64_t hash = 14695981039346656037ull;
+    for (uint32_t i = 0; i < num_frames; ++i) {
+      hash ^= reinterpret_cast<uintptr_t>(frames[i]);
+      hash *= 1099511628211ull;
+    }
+    return reinterpret_cast<void*>(static_cast<uintptr_t>(hash) | 1);
+  }
+
+  // The call sites of the allocations in a shard are counted in the same
+  // shard, so that malloc and free only ever take one lock. Every shard
+  // starts on its own cache line, so that neighbouring shards do not share
+  // one.
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    internal::PointerHashTable<AllocationRecord> allocations;
+    internal::PointerHashTable<CallsiteRecord> callsites;
+  };
+
+  Shard& GetShard(const void* ptr) {
+    return m_shards[(internal::PointerHashTable<AllocationRecord>::Hash(ptr) >>
+                     40) %
+                    kNumShards];
+  }
+
+  bool m_track_callsites;
+  Shard m_shards[kNumShards];
 };
 
 #undef RELEASE_ASSERT
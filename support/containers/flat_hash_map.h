@@ -0,0 +1,393 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_CONTAINERS_FLAT_HASH_MAP_H_
+#define SUPPORT_CONTAINERS_FLAT_HASH_MAP_H_
+
+#include <assert.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "support/containers/allocator.h"
+
+namespace containers {
+
+// A hash map that keeps its elements in a single array, and resolves
+// collisions with Robin Hood linear probing: every element stays within a
+// short run of slots after the slot it hashes to, and the elements of a run
+// are kept in the order of their home slots. A lookup is a scan over a few
+// neighbouring slots, rather than a walk down a chain of separately
+// allocated nodes, and can stop as soon as it reaches an element that is
+// closer to its home than the key would be.
+// Erasing shifts the rest of the run back by one slot, so there are no
+// tombstones.
+//
+// The interface follows containers::unordered_map closely, with these
+// differences:
+//  - Inserting may move every element, so pointers, references and
+//    iterators are invalidated by any insertion, and by erase. Store a
+//    containers::unique_ptr if the values must not move.
+//  - Elements can only be erased by key.
+//  - The map cannot be copied.
+//  - No more than 65535 keys may share a hash, the program is aborted if
+//    more are inserted.
+template <typename Key, typename T, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class flat_hash_map {
+ public:
+  typedef Key key_type;
+  typedef T mapped_type;
+  typedef std::pair<const Key, T> value_type;
+
+ private:
+  template <bool Const>
+  class Iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename flat_hash_map::value_type value_type;
+    typedef ptrdiff_t difference_type;
+    typedef typename std::conditional<Const, const value_type*,
+                                      value_type*>::type pointer;
+    typedef typename std::conditional<Const, const value_type&,
+                                      value_type&>::type reference;
+    typedef typename std::conditional<Const, const flat_hash_map*,
+                                      flat_hash_map*>::type map_pointer;
+
+    Iterator() : map_(nullptr), index_(0) {}
+    Iterator(map_pointer map, size_t index) : map_(map), index_(index) {}
+    // Allows converting an iterator to a const_iterator.
+    Iterator(const Iterator<false>& other)
+        : map_(other.map_), index_(other.index_) {}
+
+    reference operator*() const { return map_->values_[index_]; }
+    pointer operator->() const { return &map_->values_[index_]; }
+
+    Iterator& operator++() {
+      index_ = map_->NextOccupied(index_ + 1);
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator ret = *this;
+      ++*this;
+      return ret;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return index_ == other.index_;
+    }
+    bool operator!=(const Iterator& other) const {
+      return index_ != other.index_;
+    }
+
+   private:
+    friend class flat_hash_map;
+    template <bool>
+    friend class Iterator;
+    map_pointer map_;
+    size_t index_;
+  };
+
+ public:
+  typedef Iterator<false> iterator;
+  typedef Iterator<true> const_iterator;
+
+  explicit flat_hash_map(Allocator* allocator)
+      : allocator_(allocator),
+        values_(nullptr),
+        distances_(nullptr),
+        capacity_(0),
+        size_(0),
+        shift_(64) {}
+
+  flat_hash_map(flat_hash_map&& other)
+      : allocator_(other.allocator_),
+        values_(other.values_),
+        distances_(other.distances_),
+        capacity_(other.capacity_),
+        size_(other.size_),
+        shift_(other.shift_) {
+    other.values_ = nullptr;
+    other.distances_ = nullptr;
+    other.capacity_ = 0;
+    other.size_ = 0;
+    other.shift_ = 64;
+  }
+
+  ~flat_hash_map() {
+    clear();
+    FreeSlots(values_, capacity_);
+  }
+
+  flat_hash_map(const flat_hash_map&) = delete;
+  flat_hash_map& operator=(const flat_hash_map&) = delete;
+
+  iterator begin() { return iterator(this, NextOccupied(0)); }
+  iterator end() { return iterator(this, capacity_); }
+  const_iterator begin() const {
+    return const_iterator(this, NextOccupied(0));
+  }
+  const_iterator end() const { return const_iterator(this, capacity_); }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  // Returns the number of slots, the map grows once more than 7/8 of them
+  // are used.
+  size_t capacity() const { return capacity_; }
+
+  iterator find(const Key& key) { return iterator(this, Find(key)); }
+  const_iterator find(const Key& key) const {
+    return const_iterator(this, Find(key));
+  }
+  size_t count(const Key& key) const { return Find(key) != capacity_; }
+
+  T& at(const Key& key) {
+    const size_t index = Find(key);
+    assert(index != capacity_ && "The key is not in the map");
+    return values_[index].second;
+  }
+  const T& at(const Key& key) const {
+    const size_t index = Find(key);
+    assert(index != capacity_ && "The key is not in the map");
+    return values_[index].second;
+  }
+
+  T& operator[](const Key& key) { return emplace(key).first->second; }
+
+  // Constructs the value from args if the key is not in the map yet.
+  // Returns an iterator to the element with the given key, and whether it
+  // was inserted.
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(const Key& key, Args&&... args) {
+    const size_t found = Find(key);
+    if (found != capacity_) {
+      return std::make_pair(iterator(this, found), false);
+    }
+    size_t index;
+    while (!InsertNew(key, &index, std::forward<Args>(args)...)) {
+      // A run can only get too long while there is room to spare if many
+      // keys hash to the same slot. Growing splits up keys whose hashes
+      // differ, but not keys with the same hash, so give up rather than
+      // growing a map that would be mostly empty.
+      if (size_ + 1 <= MaxSize(capacity_) && size_ < capacity_ / 16) {
+        Fail("Too many keys of a flat_hash_map have the same hash");
+      }
+      Grow();
+    }
+    return std::make_pair(iterator(this, index), true);
+  }
+
+  std::pair<iterator, bool> insert(const value_type& value) {
+    return emplace(value.first, value.second);
+  }
+
+  // Returns the number of elements that were erased.
+  size_t erase(const Key& key) {
+    size_t index = Find(key);
+    if (index == capacity_) {
+      return 0;
+    }
+    values_[index].~value_type();
+    // Pull the rest of the run back by one slot.
+    size_t next = (index + 1) & (capacity_ - 1);
+    while (distances_[next] > 1) {
+      ::new (static_cast<void*>(&values_[index]))
+          value_type(std::move(values_[next]));
+      values_[next].~value_type();
+      distances_[index] = distances_[next] - 1;
+      index = next;
+      next = (next + 1) & (capacity_ - 1);
+    }
+    distances_[index] = 0;
+    --size_;
+    return 1;
+  }
+
+  void clear() {
+    for (size_t i = 0; i < capacity_; ++i) {
+      if (distances_[i]) {
+        values_[i].~value_type();
+        distances_[i] = 0;
+      }
+    }
+    size_ = 0;
+  }
+
+  // Makes room for count elements without growing.
+  void reserve(size_t count) {
+    size_t capacity = kMinCapacity;
+    while (count > MaxSize(capacity)) {
+      capacity *= 2;
+    }
+    if (capacity > capacity_) {
+      Rehash(capacity);
+    }
+  }
+
+ private:
+  static const size_t kMinCapacity = 8;
+  // distances_ holds one more than the distance of each element from its
+  // home slot, so 0 marks an empty slot. If an insertion would move an
+  // element further than this, the map grows instead.
+  typedef uint16_t Distance;
+  static const Distance kMaxDistance = 65535;
+
+  static size_t MaxSize(size_t capacity) { return capacity - capacity / 8; }
+
+  // Spreads the bits of the hash over the top of a 64 bit value, and keeps
+  // as many bits as are needed to index the slots. This keeps keys that
+  // hash to themselves, like small integers, from piling up in one run.
+  size_t HomeSlot(const Key& key) const {
+    const uint64_t hash =
+        static_cast<uint64_t>(Hash()(key)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(hash >> shift_);
+  }
+
+  // Returns the slot that holds key, or capacity_ if there is none.
+  size_t Find(const Key& key) const {
+    if (size_ == 0) {
+      return capacity_;
+    }
+    size_t index = HomeSlot(key);
+    for (uint32_t distance = 1; distances_[index] >= distance; ++distance) {
+      if (distances_[index] == distance && KeyEqual()(values_[index].first,
+                                                      key)) {
+        return index;
+      }
+      index = (index + 1) & (capacity_ - 1);
+    }
+    return capacity_;
+  }
+
+  // Returns the first occupied slot at or after index, or capacity_.
+  size_t NextOccupied(size_t index) const {
+    while (index < capacity_ && !distances_[index]) {
+      ++index;
+    }
+    return index;
+  }
+
+  // Inserts a key that is not in the map yet. Returns false without
+  // changing anything if the map has to grow first.
+  template <typename... Args>
+  bool InsertNew(const Key& key, size_t* inserted, Args&&... args) {
+    if (size_ + 1 > MaxSize(capacity_)) {
+      return false;
+    }
+    // Find the slot that the key belongs in: the first one that is empty,
+    // or holds an element that is closer to its home than the key would be.
+    size_t index = HomeSlot(key);
+    uint32_t distance = 1;
+    while (distances_[index] >= distance) {
+      index = (index + 1) & (capacity_ - 1);
+      ++distance;
+    }
+    if (distance > kMaxDistance) {
+      return false;
+    }
+    // Every element from there up to the next empty slot moves up by one.
+    size_t empty = index;
+    while (distances_[empty]) {
+      if (distances_[empty] == kMaxDistance) {
+        return false;
+      }
+      empty = (empty + 1) & (capacity_ - 1);
+    }
+    while (empty != index) {
+      const size_t previous = (empty - 1) & (capacity_ - 1);
+      ::new (static_cast<void*>(&values_[empty]))
+          value_type(std::move(values_[previous]));
+      values_[previous].~value_type();
+      distances_[empty] = distances_[previous] + 1;
+      empty = previous;
+    }
+    ::new (static_cast<void*>(&values_[index]))
+        value_type(std::piecewise_construct, std::forward_as_tuple(key),
+                   std::forward_as_tuple(std::forward<Args>(args)...));
+    distances_[index] = static_cast<Distance>(distance);
+    ++size_;
+    *inserted = index;
+    return true;
+  }
+
+  void Grow() { Rehash(capacity_ ? capacity_ * 2 : kMinCapacity); }
+
+  void Rehash(size_t capacity) {
+    value_type* values = values_;
+    Distance* distances = distances_;
+    const size_t old_capacity = capacity_;
+
+    // The capacity is a multiple of 8, so the distances are aligned.
+    values_ = static_cast<value_type*>(
+        allocator_->malloc(capacity * (sizeof(value_type) + sizeof(Distance))));
+    distances_ = reinterpret_cast<Distance*>(values_ + capacity);
+    for (size_t i = 0; i < capacity; ++i) {
+      distances_[i] = 0;
+    }
+    capacity_ = capacity;
+    size_ = 0;
+    shift_ = 64;
+    for (size_t i = capacity; i > 1; i >>= 1) {
+      --shift_;
+    }
+
+    for (size_t i = 0; i < old_capacity; ++i) {
+      if (!distances[i]) {
+        continue;
+      }
+      size_t index;
+      // Every run only gets shorter when the map doubles in size.
+      if (!InsertNew(values[i].first, &index, std::move(values[i].second))) {
+        Fail("Could not rehash a flat_hash_map");
+      }
+      values[i].~value_type();
+    }
+    FreeSlots(values, old_capacity);
+  }
+
+  void FreeSlots(value_type* values, size_t capacity) {
+    if (values) {
+      allocator_->free(values,
+                       capacity * (sizeof(value_type) + sizeof(Distance)));
+    }
+  }
+
+  // Aborts in every build, continuing would lose elements.
+  static void Fail(const char* message) {
+    std::fprintf(stderr, "%s\n", message);
+    std::abort();
+  }
+
+  Allocator* allocator_;
+  // The elements, followed by the distances of every slot in the same
+  // allocation.
+  value_type* values_;
+  Distance* distances_;
+  // Always 0 or a power of two.
+  size_t capacity_;
+  size_t size_;
+  // 64 - log2(capacity_).
+  uint32_t shift_;
+};
+}  // namespace containers
+
+#endif  // SUPPORT_CONTAINERS_FLAT_HASH_MAP_H_
@@ -0,0 +1,174 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_CONTAINERS_FRAME_ALLOCATOR_H_
+#define SUPPORT_CONTAINERS_FRAME_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "support/containers/allocator.h"
+
+namespace containers {
+
+// This allocator hands out memory by bumping a pointer through chunks of
+// memory from its root allocator. Freeing memory does nothing, unless it
+// was the most recent allocation, instead all of the memory is reclaimed
+// at once by Reset, or everything that was allocated after a call to mark
+// is reclaimed by Rewind.
+// When a Reset follows a period that needed more than one chunk, the chunks
+// are replaced by a single chunk that is large enough to hold all of them,
+// so once the peak usage has been seen, allocating never calls into the
+// root allocator.
+// Memory from this allocator must not be used after the Reset or Rewind
+// that reclaims it. This allocator is not thread-safe.
+class FrameAllocator : public Allocator {
+  struct Chunk {
+    Chunk* next;
+    size_t size;
+  };
+
+ public:
+  // A position in the allocator, see mark and Rewind.
+  struct Marker {
+    Chunk* chunk;
+    size_t offset;
+    size_t used_size;
+  };
+
+  FrameAllocator(Allocator* root, size_t chunk_size = 64 * 1024)
+      : root_(root),
+        chunks_(nullptr),
+        current_(nullptr),
+        offset_(0),
+        used_size_(0),
+        peak_used_size_(0),
+        root_allocations_(0) {
+    chunks_ = AllocateChunk(chunk_size);
+    current_ = chunks_;
+  }
+
+  ~FrameAllocator() { FreeChunks(); }
+
+  FrameAllocator(const FrameAllocator&) = delete;
+  FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+  void* malloc(size_t size) override {
+    size = RoundUp(size, kAlignment);
+    while (offset_ + size > current_->size) {
+      // Chunks past the current one are left over from before a Rewind.
+      if (!current_->next) {
+        Chunk* chunk = AllocateChunk(
+            current_->size * 2 > size ? current_->size * 2 : size);
+        current_->next = chunk;
+      }
+      current_ = current_->next;
+      offset_ = 0;
+    }
+    void* ret = Data(current_) + offset_;
+    offset_ += size;
+    used_size_ += size;
+    if (used_size_ > peak_used_size_) {
+      peak_used_size_ = used_size_;
+    }
+    return ret;
+  }
+
+  // Only the most recent allocation is given back, which lets containers
+  // that reallocate as they grow reuse some of their memory.
+  void free(void* ptr, size_t size) override {
+    size = RoundUp(size, kAlignment);
+    if (size <= offset_ &&
+        static_cast<char*>(ptr) == Data(current_) + offset_ - size) {
+      offset_ -= size;
+      used_size_ -= size;
+    }
+  }
+
+  // Returns the current position of the allocator.
+  Marker mark() const { return Marker{current_, offset_, used_size_}; }
+
+  // Reclaims everything that was allocated since the given marker was
+  // taken.
+  void Rewind(const Marker& marker) {
+    current_ = marker.chunk;
+    offset_ = marker.offset;
+    used_size_ = marker.used_size;
+  }
+
+  // Reclaims everything that was allocated from this allocator.
+  void Reset() {
+    if (chunks_->next) {
+      size_t total_size = 0;
+      for (Chunk* chunk = chunks_; chunk; chunk = chunk->next) {
+        total_size += chunk->size;
+      }
+      FreeChunks();
+      chunks_ = AllocateChunk(total_size);
+    }
+    current_ = chunks_;
+    offset_ = 0;
+    used_size_ = 0;
+  }
+
+  // Returns the number of bytes that are currently allocated, and the most
+  // that have ever been allocated at once.
+  size_t used_size() const { return used_size_; }
+  size_t peak_used_size() const { return peak_used_size_; }
+  // Returns the number of times this allocator has called malloc on its
+  // root allocator.
+  uint64_t root_allocations() const { return root_allocations_; }
+
+ private:
+  // Allocations are aligned the same way that Allocator::construct expects.
+  static const size_t kAlignment = 16;
+
+  static size_t RoundUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+  }
+
+  static char* Data(Chunk* chunk) {
+    return reinterpret_cast<char*>(chunk) +
+           RoundUp(sizeof(Chunk), kAlignment);
+  }
+
+  Chunk* AllocateChunk(size_t size) {
+    root_allocations_ += 1;
+    Chunk* chunk = static_cast<Chunk*>(
+        root_->malloc(RoundUp(sizeof(Chunk), kAlignment) + size));
+    chunk->next = nullptr;
+    chunk->size = size;
+    return chunk;
+  }
+
+  void FreeChunks() {
+    while (chunks_) {
+      Chunk* chunk = chunks_;
+      chunks_ = chunk->next;
+      root_->free(chunk, RoundUp(sizeof(Chunk), kAlignment) + chunk->size);
+    }
+  }
+
+  Allocator* root_;
+  Chunk* chunks_;
+  Chunk* current_;
+  size_t offset_;
+  size_t used_size_;
+  size_t peak_used_size_;
+  uint64_t root_allocations_;
+};
+}  // namespace containers
+
+#endif  // SUPPORT_CONTAINERS_FRAME_ALLOCATOR_H_
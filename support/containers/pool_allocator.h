@@ -0,0 +1,438 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_CONTAINERS_POOL_ALLOCATOR_H_
+#define SUPPORT_CONTAINERS_POOL_ALLOCATOR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+#include "support/containers/allocator.h"
+
+namespace containers {
+
+// This allocator rounds every request of up to 32KiB up to a power of two,
+// and hands out objects of that size class from spans of memory that it
+// gets from ::malloc. Larger requests go straight to ::malloc.
+// Every thread has its own cache of free objects for every size class, so
+// most allocations and frees do not touch any shared state. A thread cache
+// fetches objects from the central pool kBatchSize at a time, and hands
+// them back kBatchSize at a time once it holds too many, so the central
+// locks are only taken once per batch.
+// Spans are only returned to the system when this allocator is destroyed.
+// This allocator is thread-safe. Memory may be freed on a different thread
+// than the one that allocated it.
+//
+// If track_leaks is set, the number of bytes that are currently allocated
+// is counted. Every thread counts the memory it allocates and frees on its
+// own, so that threads do not contend on a shared counter, and
+// currently_allocated_bytes adds them up.
+class PoolAllocator : public Allocator {
+ public:
+  explicit PoolAllocator(bool track_leaks = false)
+      : track_leaks_(track_leaks),
+        caches_(nullptr),
+        spans_(nullptr),
+        shared_allocated_bytes_(0),
+        shared_allocations_(0) {
+    for (auto& list : central_lists_) {
+      list.head = nullptr;
+    }
+  }
+
+  ~PoolAllocator() {
+    {
+      std::lock_guard<std::mutex> lock(RegistryMutex());
+      // Threads that are still around hold on to their caches, the objects
+      // in them go away with the spans.
+      while (caches_) {
+        ThreadCache* cache = caches_;
+        caches_ = cache->next;
+        cache->pool.store(nullptr);
+        ReleaseReference(cache);
+      }
+    }
+    while (spans_) {
+      Span* span = spans_;
+      spans_ = span->next;
+      ::free(span);
+    }
+  }
+
+  PoolAllocator(const PoolAllocator&) = delete;
+  PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+  void* malloc(size_t size) override {
+    ThreadCache* cache = GetThreadCache();
+    CountAllocation(cache, static_cast<int64_t>(size));
+    uint32_t size_class;
+    if (!GetSizeClass(size, &size_class)) {
+      return ::malloc(size);
+    }
+    if (!cache) {
+      FreeObject* object;
+      FetchFromCentral(size_class, 1, &object);
+      return object;
+    }
+    if (!cache->free_lists[size_class]) {
+      cache->counts[size_class] = FetchFromCentral(
+          size_class, kBatchSize, &cache->free_lists[size_class]);
+    }
+    FreeObject* object = cache->free_lists[size_class];
+    cache->free_lists[size_class] = object->next;
+    cache->counts[size_class] -= 1;
+    return object;
+  }
+
+  void free(void* ptr, size_t size) override {
+    ThreadCache* cache = GetThreadCache();
+    CountAllocation(cache, -static_cast<int64_t>(size));
+    uint32_t size_class;
+    if (!GetSizeClass(size, &size_class)) {
+      ::free(ptr);
+      return;
+    }
+    FreeObject* object = static_cast<FreeObject*>(ptr);
+    if (!cache) {
+      object->next = nullptr;
+      ReturnToCentral(size_class, object, object);
+      return;
+    }
+    object->next = cache->free_lists[size_class];
+    cache->free_lists[size_class] = object;
+    cache->counts[size_class] += 1;
+    if (cache->counts[size_class] > kMaxCachedObjects) {
+      // Keep the objects that were freed most recently, they are the most
+      // likely to still be in the CPU caches.
+      FreeObject* last = cache->free_lists[size_class];
+      for (uint32_t i = 1; i < kMaxCachedObjects - kBatchSize; ++i) {
+        last = last->next;
+      }
+      FreeObject* first = last->next;
+      last->next = nullptr;
+      last = first;
+      while (last->next) {
+        last = last->next;
+      }
+      ReturnToCentral(size_class, first, last);
+      cache->counts[size_class] = kMaxCachedObjects - kBatchSize;
+    }
+  }
+
+  // Returns the number of bytes that are currently allocated from this
+  // allocator. This is only tracked if track_leaks was set.
+  int64_t currently_allocated_bytes() const {
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    int64_t bytes = shared_allocated_bytes_.load();
+    for (ThreadCache* cache = caches_; cache; cache = cache->next) {
+      bytes += cache->allocated_bytes.load(std::memory_order_relaxed);
+    }
+    return bytes;
+  }
+
+  // Returns the number of allocations that have been made from this
+  // allocator. This is only tracked if track_leaks was set.
+  uint64_t total_number_of_allocations() const {
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    uint64_t allocations = shared_allocations_.load();
+    for (ThreadCache* cache = caches_; cache; cache = cache->next) {
+      allocations += cache->allocations.load(std::memory_order_relaxed);
+    }
+    return allocations;
+  }
+
+ private:
+  static const uint32_t kMinSizeLog2 = 4;
+  static const uint32_t kMaxSizeLog2 = 15;
+  static const uint32_t kNumSizeClasses = kMaxSizeLog2 - kMinSizeLog2 + 1;
+  // The number of objects that move between a thread cache and the central
+  // pool at once.
+  static const uint32_t kBatchSize = 32;
+  // A thread cache gives a batch back once it holds more than this many
+  // free objects of one size class.
+  static const uint32_t kMaxCachedObjects = 2 * kBatchSize;
+  static const size_t kSpanSize = 256 * 1024;
+  // Objects are aligned the same way that Allocator::construct expects.
+  static const size_t kSpanHeaderSize = 16;
+  // The number of pools that a single thread keeps a cache for. Threads
+  // that use more pools at once share the central pool for the others.
+  static const uint32_t kMaxCachesPerThread = 4;
+
+  struct FreeObject {
+    FreeObject* next;
+  };
+
+  struct Span {
+    Span* next;
+  };
+
+  struct CentralList {
+    std::mutex mutex;
+    FreeObject* head;
+  };
+
+  // The free objects of one thread. A cache is referenced by the pool that
+  // it belongs to and by its thread, and is deleted once both are gone.
+  // Everything but the counters is only touched by its own thread, or with
+  // RegistryMutex held.
+  struct ThreadCache {
+    std::atomic<PoolAllocator*> pool;
+    uint32_t references;
+    ThreadCache* next;
+    ThreadCache* prev;
+    FreeObject* free_lists[kNumSizeClasses];
+    uint32_t counts[kNumSizeClasses];
+    // Only written by the thread that owns this cache.
+    std::atomic<int64_t> allocated_bytes;
+    std::atomic<uint64_t> allocations;
+  };
+
+  // The caches of the current thread, one for every pool that it uses.
+  // Destructors of other thread_local objects may still allocate and free
+  // after this has been destroyed, so it then hands out no caches, and
+  // those calls go to the central pool.
+  struct ThreadCaches {
+    ThreadCache* caches[kMaxCachesPerThread];
+    bool torn_down;
+
+    ThreadCaches() : torn_down(false) {
+      for (auto& cache : caches) {
+        cache = nullptr;
+      }
+    }
+
+    ~ThreadCaches() {
+      std::lock_guard<std::mutex> lock(RegistryMutex());
+      for (ThreadCache*& cache : caches) {
+        if (!cache) {
+          continue;
+        }
+        PoolAllocator* pool = cache->pool.load();
+        if (pool) {
+          pool->RetireCache(cache);
+        }
+        ReleaseReference(cache);
+        cache = nullptr;
+      }
+      torn_down = true;
+    }
+  };
+
+  // Guards the lists of caches of every pool, and the ownership of
+  // every cache.
+  static std::mutex& RegistryMutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  static ThreadCaches& LocalCaches() {
+    static thread_local ThreadCaches caches;
+    return caches;
+  }
+
+  static void ReleaseReference(ThreadCache* cache) {
+    cache->references -= 1;
+    if (cache->references == 0) {
+      cache->~ThreadCache();
+      ::free(cache);
+    }
+  }
+
+  static bool GetSizeClass(size_t size, uint32_t* size_class) {
+    if (size > (size_t(1) << kMaxSizeLog2)) {
+      return false;
+    }
+    uint32_t index = 0;
+    for (size_t class_size = size_t(1) << kMinSizeLog2; class_size < size;
+         class_size <<= 1) {
+      ++index;
+    }
+    *size_class = index;
+    return true;
+  }
+
+  // Returns the cache of the current thread for this pool, creating it if
+  // needed. Returns nullptr if the thread already has a cache for
+  // kMaxCachesPerThread other pools, or if its caches have been torn down.
+  ThreadCache* GetThreadCache() {
+    ThreadCaches& local = LocalCaches();
+    if (local.torn_down) {
+      return nullptr;
+    }
+    ThreadCache** empty = nullptr;
+    for (auto& cache : local.caches) {
+      if (!cache) {
+        empty = empty ? empty : &cache;
+        continue;
+      }
+      PoolAllocator* pool = cache->pool.load(std::memory_order_relaxed);
+      if (pool == this) {
+        return cache;
+      }
+      if (!pool) {
+        // The pool of this cache has been destroyed.
+        std::lock_guard<std::mutex> lock(RegistryMutex());
+        ReleaseReference(cache);
+        cache = nullptr;
+        empty = empty ? empty : &cache;
+      }
+    }
+    if (!empty) {
+      return nullptr;
+    }
+
+    ThreadCache* cache = new (::malloc(sizeof(ThreadCache))) ThreadCache();
+    cache->pool.store(this);
+    cache->references = 2;
+    for (uint32_t i = 0; i < kNumSizeClasses; ++i) {
+      cache->free_lists[i] = nullptr;
+      cache->counts[i] = 0;
+    }
+    cache->allocated_bytes.store(0);
+    cache->allocations.store(0);
+    {
+      std::lock_guard<std::mutex> lock(RegistryMutex());
+      cache->prev = nullptr;
+      cache->next = caches_;
+      if (caches_) {
+        caches_->prev = cache;
+      }
+      caches_ = cache;
+    }
+    *empty = cache;
+    return cache;
+  }
+
+  // Hands the objects of a cache whose thread is exiting back to the
+  // central pool, and stops counting it. RegistryMutex must be held.
+  void RetireCache(ThreadCache* cache) {
+    for (uint32_t i = 0; i < kNumSizeClasses; ++i) {
+      FreeObject* first = cache->free_lists[i];
+      if (!first) {
+        continue;
+      }
+      FreeObject* last = first;
+      while (last->next) {
+        last = last->next;
+      }
+      ReturnToCentral(i, first, last);
+    }
+    shared_allocated_bytes_ += cache->allocated_bytes.load();
+    shared_allocations_ += cache->allocations.load();
+    if (cache->prev) {
+      cache->prev->next = cache->next;
+    } else {
+      caches_ = cache->next;
+    }
+    if (cache->next) {
+      cache->next->prev = cache->prev;
+    }
+    cache->pool.store(nullptr);
+    cache->references -= 1;
+  }
+
+  void CountAllocation(ThreadCache* cache, int64_t bytes) {
+    if (!track_leaks_) {
+      return;
+    }
+    const uint64_t allocations = bytes > 0 ? 1 : 0;
+    if (!cache) {
+      shared_allocated_bytes_ += bytes;
+      shared_allocations_ += allocations;
+      return;
+    }
+    // Only this thread writes to its counters, so there is no need for an
+    // atomic read-modify-write.
+    cache->allocated_bytes.store(
+        cache->allocated_bytes.load(std::memory_order_relaxed) + bytes,
+        std::memory_order_relaxed);
+    cache->allocations.store(
+        cache->allocations.load(std::memory_order_relaxed) + allocations,
+        std::memory_order_relaxed);
+  }
+
+  // Takes up to count objects of the given size class from the central
+  // pool, carving up a new span if it has none. Returns the number of
+  // objects that were put in *objects.
+  uint32_t FetchFromCentral(uint32_t size_class, uint32_t count,
+                            FreeObject** objects) {
+    CentralList& list = central_lists_[size_class];
+    std::lock_guard<std::mutex> lock(list.mutex);
+    if (!list.head) {
+      list.head = AllocateSpan(size_class);
+    }
+    FreeObject* first = list.head;
+    FreeObject* last = first;
+    uint32_t fetched = 1;
+    while (fetched < count && last->next) {
+      last = last->next;
+      ++fetched;
+    }
+    list.head = last->next;
+    last->next = nullptr;
+    *objects = first;
+    return fetched;
+  }
+
+  // Gives the chain of objects from first to last back to the central pool.
+  void ReturnToCentral(uint32_t size_class, FreeObject* first,
+                       FreeObject* last) {
+    CentralList& list = central_lists_[size_class];
+    std::lock_guard<std::mutex> lock(list.mutex);
+    last->next = list.head;
+    list.head = first;
+  }
+
+  // Allocates a span, and returns all of its objects of the given size
+  // class as a chain.
+  FreeObject* AllocateSpan(uint32_t size_class) {
+    const size_t object_size = size_t(1) << (size_class + kMinSizeLog2);
+    const size_t num_objects = (kSpanSize - kSpanHeaderSize) / object_size;
+    Span* span = static_cast<Span*>(::malloc(kSpanSize));
+    {
+      std::lock_guard<std::mutex> lock(spans_mutex_);
+      span->next = spans_;
+      spans_ = span;
+    }
+    char* objects = reinterpret_cast<char*>(span) + kSpanHeaderSize;
+    FreeObject* head = nullptr;
+    for (size_t i = num_objects; i > 0; --i) {
+      FreeObject* object =
+          reinterpret_cast<FreeObject*>(objects + (i - 1) * object_size);
+      object->next = head;
+      head = object;
+    }
+    return head;
+  }
+
+  const bool track_leaks_;
+  // Every cache that currently belongs to this pool. Guarded by
+  // RegistryMutex.
+  ThreadCache* caches_;
+  CentralList central_lists_[kNumSizeClasses];
+  std::mutex spans_mutex_;
+  Span* spans_;
+  // The counts of threads that do not have a cache for this pool, and of
+  // threads that have exited.
+  std::atomic<int64_t> shared_allocated_bytes_;
+  std::atomic<uint64_t> shared_allocations_;
+};
+}  // namespace containers
+
+#endif  // SUPPORT_CONTAINERS_POOL_ALLOCATOR_H_
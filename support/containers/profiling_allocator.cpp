@@ -0,0 +1,92 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "support/containers/profiling_allocator.h"
+
+#include <cstdio>
+#include <fstream>
+
+#include "support/containers/stack_trace.h"
+
+namespace containers {
+
+ProfilingAllocator::ProfilingAllocator(Allocator* root,
+                                       ProfileSampling sampling,
+                                       uint64_t sample_interval)
+    : root_(root),
+      sampling_(sampling),
+      sample_interval_(static_cast<int64_t>(sample_interval ? sample_interval
+                                                            : 1)),
+      num_samples_(0) {}
+
+void* ProfilingAllocator::malloc(size_t size) {
+  // Counts down to the next sample of this thread.
+  static thread_local int64_t until_next_sample = 0;
+  until_next_sample -=
+      sampling_ == ProfileSampling::kBytes ? static_cast<int64_t>(size) : 1;
+  if (until_next_sample <= 0) {
+    // A large allocation may cover several intervals.
+    uint64_t weight = 0;
+    while (until_next_sample <= 0) {
+      until_next_sample += sample_interval_;
+      weight += sample_interval_;
+    }
+    RecordSample(weight);
+  }
+  return root_->malloc(size);
+}
+
+void ProfilingAllocator::RecordSample(uint64_t weight) {
+  void* frames[kMaxFrames];
+  // Skip this function, so that the innermost frame is malloc.
+  const uint32_t num_frames = internal::CaptureStack(frames, kMaxFrames, 1);
+  std::string key(reinterpret_cast<const char*>(frames),
+                  num_frames * sizeof(void*));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  stacks_[key] += weight;
+  num_samples_ += 1;
+}
+
+bool ProfilingAllocator::WriteFoldedStacks(const char* file_name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::ofstream file(file_name, std::ios::out | std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+  std::unordered_map<void*, std::string> names;
+  for (auto& stack : stacks_) {
+    void* const* frames = reinterpret_cast<void* const*>(stack.first.data());
+    const size_t num_frames = stack.first.size() / sizeof(void*);
+    for (size_t i = num_frames; i > 0; --i) {
+      void* pc = frames[i - 1];
+      auto name = names.find(pc);
+      if (name == names.end()) {
+        std::string frame_name = internal::FrameName(pc);
+        // Semicolons separate the frames.
+        for (char& c : frame_name) {
+          if (c == ';') {
+            c = ':';
+          }
+        }
+        name = names.insert(std::make_pair(pc, frame_name)).first;
+      }
+      file << name->second << (i == 1 ? "" : ";");
+    }
+    file << " " << stack.second << "\n";
+  }
+  return static_cast<bool>(file);
+}
+}  // namespace containers
@@ -0,0 +1,88 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_CONTAINERS_PROFILING_ALLOCATOR_H_
+#define SUPPORT_CONTAINERS_PROFILING_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "support/containers/allocator.h"
+
+namespace containers {
+
+enum class ProfileSampling {
+  // Takes a sample every sample_interval bytes, every sample stands for
+  // sample_interval bytes.
+  kBytes,
+  // Takes a sample every sample_interval allocations, every sample stands
+  // for sample_interval allocations.
+  kAllocations,
+};
+
+// This allocator passes every request on to its root allocator, and
+// records the call stack of a sample of the allocations. The samples are
+// written out in the folded format that flamegraph tools read, one line
+// per distinct stack, outermost frame first:
+//   main;main_entry;Sample::ProcessFrame;... 65536
+// Every thread counts towards its next sample on its own, so sampling does
+// not add any shared state to allocations that are not sampled.
+// Frames are named with dladdr, so functions that are not exported show
+// up as module+offset, unless the executable is linked with -rdynamic.
+// This allocator is thread-safe if its root allocator is.
+class ProfilingAllocator : public Allocator {
+ public:
+  ProfilingAllocator(Allocator* root, ProfileSampling sampling,
+                     uint64_t sample_interval);
+
+  ProfilingAllocator(const ProfilingAllocator&) = delete;
+  ProfilingAllocator& operator=(const ProfilingAllocator&) = delete;
+
+  void* malloc(size_t size) override;
+  void free(void* ptr, size_t size) override { root_->free(ptr, size); }
+
+  // Writes every sampled stack to the given file in folded format. Returns
+  // false if the file could not be written.
+  bool WriteFoldedStacks(const char* file_name);
+
+  uint64_t num_samples() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_samples_;
+  }
+
+ private:
+  static const uint32_t kMaxFrames = 48;
+
+  // Records the call stack of the current allocation with the given
+  // weight.
+  void RecordSample(uint64_t weight);
+
+  Allocator* root_;
+  ProfileSampling sampling_;
+  int64_t sample_interval_;
+  // Guards stacks_ and num_samples_.
+  mutable std::mutex mutex_;
+  // The weight of every distinct stack. The key holds the raw return
+  // addresses. The samples are kept outside of the profiled allocator,
+  // so that they do not show up in its own profile.
+  std::unordered_map<std::string, uint64_t> stacks_;
+  uint64_t num_samples_;
+};
+}  // namespace containers
+
+#endif  // SUPPORT_CONTAINERS_PROFILING_ALLOCATOR_H_
@@ -0,0 +1,132 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_CONTAINERS_SLAB_ALLOCATOR_H_
+#define SUPPORT_CONTAINERS_SLAB_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "support/containers/allocator.h"
+
+namespace containers {
+
+// This allocator hands out fixed-size slots that are carved out of larger
+// slabs of memory from its root allocator. Freed slots are kept on a free
+// list and reused, and slabs are only returned to the root allocator when
+// this allocator is destroyed. Once enough slabs have been allocated to
+// cover the peak number of live slots, allocating and freeing never calls
+// into the root allocator.
+// Requests that are larger than the slot size are passed straight through
+// to the root allocator.
+// This allocator is not thread-safe.
+class SlabAllocator : public Allocator {
+ public:
+  // Every slot holds at least slot_size bytes, and every slab holds
+  // slots_per_slab slots.
+  SlabAllocator(Allocator* root, size_t slot_size, size_t slots_per_slab = 64)
+      : root_(root),
+        slot_size_(RoundUp(slot_size < sizeof(Slot) ? sizeof(Slot) : slot_size,
+                           kSlotAlignment)),
+        slots_per_slab_(slots_per_slab),
+        slabs_(nullptr),
+        free_slots_(nullptr),
+        root_allocations_(0) {}
+
+  ~SlabAllocator() {
+    while (slabs_) {
+      Slab* slab = slabs_;
+      slabs_ = slab->next;
+      root_->free(slab, SlabSize());
+    }
+  }
+
+  SlabAllocator(const SlabAllocator&) = delete;
+  SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+  void* malloc(size_t size) override {
+    if (size > slot_size_) {
+      root_allocations_ += 1;
+      return root_->malloc(size);
+    }
+    if (!free_slots_) {
+      AllocateSlab();
+    }
+    Slot* slot = free_slots_;
+    free_slots_ = slot->next;
+    return slot;
+  }
+
+  void free(void* ptr, size_t size) override {
+    if (size > slot_size_) {
+      root_->free(ptr, size);
+      return;
+    }
+    Slot* slot = static_cast<Slot*>(ptr);
+    slot->next = free_slots_;
+    free_slots_ = slot;
+  }
+
+  // Returns the number of times this allocator has called malloc on its
+  // root allocator, for slabs as well as for oversized requests.
+  uint64_t root_allocations() const { return root_allocations_; }
+
+  size_t slot_size() const { return slot_size_; }
+
+ private:
+  // Slots are aligned the same way that Allocator::construct expects.
+  static const size_t kSlotAlignment = 16;
+
+  struct Slot {
+    Slot* next;
+  };
+  // Slabs are chained through a header that is followed by the slots.
+  struct Slab {
+    Slab* next;
+  };
+
+  static size_t RoundUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+  }
+
+  size_t SlabSize() const {
+    return RoundUp(sizeof(Slab), kSlotAlignment) +
+           slot_size_ * slots_per_slab_;
+  }
+
+  void AllocateSlab() {
+    root_allocations_ += 1;
+    Slab* slab = static_cast<Slab*>(root_->malloc(SlabSize()));
+    slab->next = slabs_;
+    slabs_ = slab;
+    char* slots =
+        reinterpret_cast<char*>(slab) + RoundUp(sizeof(Slab), kSlotAlignment);
+    for (size_t i = slots_per_slab_; i > 0; --i) {
+      Slot* slot = reinterpret_cast<Slot*>(slots + (i - 1) * slot_size_);
+      slot->next = free_slots_;
+      free_slots_ = slot;
+    }
+  }
+
+  Allocator* root_;
+  size_t slot_size_;
+  size_t slots_per_slab_;
+  Slab* slabs_;
+  Slot* free_slots_;
+  uint64_t root_allocations_;
+};
+}  // namespace containers
+
+#endif  // SUPPORT_CONTAINERS_SLAB_ALLOCATOR_H_
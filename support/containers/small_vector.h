@@ -0,0 +1,165 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_CONTAINERS_SMALL_VECTOR_H_
+#define SUPPORT_CONTAINERS_SMALL_VECTOR_H_
+
+#include <cstddef>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "support/containers/allocator.h"
+
+namespace containers {
+
+// A vector that holds up to N elements inside of itself, and only
+// allocates from its allocator once it grows past that. This is meant for
+// the short arrays that are built up on the stack to fill in Vulkan
+// create-info structures.
+// Only the subset of the std::vector interface that those need is
+// provided. Growing moves the elements, so pointers to elements are
+// invalidated like they are for std::vector.
+template <typename T, size_t N>
+class small_vector {
+ public:
+  static_assert(N > 0, "small_vector needs room for at least one element");
+  typedef T value_type;
+  typedef T* iterator;
+  typedef const T* const_iterator;
+
+  explicit small_vector(Allocator* allocator)
+      : allocator_(allocator),
+        data_(reinterpret_cast<T*>(inline_storage_)),
+        size_(0),
+        capacity_(N) {}
+
+  small_vector(std::initializer_list<T> values, Allocator* allocator)
+      : small_vector(allocator) {
+    reserve(values.size());
+    for (const T& value : values) {
+      push_back(value);
+    }
+  }
+
+  ~small_vector() {
+    clear();
+    if (!is_inline()) {
+      allocator_->free(data_, capacity_ * sizeof(T));
+    }
+  }
+
+  small_vector(const small_vector&) = delete;
+  small_vector& operator=(const small_vector&) = delete;
+
+  void push_back(const T& value) { emplace_back(value); }
+  void push_back(T&& value) { emplace_back(std::move(value)); }
+
+  template <typename... Args>
+  T& emplace_back(Args&&... args) {
+    T* t;
+    if (size_ == capacity_) {
+      // args may refer to an element of this vector, so the new element is
+      // built before the old ones are moved out from under it.
+      T* data = static_cast<T*>(allocator_->malloc(2 * capacity_ * sizeof(T)));
+      t = ::new (static_cast<void*>(data + size_))
+          T(std::forward<Args>(args)...);
+      MoveTo(data, 2 * capacity_);
+    } else {
+      t = ::new (static_cast<void*>(data_ + size_))
+          T(std::forward<Args>(args)...);
+    }
+    ++size_;
+    return *t;
+  }
+
+  void pop_back() {
+    --size_;
+    data_[size_].~T();
+  }
+
+  // Value-initializes any new elements.
+  void resize(size_t size) {
+    reserve(size);
+    while (size_ < size) {
+      emplace_back();
+    }
+    while (size_ > size) {
+      pop_back();
+    }
+  }
+
+  void reserve(size_t capacity) {
+    if (capacity <= capacity_) {
+      return;
+    }
+    MoveTo(static_cast<T*>(allocator_->malloc(capacity * sizeof(T))),
+           capacity);
+  }
+
+  void clear() {
+    while (size_ > 0) {
+      pop_back();
+    }
+  }
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  bool empty() const { return size_ == 0; }
+  // Returns true if the elements are still held inside of this vector.
+  bool is_inline() const {
+    return data_ == reinterpret_cast<const T*>(inline_storage_);
+  }
+
+  T* data() { return data_; }
+  const T* data() const { return data_; }
+  T& operator[](size_t i) { return data_[i]; }
+  const T& operator[](size_t i) const { return data_[i]; }
+  T& front() { return data_[0]; }
+  const T& front() const { return data_[0]; }
+  T& back() { return data_[size_ - 1]; }
+  const T& back() const { return data_[size_ - 1]; }
+
+  iterator begin() { return data_; }
+  iterator end() { return data_ + size_; }
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+
+ private:
+  // Moves the elements into data, which has room for capacity elements,
+  // and frees the old storage.
+  void MoveTo(T* data, size_t capacity) {
+    for (size_t i = 0; i < size_; ++i) {
+      ::new (static_cast<void*>(data + i)) T(std::move(data_[i]));
+      data_[i].~T();
+    }
+    if (!is_inline()) {
+      allocator_->free(data_, capacity_ * sizeof(T));
+    }
+    data_ = data;
+    capacity_ = capacity;
+  }
+
+  Allocator* allocator_;
+  T* data_;
+  size_t size_;
+  size_t capacity_;
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type
+      inline_storage_[N];
+};
+}  // namespace containers
+
+#endif  // SUPPORT_CONTAINERS_SMALL_VECTOR_H_
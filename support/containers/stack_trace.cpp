@@ -0,0 +1,109 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "support/containers/stack_trace.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#if defined _WIN32
+#include <windows.h>
+#else
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <unwind.h>
+#endif
+
+namespace containers {
+namespace internal {
+#if defined _WIN32
+__declspec(noinline) uint32_t CaptureStack(void** frames, uint32_t max_frames,
+                                           uint32_t skip) {
+  // Skip this function as well.
+  return CaptureStackBackTrace(skip + 1, max_frames, frames, nullptr);
+}
+
+std::string FrameName(void* pc) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%p", pc);
+  return buffer;
+}
+#else
+namespace {
+struct UnwindState {
+  void** frames;
+  uint32_t max_frames;
+  uint32_t skip;
+  uint32_t num_frames;
+};
+
+_Unwind_Reason_Code UnwindFrame(_Unwind_Context* context, void* arg) {
+  UnwindState* state = static_cast<UnwindState*>(arg);
+  uintptr_t pc = _Unwind_GetIP(context);
+  if (!pc) {
+    return _URC_END_OF_STACK;
+  }
+  if (state->skip) {
+    state->skip -= 1;
+    return _URC_NO_REASON;
+  }
+  state->frames[state->num_frames++] = reinterpret_cast<void*>(pc);
+  return state->num_frames == state->max_frames ? _URC_END_OF_STACK
+                                                : _URC_NO_REASON;
+}
+}  // anonymous namespace
+
+__attribute__((noinline)) uint32_t CaptureStack(void** frames,
+                                                uint32_t max_frames,
+                                                uint32_t skip) {
+  // The first frame that is unwound is this function.
+  UnwindState state{frames, max_frames, skip + 1, 0};
+  _Unwind_Backtrace(&UnwindFrame, &state);
+  return state.num_frames;
+}
+
+std::string FrameName(void* pc) {
+  Dl_info info;
+  if (dladdr(pc, &info)) {
+    if (info.dli_sname) {
+      int status = 0;
+      char* demangled =
+          abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+      std::string name = status == 0 ? demangled : info.dli_sname;
+      ::free(demangled);
+      return name;
+    }
+    if (info.dli_fname) {
+      const char* module = info.dli_fname;
+      for (const char* c = info.dli_fname; *c; ++c) {
+        if (*c == '/') {
+          module = c + 1;
+        }
+      }
+      const uintptr_t offset = reinterpret_cast<uintptr_t>(pc) -
+                               reinterpret_cast<uintptr_t>(info.dli_fbase);
+      char buffer[32];
+      snprintf(buffer, sizeof(buffer), "+0x%llx",
+               static_cast<unsigned long long>(offset));
+      return std::string(module) + buffer;
+    }
+  }
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%p", pc);
+  return buffer;
+}
+#endif
+}  // namespace internal
+}  // namespace containers
@@ -0,0 +1,38 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_CONTAINERS_STACK_TRACE_H_
+#define SUPPORT_CONTAINERS_STACK_TRACE_H_
+
+#include <cstdint>
+#include <string>
+
+// Call stacks for the allocators that record where memory was allocated
+// from. Nothing in here allocates from an Allocator.
+namespace containers {
+namespace internal {
+// Writes the return addresses of up to max_frames frames of the current call
+// stack to frames, innermost first, and returns how many were written. The
+// first frame is the caller of CaptureStack, unless skip frames are skipped.
+uint32_t CaptureStack(void** frames, uint32_t max_frames, uint32_t skip);
+
+// Returns the name of the function that pc is in. Frames are named with
+// dladdr, so functions that are not exported are named module+offset, and
+// on Windows frames are only named by their address.
+std::string FrameName(void* pc);
+}  // namespace internal
+}  // namespace containers
+
+#endif  // SUPPORT_CONTAINERS_STACK_TRACE_H_
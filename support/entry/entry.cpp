@@ -18,11 +18,14 @@
 #include <cassert>
 #include <chrono>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <mutex>
 #include <thread>
 
+#include "support/containers/pool_allocator.h"
+#include "support/containers/profiling_allocator.h"
 #include "support/entry/entry_config.h"
 #include "support/log/log.h"
 
@@ -50,7 +53,10 @@ EntryData::EntryData(containers::Allocator* allocator, uint32_t width,
                      bool separate_present, int64_t output_frame_index,
                      const char* output_frame_file, const char* shader_compiler,
                      bool validation, const char* load_pipeline_cache,
-                     const char* write_pipeline_cache
+                     const char* write_pipeline_cache,
+                     const char* memory_stats_file, bool vulkan_call_stats,
+                     const containers::CountingAllocator* allocation_counter,
+                     bool async_logging
 #if defined __ANDROID__
                      ,
                      android_app* app
@@ -64,10 +70,13 @@ EntryData::EntryData(containers::Allocator* allocator, uint32_t width,
       output_frame_file_(output_frame_file),
       shader_compiler_(shader_compiler),
       validation_(validation),
-      log_(logging::GetLogger(allocator)),
+      log_(logging::GetLogger(allocator, async_logging)),
       allocator_(allocator),
       load_pipeline_cache_(load_pipeline_cache ? load_pipeline_cache : ""),
-      write_pipeline_cache_(write_pipeline_cache ? write_pipeline_cache : "")
+      write_pipeline_cache_(write_pipeline_cache ? write_pipeline_cache : ""),
+      memory_stats_file_(memory_stats_file ? memory_stats_file : ""),
+      vulkan_call_stats_(vulkan_call_stats),
+      allocation_counter_(allocation_counter)
 #if defined __ANDROID__
       ,
       native_window_handle_(app->window),
@@ -150,6 +159,113 @@ struct CommandLineArgs {
   bool validation;
   const char* load_pipeline_cache;
   const char* write_pipeline_cache;
+  const char* memory_stats_file;
+  bool vulkan_call_stats;
+  bool pool_allocator;
+  bool check_allocations;
+  const char* allocation_profile;
+  uint64_t allocation_profile_bytes;
+  uint64_t allocation_profile_allocations;
+  bool check_frame_allocations;
+  bool sync_logging;
+  logging::LogLevel log_level;
+};
+
+// The allocator that everything in the application is allocated from.
+// This is a LeakCheckAllocator, unless -pool-allocator was given. The pool
+// only counts its allocations in builds where the leak check is asserted.
+// With -allocation-profile, allocations are sampled on their way to it, and
+// with -check-allocations, every allocation goes through a
+// CheckedAllocator that records where it came from. With
+// -check-frame-allocations, all allocations are counted.
+class RootAllocator {
+ public:
+  explicit RootAllocator(const CommandLineArgs& args)
+      : use_pool_(args.pool_allocator),
+        check_allocations_(args.check_allocations),
+        count_allocations_(args.check_frame_allocations),
+        profile_file_(args.allocation_profile),
+#if defined NDEBUG
+        pool_allocator_(false),
+#else
+        pool_allocator_(true),
+#endif
+        profiling_allocator_(base(),
+                             args.allocation_profile_allocations
+                                 ? containers::ProfileSampling::kAllocations
+                                 : containers::ProfileSampling::kBytes,
+                             args.allocation_profile_allocations
+                                 ? args.allocation_profile_allocations
+                                 : args.allocation_profile_bytes),
+        checked_allocator_(profiled(), true),
+        counting_allocator_(checked()) {
+  }
+
+  ~RootAllocator() {
+    if (profile_file_ &&
+        !profiling_allocator_.WriteFoldedStacks(profile_file_)) {
+      std::cerr << "Could not write the allocation profile to "
+                << profile_file_ << std::endl;
+    }
+  }
+
+  containers::Allocator* get() {
+    if (count_allocations_) {
+      return &counting_allocator_;
+    }
+    return checked();
+  }
+
+  const containers::CountingAllocator* allocation_counter() const {
+    return count_allocations_ ? &counting_allocator_ : nullptr;
+  }
+
+  // Returns the number of bytes that are still allocated. If allocations
+  // are checked, and some are still allocated, also writes where they were
+  // allocated from to stderr.
+  int64_t ReportLeaks() {
+    int64_t bytes = static_cast<int64_t>(
+        leak_check_allocator_.currently_allocated_bytes_.load());
+    if (use_pool_) {
+      bytes = pool_allocator_.currently_allocated_bytes();
+    }
+    if (check_allocations_ && checked_allocator_.num_allocations() != 0) {
+      checked_allocator_.WriteCallsiteReport(stderr, true);
+    }
+    return bytes;
+  }
+
+ private:
+  containers::Allocator* base() {
+    if (use_pool_) {
+      return &pool_allocator_;
+    }
+    return &leak_check_allocator_;
+  }
+
+  containers::Allocator* profiled() {
+    if (profile_file_) {
+      return &profiling_allocator_;
+    }
+    return base();
+  }
+
+  containers::Allocator* checked() {
+    if (check_allocations_) {
+      return &checked_allocator_;
+    }
+    return profiled();
+  }
+
+  bool use_pool_;
+  bool check_allocations_;
+  bool count_allocations_;
+  const char* profile_file_;
+  containers::LeakCheckAllocator leak_check_allocator_;
+  containers::PoolAllocator pool_allocator_;
+  containers::ProfilingAllocator profiling_allocator_;
+  containers::CheckedAllocator checked_allocator_;
+  containers::CountingAllocator counting_allocator_;
 };
 
 void print_usage(const char** argv) {
@@ -163,6 +279,16 @@ void print_usage(const char** argv) {
   std::cerr << "  -output-frame=<frame>         Dumps the given frame to a file an exits" << std::endl;
   std::cerr << "  -load-pipeline-cache=<file>   Loads and uses a pipeline cache from the given location" << std::endl;
   std::cerr << "  -write-pipeline-cache=<file>  Writes the applicaitons pipeline cache to the given location" << std::endl;
+  std::cerr << "  -memory-stats=<file>          Writes the device memory statistics to the given location as JSON at exit" << std::endl;
+  std::cerr << "  -vulkan-call-stats            Logs the number of calls to each Vulkan function and the time they took at exit, in builds with VULKAN_CALL_PROFILING" << std::endl;
+  std::cerr << "  -pool-allocator               Allocates host memory from a thread-caching pool instead of malloc" << std::endl;
+  std::cerr << "  -check-allocations            Checks every free of host memory, and reports where leaked memory was allocated" << std::endl;
+  std::cerr << "  -allocation-profile=<file>    Samples the call stacks of host memory allocations, and writes them to the given location as folded stacks" << std::endl;
+  std::cerr << "  -allocation-profile-bytes=<n> Takes a sample every n bytes that are allocated, the default is 65536" << std::endl;
+  std::cerr << "  -allocation-profile-allocations=<n>  Takes a sample every n allocations instead" << std::endl;
+  std::cerr << "  -check-frame-allocations      Reports every frame that allocates host memory once the sample has warmed up" << std::endl;
+  std::cerr << "  -sync-logging                 Writes log messages on the thread that logs them, instead of on a background thread" << std::endl;
+  std::cerr << "  -log-level=<level>            Only logs messages at or above the given level: trace, debug, info, warning or error" << std::endl;
   std::cerr << "  -shader-compiler=<string>     Sets the shader compiler to the given one, if the sample could use multiple" << std::endl;
   std::cerr << "  -validation                   Turns on the validation layers if available" << std::endl;
   std::cerr << "  -output-file                  Sets the output file for the output-frame argument" << std::endl;
@@ -183,6 +309,16 @@ void parse_args(CommandLineArgs* args, int argc, const char** argv) {
   args->validation = false;
   args->load_pipeline_cache = nullptr;
   args->write_pipeline_cache = nullptr;
+  args->memory_stats_file = nullptr;
+  args->vulkan_call_stats = false;
+  args->pool_allocator = false;
+  args->check_allocations = false;
+  args->allocation_profile = nullptr;
+  args->allocation_profile_bytes = 65536;
+  args->allocation_profile_allocations = 0;
+  args->check_frame_allocations = false;
+  args->sync_logging = false;
+  args->log_level = logging::LogLevel::kInfo;
 
   for (int i = 1; i < argc; ++i) {
     if (strncmp(argv[i], "-w=", 3) == 0) {
@@ -199,6 +335,32 @@ void parse_args(CommandLineArgs* args, int argc, const char** argv) {
       args->load_pipeline_cache = argv[i] + 21;
     } else if (strncmp(argv[i], "-write-pipeline-cache=", 22) == 0) {
       args->write_pipeline_cache = argv[i] + 22;
+    } else if (strncmp(argv[i], "-memory-stats=", 14) == 0) {
+      args->memory_stats_file = argv[i] + 14;
+    } else if (strncmp(argv[i], "-vulkan-call-stats", 18) == 0) {
+      args->vulkan_call_stats = true;
+    } else if (strncmp(argv[i], "-pool-allocator", 15) == 0) {
+      args->pool_allocator = true;
+    } else if (strncmp(argv[i], "-check-allocations", 18) == 0) {
+      args->check_allocations = true;
+    } else if (strncmp(argv[i], "-allocation-profile=", 20) == 0) {
+      args->allocation_profile = argv[i] + 20;
+    } else if (strncmp(argv[i], "-allocation-profile-bytes=", 26) == 0) {
+      args->allocation_profile_bytes = strtoull(argv[i] + 26, nullptr, 10);
+    } else if (strncmp(argv[i], "-allocation-profile-allocations=", 32) ==
+               0) {
+      args->allocation_profile_allocations =
+          strtoull(argv[i] + 32, nullptr, 10);
+    } else if (strncmp(argv[i], "-check-frame-allocations", 24) == 0) {
+      args->check_frame_allocations = true;
+    } else if (strncmp(argv[i], "-sync-logging", 13) == 0) {
+      args->sync_logging = true;
+    } else if (strncmp(argv[i], "-log-level=", 11) == 0) {
+      if (!logging::ParseLogLevel(argv[i] + 11, &args->log_level)) {
+        std::cerr << "Unknown log level " << argv[i] + 11 << std::endl;
+        print_usage(argv);
+        std::exit(-1);
+      }
     } else if (strncmp(argv[i], "-validation", 11) == 0) {
       args->validation = true;
     } else if (strncmp(argv[i], "-output-file=", 13) == 0) {
@@ -279,7 +441,7 @@ void android_main(android_app* app) {
                                   static_cast<uint32_t>(height), FIXED_TIMESTEP,
                                   PREFER_SEPARATE_PRESENT, output_frame,
                                   output_file, shader_compiler, false, nullptr,
-                                  nullptr, app);
+                                  nullptr, nullptr, false, nullptr, true, app);
       data.entry_data = &entry_data;
       int return_value = main_entry(&entry_data);
       // Do not modify this line, scripts may look for it in the output.
@@ -361,13 +523,16 @@ int main(int argc, const char** argv) {
   while (args.wait_for_debugger)
     ;
   int return_value = 0;
-  containers::LeakCheckAllocator root_allocator;
+  RootAllocator root_allocator(args);
   {
     entry::EntryData entry_data(
-        &root_allocator, args.window_width, args.window_height,
+        root_allocator.get(), args.window_width, args.window_height,
         args.fixed_timestep, args.prefer_separate_present, args.output_frame,
         args.output_file, args.shader_compiler, args.validation,
-        args.load_pipeline_cache, args.write_pipeline_cache);
+        args.load_pipeline_cache, args.write_pipeline_cache,
+        args.memory_stats_file, args.vulkan_call_stats,
+        root_allocator.allocation_counter(), !args.sync_logging);
+    entry_data.logger()->set_level(args.log_level);
     if (args.output_frame == -1) {
       bool window_created = entry_data.CreateWindow();
       if (!window_created) {
@@ -396,7 +561,10 @@ int main(int argc, const char** argv) {
     // Indicate that ggp should shutdown.
     ggp::StopStream();
   }
-  assert(root_allocator.currently_allocated_bytes_.load() == 0);
+  // Report the leaks in every build, only debug builds fail on them.
+  const int64_t leaked_bytes = root_allocator.ReportLeaks();
+  (void)leaked_bytes;
+  assert(leaked_bytes == 0);
   return return_value;
 }
 
@@ -471,13 +639,16 @@ int main(int argc, const char** argv) {
     ;
 
   int return_value = 0;
-  containers::LeakCheckAllocator root_allocator;
+  RootAllocator root_allocator(args);
   {
     entry::EntryData entry_data(
-        &root_allocator, args.window_width, args.window_height,
+        root_allocator.get(), args.window_width, args.window_height,
         args.fixed_timestep, args.prefer_separate_present, args.output_frame,
         args.output_file, args.shader_compiler, args.validation,
-        args.load_pipeline_cache, args.write_pipeline_cache);
+        args.load_pipeline_cache, args.write_pipeline_cache,
+        args.memory_stats_file, args.vulkan_call_stats,
+        root_allocator.allocation_counter(), !args.sync_logging);
+    entry_data.logger()->set_level(args.log_level);
     if (args.output_frame == -1) {
       bool window_created = entry_data.CreateWindow();
       if (!window_created) {
@@ -490,7 +661,10 @@ int main(int argc, const char** argv) {
     });
     main_thread.join();
   }
-  assert(root_allocator.currently_allocated_bytes_.load() == 0);
+  // Report the leaks in every build, only debug builds fail on them.
+  const int64_t leaked_bytes = root_allocator.ReportLeaks();
+  (void)leaked_bytes;
+  assert(leaked_bytes == 0);
   return return_value;
 }
 
@@ -614,13 +788,16 @@ int main(int argc, const char** argv) {
   }
 
   int return_value = 0;
-  containers::LeakCheckAllocator root_allocator;
+  RootAllocator root_allocator(args);
   {
     entry::EntryData entry_data(
-        &root_allocator, args.window_width, args.window_height,
+        root_allocator.get(), args.window_width, args.window_height,
         args.fixed_timestep, args.prefer_separate_present, args.output_frame,
         args.output_file, args.shader_compiler, args.validation,
-        args.load_pipeline_cache, args.write_pipeline_cache);
+        args.load_pipeline_cache, args.write_pipeline_cache,
+        args.memory_stats_file, args.vulkan_call_stats,
+        root_allocator.allocation_counter(), !args.sync_logging);
+    entry_data.logger()->set_level(args.log_level);
 
     if (args.output_frame == -1) {
       bool window_created = entry_data.CreateWindowWin32();
@@ -642,7 +819,10 @@ int main(int argc, const char** argv) {
 
     main_thread.join();
   }
-  assert(root_allocator.currently_allocated_bytes_.load() == 0);
+  // Report the leaks in every build, only debug builds fail on them.
+  const int64_t leaked_bytes = root_allocator.ReportLeaks();
+  (void)leaked_bytes;
+  assert(leaked_bytes == 0);
   return return_value;
 }
 #endif
@@ -663,12 +843,15 @@ int main(int argc, const char** argv) {
   parse_args(&args, argc, argv);
   while (args.wait_for_debugger)
     ;
-  containers::LeakCheckAllocator root_allocator;
+  RootAllocator root_allocator(args);
   entry::EntryData entry_data(
-      &root_allocator, args.window_width, args.window_height,
+      root_allocator.get(), args.window_width, args.window_height,
       args.fixed_timestep, args.prefer_separate_present, args.output_frame,
       args.output_file, args.shader_compiler, args.validation,
-      args.load_pipeline_cache, args.write_pipeline_cache);
+      args.load_pipeline_cache, args.write_pipeline_cache,
+      args.memory_stats_file, args.vulkan_call_stats,
+      root_allocator.allocation_counter(), !args.sync_logging);
+  entry_data.logger()->set_level(args.log_level);
   if (args.output_frame == -1) {
     bool window_created = entry_data.CreateWindow();
     if (!window_created) {
@@ -683,7 +866,10 @@ int main(int argc, const char** argv) {
   });
   RunMacOS();
 
-  assert(root_allocator.currently_allocated_bytes_.load() == 0);
+  // Report the leaks in every build, only debug builds fail on them.
+  const int64_t leaked_bytes = root_allocator.ReportLeaks();
+  (void)leaked_bytes;
+  assert(leaked_bytes == 0);
   return ret;
 }
 }
@@ -71,7 +71,10 @@ class EntryData {
             int64_t output_frame_index, const char* output_frame_file,
             const char* shader_compiler, bool validation,
             const char* load_pipeline_cache,
-            const char* write_pipeline_cache
+            const char* write_pipeline_cache,
+            const char* memory_stats_file, bool vulkan_call_stats,
+            const containers::CountingAllocator* allocation_counter,
+            bool async_logging
 #if defined __ANDROID__
             ,
             android_app* app
@@ -139,6 +142,19 @@ class EntryData {
   const char* write_pipeline_cache() const {
     return write_pipeline_cache_.empty()? nullptr: write_pipeline_cache_.c_str();
   }
+  // The file that VulkanApplication writes its memory statistics to at
+  // exit, or nullptr.
+  const char* memory_stats_file() const {
+    return memory_stats_file_.empty() ? nullptr : memory_stats_file_.c_str();
+  }
+  // True if VulkanApplication should record the calls to Vulkan functions,
+  // and log them at exit.
+  bool vulkan_call_stats() const { return vulkan_call_stats_; }
+  // Counts every allocation that is made from allocator(), if
+  // -check-frame-allocations was given, otherwise nullptr.
+  const containers::CountingAllocator* allocation_counter() const {
+    return allocation_counter_;
+  }
 
  private:
   bool fixed_timestep_;
@@ -153,6 +169,9 @@ class EntryData {
   containers::Allocator* allocator_;
   std::string load_pipeline_cache_;
   std::string write_pipeline_cache_;
+  std::string memory_stats_file_;
+  bool vulkan_call_stats_;
+  const containers::CountingAllocator* allocation_counter_;
 
 #if defined __ANDROID__
   ANativeWindow* native_window_handle_;
@@ -0,0 +1,209 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "support/log/async_logger.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace logging {
+
+AsyncLogger::AsyncLogger(containers::Allocator* allocator,
+                         containers::unique_ptr<Logger> sink,
+                         uint32_t num_slots)
+    : allocator_(allocator),
+      sink_(std::move(sink)),
+      num_slots_(num_slots),
+      slots_(nullptr),
+      message_(nullptr),
+      max_message_size_((num_slots / 4) * kSlotTextSize),
+      write_position_(0),
+      dropped_messages_(0),
+      writer_waiting_(false),
+      flush_waiters_(0),
+      stop_(false),
+      written_position_(0) {
+  slots_ = static_cast<Slot*>(allocator_->malloc(num_slots_ * sizeof(Slot)));
+  for (uint32_t i = 0; i < num_slots_; ++i) {
+    Slot* slot = new (&slots_[i]) Slot();
+    slot->sequence.store(i, std::memory_order_relaxed);
+  }
+  message_ = static_cast<char*>(allocator_->malloc(max_message_size_ + 1));
+  thread_ = std::thread([this]() { Write(); });
+}
+
+AsyncLogger::~AsyncLogger() {
+  stop_.store(true);
+  WakeWriter();
+  thread_.join();
+  for (uint32_t i = 0; i < num_slots_; ++i) {
+    slots_[i].~Slot();
+  }
+  allocator_->free(slots_, num_slots_ * sizeof(Slot));
+  allocator_->free(message_, max_message_size_ + 1);
+}
+
+void AsyncLogger::Flush() {
+  WaitForWritten(write_position_.load());
+}
+
+void AsyncLogger::LogErrorString(const char* str) {
+  WaitForWritten(Enqueue(str, true, true));
+}
+
+void AsyncLogger::LogInfoString(const char* str) { Enqueue(str, false, false); }
+
+uint64_t AsyncLogger::Enqueue(const char* str, bool error, bool wait) {
+  size_t length = strlen(str);
+  if (length > max_message_size_) {
+    length = max_message_size_;
+  }
+  const uint64_t count =
+      length ? (length + kSlotTextSize - 1) / kSlotTextSize : 1;
+  const uint64_t mask = num_slots_ - 1;
+
+  // Claim count consecutive slots. The background thread frees slots in
+  // order, so they are all free once the last one is.
+  uint64_t position = write_position_.load(std::memory_order_relaxed);
+  while (true) {
+    const uint64_t last = position + count - 1;
+    const int64_t difference = static_cast<int64_t>(
+        slots_[last & mask].sequence.load(std::memory_order_acquire) - last);
+    if (difference == 0) {
+      if (write_position_.compare_exchange_weak(position, position + count,
+                                                std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // The ring is full.
+      if (!wait) {
+        dropped_messages_.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+      }
+      WakeWriter();
+      std::this_thread::yield();
+      position = write_position_.load(std::memory_order_relaxed);
+    } else {
+      // Another thread claimed these slots first.
+      position = write_position_.load(std::memory_order_relaxed);
+    }
+  }
+
+  for (uint64_t i = 0; i < count; ++i) {
+    Slot& slot = slots_[(position + i) & mask];
+    const size_t offset = i * kSlotTextSize;
+    const size_t chunk_length = length - offset < kSlotTextSize
+                                    ? length - offset
+                                    : kSlotTextSize;
+    memcpy(slot.text, str + offset, chunk_length);
+    slot.length = static_cast<uint32_t>(chunk_length);
+    slot.error = error;
+    slot.last = i == count - 1;
+    slot.sequence.store(position + i + 1, std::memory_order_release);
+  }
+  WakeWriter();
+  return position + count;
+}
+
+void AsyncLogger::WakeWriter() {
+  // Pairs with the background thread setting writer_waiting_ before it
+  // checks for messages one last time.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (writer_waiting_.load()) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    writer_wake_.notify_one();
+  }
+}
+
+void AsyncLogger::Write() {
+  const uint64_t mask = num_slots_ - 1;
+  uint64_t position = 0;
+  size_t message_length = 0;
+  uint64_t reported_drops = 0;
+  while (true) {
+    Slot& slot = slots_[position & mask];
+    if (slot.sequence.load(std::memory_order_acquire) == position + 1) {
+      memcpy(message_ + message_length, slot.text, slot.length);
+      message_length += slot.length;
+      const bool error = slot.error;
+      const bool last = slot.last;
+      slot.sequence.store(position + num_slots_, std::memory_order_release);
+      ++position;
+      if (!last) {
+        continue;
+      }
+      message_[message_length] = '\0';
+      message_length = 0;
+      if (error) {
+        sink_->LogErrorString(message_);
+      } else {
+        sink_->LogInfoString(message_);
+      }
+      if (flush_waiters_.load()) {
+        sink_->Flush();
+        MarkWritten(position);
+      }
+      continue;
+    }
+
+    // Either everything has been written, or the next message is still
+    // being copied in.
+    const uint64_t drops = dropped_messages_.load(std::memory_order_relaxed);
+    if (drops != reported_drops) {
+      char buffer[64];
+      snprintf(buffer, sizeof(buffer), "%llu log messages were dropped\n",
+               static_cast<unsigned long long>(drops - reported_drops));
+      sink_->LogErrorString(buffer);
+      reported_drops = drops;
+    }
+    sink_->Flush();
+    MarkWritten(position);
+    if (stop_.load() && write_position_.load() == position) {
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    writer_waiting_.store(true);
+    if (slot.sequence.load() != position + 1 && !stop_.load()) {
+      // The timeout is only a fallback, producers wake this thread.
+      writer_wake_.wait_for(lock, std::chrono::milliseconds(10));
+    }
+    writer_waiting_.store(false);
+  }
+}
+
+void AsyncLogger::MarkWritten(uint64_t position) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (position > written_position_) {
+    written_position_ = position;
+  }
+  flushed_.notify_all();
+}
+
+void AsyncLogger::WaitForWritten(uint64_t position) {
+  flush_waiters_.fetch_add(1);
+  WakeWriter();
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    flushed_.wait(lock, [this, position]() {
+      return written_position_ >= position;
+    });
+  }
+  flush_waiters_.fetch_sub(1);
+}
+}  // namespace logging
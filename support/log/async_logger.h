@@ -0,0 +1,127 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_LOG_ASYNC_LOGGER_H_
+#define SUPPORT_LOG_ASYNC_LOGGER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "support/containers/allocator.h"
+#include "support/containers/unique_ptr.h"
+#include "support/log/log.h"
+
+namespace logging {
+
+// A logger that hands every message to a background thread, which writes
+// it to the sink logger. Messages are copied into a fixed ring of slots
+// that any number of threads can write to without taking a lock, so
+// logging never waits on the sink.
+// If the ring is full, info messages are dropped rather than waiting for
+// room, and the number of dropped messages is logged once there is room
+// again. Error messages are never dropped: LogError waits for room, and
+// then for the message to be written, so that it is not lost if the
+// program crashes right after, as it does in LOG_ASSERT.
+// Messages longer than a quarter of the ring are truncated.
+class AsyncLogger : public Logger {
+ public:
+  // num_slots must be a power of two.
+  AsyncLogger(containers::Allocator* allocator,
+              containers::unique_ptr<Logger> sink, uint32_t num_slots = 2048);
+  // Writes every message that is still in the ring.
+  ~AsyncLogger() override;
+
+  AsyncLogger(const AsyncLogger&) = delete;
+  AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+  // Waits until every message that was logged before this call has been
+  // written, and flushes the sink.
+  void Flush() override;
+
+  // Returns the number of messages that were dropped because the ring was
+  // full.
+  uint64_t dropped_messages() const {
+    return dropped_messages_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // The number of bytes of a message that fit in one slot. Longer messages
+  // take up several consecutive slots.
+  static const size_t kSlotTextSize = 240;
+
+  struct Slot {
+    // Equal to the position of the slot in the ring while it is free to be
+    // written, one more than that once it has been written, and the
+    // position plus num_slots_ once it has been read.
+    std::atomic<uint64_t> sequence;
+    uint32_t length;
+    bool error;
+    // True for the last slot of a message.
+    bool last;
+    char text[kSlotTextSize];
+  };
+
+  void LogErrorString(const char* str) override;
+  void LogInfoString(const char* str) override;
+
+  // Copies the message into the ring. If the ring is full, waits for room
+  // if wait is set, otherwise drops the message. Returns the position just
+  // past the message, or 0 if it was dropped.
+  uint64_t Enqueue(const char* str, bool error, bool wait);
+  // Wakes the background thread if it is waiting for messages.
+  void WakeWriter();
+  // The body of the background thread.
+  void Write();
+  // Lets Flush return once everything up to position has been written.
+  void MarkWritten(uint64_t position);
+  // Waits until everything up to position has been written.
+  void WaitForWritten(uint64_t position);
+
+  containers::Allocator* allocator_;
+  containers::unique_ptr<Logger> sink_;
+  const uint32_t num_slots_;
+  Slot* slots_;
+  // The background thread puts the chunks of a message back together
+  // here.
+  char* message_;
+  size_t max_message_size_;
+
+  // The position that the next message is written to.
+  std::atomic<uint64_t> write_position_;
+  std::atomic<uint64_t> dropped_messages_;
+  // Set while the background thread waits for messages.
+  std::atomic<bool> writer_waiting_;
+  // Set while a thread waits in Flush.
+  std::atomic<uint32_t> flush_waiters_;
+  std::atomic<bool> stop_;
+
+  // Guards written_position_, and is used to wake the background thread
+  // and the threads waiting in Flush.
+  std::mutex mutex_;
+  std::condition_variable writer_wake_;
+  std::condition_variable flushed_;
+  // Everything before this position has been written to the sink, and the
+  // sink has been flushed.
+  uint64_t written_position_;
+
+  std::thread thread_;
+};
+}  // namespace logging
+
+#endif  // SUPPORT_LOG_ASYNC_LOGGER_H_
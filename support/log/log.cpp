@@ -16,6 +16,8 @@
 #include "support/log/log.h"
 #include <cstring>
 
+#include "support/log/async_logger.h"
+
 namespace logging {
 #if defined __ANDROID__
 #include <android/log.h>
@@ -88,7 +90,32 @@ class InternalLogger : public Logger {
 };
 #endif
 
-containers::unique_ptr<Logger> GetLogger(containers::Allocator* allocator) {
-  return containers::make_unique<InternalLogger>(allocator);
+bool ParseLogLevel(const char* name, LogLevel* level) {
+  static const struct {
+    const char* name;
+    LogLevel level;
+  } levels[] = {
+      {"trace", LogLevel::kTrace},     {"debug", LogLevel::kDebug},
+      {"info", LogLevel::kInfo},       {"warning", LogLevel::kWarning},
+      {"error", LogLevel::kError},
+  };
+  for (const auto& entry : levels) {
+    if (strcmp(name, entry.name) == 0) {
+      *level = entry.level;
+      return true;
+    }
+  }
+  return false;
+}
+
+containers::unique_ptr<Logger> GetLogger(containers::Allocator* allocator,
+                                         bool async) {
+  containers::unique_ptr<Logger> logger =
+      containers::make_unique<InternalLogger>(allocator);
+  if (!async) {
+    return logger;
+  }
+  return containers::make_unique<AsyncLogger>(allocator, allocator,
+                                              std::move(logger));
 }
 }  // namespace logging
\ No newline at end of file
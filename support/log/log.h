@@ -16,6 +16,7 @@
 #ifndef SUPPORT_LOG_LOG_H_
 #define SUPPORT_LOG_LOG_H_
 
+#include <atomic>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -57,6 +58,52 @@ namespace logging {
     *reinterpret_cast<volatile int*>(intptr_t(0)) = 4; \
   } while (0);
 
+// The severity of a message. A logger only writes messages at or above its
+// level.
+enum class LogLevel : int {
+  kTrace = 0,
+  kDebug = 1,
+  kInfo = 2,
+  kWarning = 3,
+  kError = 4,
+};
+
+// Messages below this level are compiled out by the LOG_TRACE, LOG_DEBUG,
+// LOG_INFO and LOG_WARNING macros. It is the value of a LogLevel, and can
+// be set for the whole build. Release builds drop trace and debug
+// messages.
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL 2
+#else
+#define LOG_MIN_LEVEL 0
+#endif
+#endif
+
+// Logs the values at the given level of the given log. Unlike calling the
+// methods of Logger directly, the values are not evaluated at all if the
+// level is compiled out, or below the level of the log.
+#define LOG_AT_LEVEL(level, log, ...)                                    \
+  do {                                                                   \
+    if (static_cast<int>(level) >= LOG_MIN_LEVEL &&                      \
+        (log)->IsEnabled(level)) {                                       \
+      (log)->Log(level, __VA_ARGS__);                                    \
+    }                                                                    \
+  } while (0)
+
+#define LOG_TRACE(log, ...) \
+  LOG_AT_LEVEL(::logging::LogLevel::kTrace, log, __VA_ARGS__)
+#define LOG_DEBUG(log, ...) \
+  LOG_AT_LEVEL(::logging::LogLevel::kDebug, log, __VA_ARGS__)
+#define LOG_INFO(log, ...) \
+  LOG_AT_LEVEL(::logging::LogLevel::kInfo, log, __VA_ARGS__)
+#define LOG_WARNING(log, ...) \
+  LOG_AT_LEVEL(::logging::LogLevel::kWarning, log, __VA_ARGS__)
+
+// Sets *level to the level with the given name, one of "trace", "debug",
+// "info", "warning" and "error". Returns false if there is no such level.
+bool ParseLogLevel(const char* name, LogLevel* level);
+
 // Logging class base. It provides the functionality to
 // generate log messages for use by any inherited classes.
 // Ideally this would take an allocator and do all memory
@@ -65,24 +112,52 @@ namespace logging {
 // We will have to assume that the STL is doing the right thing here.
 class Logger {
  public:
+  Logger() : level_(static_cast<int>(LogLevel::kInfo)) {}
   virtual ~Logger() {}
 
-  // Logs a set of values to the error stream of the logger.
+  // Messages below this level are dropped. Errors are always logged.
+  void set_level(LogLevel level) {
+    level_.store(static_cast<int>(level), std::memory_order_relaxed);
+  }
+  LogLevel level() const {
+    return static_cast<LogLevel>(level_.load(std::memory_order_relaxed));
+  }
+  bool IsEnabled(LogLevel level) const {
+    return level == LogLevel::kError ||
+           static_cast<int>(level) >=
+               level_.load(std::memory_order_relaxed);
+  }
+
+  // Logs a set of values at the given level. Errors go to the error stream
+  // of the logger, everything else to the info stream.
   template <typename... Args>
-  void LogError(Args... args) {
+  void Log(LogLevel level, Args... args) {
+    if (!IsEnabled(level)) {
+      return;
+    }
     std::ostringstream str;
+    if (level == LogLevel::kWarning) {
+      str << "warning: ";
+    }
     LogHelper(&str, args...);
     str << "\n";
-    LogErrorString(str.str().c_str());
+    if (level == LogLevel::kError) {
+      LogErrorString(str.str().c_str());
+    } else {
+      LogInfoString(str.str().c_str());
+    }
+  }
+
+  // Logs a set of values to the error stream of the logger.
+  template <typename... Args>
+  void LogError(Args... args) {
+    Log(LogLevel::kError, args...);
   }
 
   // Logs a set of values to the info stream of the logger.
   template <typename... Args>
   void LogInfo(Args... args) {
-    std::ostringstream str;
-    LogHelper(&str, args...);
-    str << "\n";
-    LogInfoString(str.str().c_str());
+    Log(LogLevel::kInfo, args...);
   }
 
  private:
@@ -121,12 +196,20 @@ class Logger {
   // string to the STDOUT equivalent.
   virtual void LogInfoString(const char* str) = 0;
 
+  std::atomic<int> level_;
+
+  // AsyncLogger passes messages on to the string functions of its sink.
+  friend class AsyncLogger;
+
  public:
+  // Waits until every message so far has been written out.
   virtual void Flush() {}
 };
 
-// Returns a platform-specific logger.
-containers::unique_ptr<Logger> GetLogger(containers::Allocator* allocator);
+// Returns a platform-specific logger. If async is set, messages are
+// written out on a background thread, see AsyncLogger.
+containers::unique_ptr<Logger> GetLogger(containers::Allocator* allocator,
+                                         bool async = false);
 }  // namespace logging
 
 #endif  // SUPPORT_LOG_LOG_H_
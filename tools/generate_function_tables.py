@@ -0,0 +1,308 @@
+#!/usr/bin/python
+# Copyright 2017 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Generates the entries of the Vulkan function tables from vk.xml.
+
+The output is included by vulkan_wrapper/function_table.h and
+vulkan_wrapper/function_table.cpp. It is made up of sections, and the
+includer picks one by defining its name before including the file:
+
+  VULKAN_INSTANCE_FUNCTIONS, VULKAN_DEVICE_FUNCTIONS,
+  VULKAN_COMMAND_BUFFER_FUNCTIONS, VULKAN_QUEUE_FUNCTIONS
+      FUNCTION(name) for every function of the table.
+  VULKAN_RESOLVE_INSTANCE_FUNCTIONS
+      RESOLVE_FUNCTION(name); for every core instance function, and for the
+      functions of every instance extension for which
+      EXTENSION_ENABLED("name") is true.
+  VULKAN_RESOLVE_DEVICE_FUNCTIONS
+      RESOLVE_DEVICE_FUNCTION(name);, RESOLVE_COMMAND_BUFFER_FUNCTION(name);
+      and RESOLVE_QUEUE_FUNCTION(name); in the same way, where device
+      extensions are checked with DEVICE_EXTENSION_ENABLED("name"), and
+      instance extensions with INSTANCE_EXTENSION_ENABLED("name").
+
+The functions of each extension are kept together, so that the pointers of
+an extension that is not enabled are never touched. Functions that are only
+available on some platforms are guarded by the macro vk.xml gives for the
+platform, like the Vulkan headers do.
+"""
+
+import argparse
+import collections
+import sys
+import xml.etree.ElementTree as ElementTree
+
+INSTANCE, DEVICE, COMMAND_BUFFER, QUEUE = range(4)
+TABLE_NAMES = ['INSTANCE', 'DEVICE', 'COMMAND_BUFFER', 'QUEUE']
+
+# The table of a function is decided by the type of its first parameter.
+DISPATCH_TABLES = {
+    'VkInstance': INSTANCE,
+    'VkPhysicalDevice': INSTANCE,
+    'VkDevice': DEVICE,
+    'VkCommandBuffer': COMMAND_BUFFER,
+    'VkQueue': QUEUE,
+}
+
+# These are resolved by the library and instance wrappers themselves.
+EXCLUDED_FUNCTIONS = ['vkGetInstanceProcAddr', 'vkGetDeviceProcAddr']
+
+# A group of functions that are resolved together: either a core version,
+# or an extension.
+Group = collections.namedtuple(
+    'Group', ['name', 'extension_type', 'protect', 'functions'])
+
+
+def is_vulkan_api(element):
+    """Returns true if element applies to Vulkan, as opposed to only to
+    Vulkan SC."""
+    api = element.get('api')
+    return api is None or 'vulkan' in api.split(',')
+
+
+def read_function_tables(registry):
+    """Returns a dictionary of function names to tables."""
+    tables = {}
+    aliases = {}
+    for command in registry.findall('commands/command'):
+        if not is_vulkan_api(command):
+            continue
+        if command.get('alias'):
+            aliases[command.get('name')] = command.get('alias')
+            continue
+        name = command.find('proto/name').text
+        first_parameter = command.find('param/type')
+        if first_parameter is not None and \
+                first_parameter.text in DISPATCH_TABLES:
+            tables[name] = DISPATCH_TABLES[first_parameter.text]
+    for name, alias in aliases.items():
+        while alias in aliases:
+            alias = aliases[alias]
+        if alias in tables:
+            tables[name] = tables[alias]
+    for name in EXCLUDED_FUNCTIONS:
+        tables.pop(name, None)
+    return tables
+
+
+def required_functions(element):
+    """Returns the names of the functions required by a feature or an
+    extension, in order."""
+    functions = []
+    for require in element.findall('require'):
+        if not is_vulkan_api(require):
+            continue
+        for command in require.findall('command'):
+            if command.get('name') not in functions:
+                functions.append(command.get('name'))
+    return functions
+
+
+def read_groups(registry, tables):
+    """Returns the core groups and the extension groups."""
+    protect = {}
+    for platform in registry.findall('platforms/platform'):
+        protect[platform.get('name')] = platform.get('protect')
+
+    core = []
+    for feature in registry.findall('feature'):
+        if not is_vulkan_api(feature):
+            continue
+        functions = [f for f in required_functions(feature) if f in tables]
+        core.append(Group(feature.get('name'), None, None, functions))
+
+    extensions = []
+    for extension in registry.findall('extensions/extension'):
+        supported = extension.get('supported', '').split(',')
+        if 'vulkan' not in supported:
+            continue
+        functions = [f for f in required_functions(extension) if f in tables]
+        if not functions:
+            continue
+        extensions.append(
+            Group(extension.get('name'), extension.get('type'),
+                  protect.get(extension.get('platform')), functions))
+    return core, extensions
+
+
+class Writer(object):
+    """Writes the sections of the output."""
+
+    def __init__(self, out):
+        self.out = out
+        self.protect = None
+
+    def line(self, text=''):
+        self.out.write(text + '\n')
+
+    def set_protect(self, protect):
+        """Closes the platform guard of the previous group, and opens the
+        guard of the next one, unless they are the same."""
+        if protect == self.protect:
+            return
+        if self.protect:
+            self.line('#endif  // defined(%s)' % self.protect)
+        if protect:
+            self.line('#if defined(%s)' % protect)
+        self.protect = protect
+
+    def begin_section(self, section):
+        self.line()
+        self.line('#if defined(%s)' % section)
+
+    def end_section(self, section):
+        self.set_protect(None)
+        self.line('#undef %s' % section)
+        self.line('#endif  // defined(%s)' % section)
+
+
+def find_owners(core, extensions):
+    """Returns a dictionary of function names to the group that declares
+    them. That is the first core version that requires the function, or
+    else the first extension, preferring extensions that are available on
+    every platform."""
+    owners = {}
+    for group in core + [e for e in extensions if not e.protect] + \
+            [e for e in extensions if e.protect]:
+        for function in group.functions:
+            owners.setdefault(function, group)
+    return owners
+
+
+def is_declared(owners, group, function):
+    """Returns true if function is declared wherever group is available."""
+    return owners[function].protect in [None, group.protect]
+
+
+def write_declarations(writer, table, groups, owners, tables):
+    """Declares every function of the table once, in the group that owns
+    it."""
+    section = 'VULKAN_%s_FUNCTIONS' % TABLE_NAMES[table]
+    writer.begin_section(section)
+    for group in groups:
+        functions = [f for f in group.functions
+                     if tables[f] == table and owners[f] is group]
+        if not functions:
+            continue
+        writer.set_protect(group.protect)
+        writer.line('// %s' % group.name)
+        for function in functions:
+            writer.line('FUNCTION(%s)' % function)
+    writer.end_section(section)
+
+
+def write_resolve_group(writer, group, functions, condition):
+    writer.set_protect(group.protect)
+    if condition:
+        writer.line('if (%s("%s")) {' % (condition, group.name))
+        indent = '  '
+    else:
+        writer.line('// %s' % group.name)
+        indent = ''
+    for macro, function in functions:
+        writer.line('%s%s(%s);' % (indent, macro, function))
+    if condition:
+        writer.line('}')
+
+
+def write_instance_resolution(writer, core, extensions, owners, tables):
+    """Resolves the core functions, the functions of enabled instance
+    extensions, and the physical device functions of device extensions.
+    The latter may be used as soon as the physical device supports the
+    extension, which is before any device is created."""
+    section = 'VULKAN_RESOLVE_INSTANCE_FUNCTIONS'
+    writer.begin_section(section)
+    unconditional = set()
+    for group in core:
+        functions = [('RESOLVE_FUNCTION', f) for f in group.functions
+                     if tables[f] == INSTANCE]
+        unconditional.update(f for _, f in functions)
+        if functions:
+            write_resolve_group(writer, group, functions, None)
+    for group in extensions:
+        functions = [('RESOLVE_FUNCTION', f) for f in group.functions
+                     if tables[f] == INSTANCE and f not in unconditional and
+                     is_declared(owners, group, f)]
+        if not functions:
+            continue
+        if group.extension_type == 'instance':
+            write_resolve_group(writer, group, functions, 'EXTENSION_ENABLED')
+            continue
+        # Several device extensions may require the same function, it is
+        # only resolved for the first one.
+        unconditional.update(f for _, f in functions)
+        write_resolve_group(writer, group, functions, None)
+    writer.end_section(section)
+
+
+def write_device_resolution(writer, core, extensions, owners, tables):
+    """Resolves the core functions of the device, command buffer and queue
+    tables, and the functions of the enabled extensions."""
+    macros = {
+        DEVICE: 'RESOLVE_DEVICE_FUNCTION',
+        COMMAND_BUFFER: 'RESOLVE_COMMAND_BUFFER_FUNCTION',
+        QUEUE: 'RESOLVE_QUEUE_FUNCTION',
+    }
+    section = 'VULKAN_RESOLVE_DEVICE_FUNCTIONS'
+    writer.begin_section(section)
+    core_functions = set()
+    for group in core:
+        functions = [(macros[tables[f]], f) for f in group.functions
+                     if tables[f] in macros]
+        core_functions.update(f for _, f in functions)
+        if functions:
+            write_resolve_group(writer, group, functions, None)
+    for group in extensions:
+        functions = [(macros[tables[f]], f) for f in group.functions
+                     if tables[f] in macros and f not in core_functions and
+                     is_declared(owners, group, f)]
+        if not functions:
+            continue
+        if group.extension_type == 'instance':
+            condition = 'INSTANCE_EXTENSION_ENABLED'
+        else:
+            condition = 'DEVICE_EXTENSION_ENABLED'
+        write_resolve_group(writer, group, functions, condition)
+    writer.end_section(section)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Generates the Vulkan function tables from vk.xml.')
+    parser.add_argument('registry', help='The path to vk.xml')
+    parser.add_argument('-o', '--output', required=True,
+                        help='The file to write the tables to')
+    args = parser.parse_args()
+
+    registry = ElementTree.parse(args.registry).getroot()
+    tables = read_function_tables(registry)
+    core, extensions = read_groups(registry, tables)
+    owners = find_owners(core, extensions)
+
+    with open(args.output, 'w') as out:
+        writer = Writer(out)
+        writer.line('// Generated by tools/generate_function_tables.py from')
+        writer.line('// vk.xml, do not edit.')
+        writer.line('// This file is meant to be included more than once, '
+                    'see the script for')
+        writer.line('// the sections it contains.')
+        for table in [INSTANCE, DEVICE, COMMAND_BUFFER, QUEUE]:
+            write_declarations(writer, table, core + extensions, owners,
+                               tables)
+        write_instance_resolution(writer, core, extensions, owners, tables)
+        write_device_resolution(writer, core, extensions, owners, tables)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
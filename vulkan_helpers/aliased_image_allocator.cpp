@@ -0,0 +1,193 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/aliased_image_allocator.h"
+
+#include <algorithm>
+
+#include "vulkan_helpers/helper_functions.h"
+
+namespace vulkan {
+namespace {
+::VkDeviceSize RoundUp(::VkDeviceSize value, ::VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+}  // anonymous namespace
+
+AliasedImageAllocator::AliasedImageAllocator(containers::Allocator* allocator,
+                                             logging::Logger* log,
+                                             VkDevice* device)
+    : allocator_(allocator),
+      log_(log),
+      device_(device),
+      images_(allocator),
+      separate_size_(0),
+      aliased_size_(0) {}
+
+AliasedImageAllocator::~AliasedImageAllocator() {
+  for (auto& image : images_) {
+    if (image.image != VK_NULL_HANDLE) {
+      (*device_)->vkDestroyImage(*device_, image.image, nullptr);
+    }
+  }
+}
+
+uint32_t AliasedImageAllocator::AddImage(const VkImageCreateInfo& create_info,
+                                         uint32_t first_pass,
+                                         uint32_t last_pass,
+                                         VkImageLayout first_layout) {
+  LOG_ASSERT(==, log_, true, memory_ == nullptr);
+  LOG_ASSERT(<=, log_, first_pass, last_pass);
+  // Linear and optimal images would have to be kept
+  // bufferImageGranularity apart, only optimal images are supported.
+  LOG_ASSERT(==, log_, create_info.tiling, VK_IMAGE_TILING_OPTIMAL);
+  images_.push_back(Image{create_info, first_pass, last_pass, first_layout,
+                          VK_NULL_HANDLE, {}, 0, false});
+  return static_cast<uint32_t>(images_.size() - 1);
+}
+
+void AliasedImageAllocator::Allocate() {
+  LOG_ASSERT(==, log_, true, memory_ == nullptr);
+  LOG_ASSERT(!=, log_, images_.size(), size_t(0));
+
+  uint32_t memory_type_bits = 0xFFFFFFFF;
+  for (auto& image : images_) {
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               (*device_)->vkCreateImage(*device_, &image.create_info,
+                                         nullptr, &image.image));
+    (*device_)->vkGetImageMemoryRequirements(*device_, image.image,
+                                             &image.requirements);
+    memory_type_bits &= image.requirements.memoryTypeBits;
+    separate_size_ += RoundUp(image.requirements.size,
+                              image.requirements.alignment);
+  }
+  // All of the images share one allocation, so they have to agree on at
+  // least one memory type.
+  LOG_ASSERT(!=, log_, memory_type_bits, 0u);
+
+  containers::vector<uint32_t> order(allocator_);
+  order.resize(images_.size());
+  for (uint32_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  // Placing the largest images first leaves the smaller ones to fill the
+  // gaps in between.
+  std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+    return images_[a].requirements.size > images_[b].requirements.size;
+  });
+
+  containers::vector<uint32_t> placed(allocator_);
+  containers::vector<uint32_t> conflicts(allocator_);
+  for (uint32_t index : order) {
+    Image& image = images_[index];
+    conflicts.clear();
+    for (uint32_t other : placed) {
+      if (Overlaps(image, images_[other])) {
+        conflicts.push_back(other);
+      }
+    }
+    std::sort(conflicts.begin(), conflicts.end(),
+              [this](uint32_t a, uint32_t b) {
+                return images_[a].offset < images_[b].offset;
+              });
+    // Find the lowest gap between the images that are alive at the same
+    // time that this image fits into.
+    ::VkDeviceSize offset = 0;
+    for (uint32_t other : conflicts) {
+      const Image& conflict = images_[other];
+      if (offset + image.requirements.size <= conflict.offset) {
+        break;
+      }
+      offset = std::max(
+          offset, RoundUp(conflict.offset + conflict.requirements.size,
+                          image.requirements.alignment));
+    }
+    image.offset = offset;
+    aliased_size_ =
+        std::max(aliased_size_, image.offset + image.requirements.size);
+    placed.push_back(index);
+  }
+
+  for (auto& image : images_) {
+    for (auto& other : images_) {
+      if (&image != &other &&
+          image.offset < other.offset + other.requirements.size &&
+          other.offset < image.offset + image.requirements.size) {
+        image.aliased = true;
+        break;
+      }
+    }
+  }
+
+  VkMemoryAllocateInfo allocate_info{
+      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,  // sType
+      nullptr,                                 // pNext
+      aliased_size_,                           // allocationSize
+      GetMemoryIndex(device_, log_, memory_type_bits,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)  // memoryTypeIndex
+  };
+  ::VkDeviceMemory memory;
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             (*device_)->vkAllocateMemory(*device_, &allocate_info, nullptr,
+                                          &memory));
+  memory_ = containers::make_unique<VkDeviceMemory>(
+      allocator_, VkDeviceMemory(memory, nullptr, device_));
+
+  for (auto& image : images_) {
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               (*device_)->vkBindImageMemory(*device_, image.image, memory,
+                                             image.offset));
+  }
+
+  log_->LogInfo("Aliased ", images_.size(), " transient images into ",
+                aliased_size_, " bytes instead of ", separate_size_,
+                " bytes, saving ", saved_size(), " bytes");
+}
+
+void AliasedImageAllocator::RecordAliasingBarriers(VkCommandBuffer* cmd,
+                                                   uint32_t pass) const {
+  LOG_ASSERT(!=, log_, true, memory_ == nullptr);
+  containers::vector<VkImageMemoryBarrier> barriers(allocator_);
+  for (auto& image : images_) {
+    if (image.first_pass != pass) {
+      continue;
+    }
+    barriers.push_back(VkImageMemoryBarrier{
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+        nullptr,                                 // pNext
+        VK_ACCESS_MEMORY_WRITE_BIT,              // srcAccessMask
+        VK_ACCESS_MEMORY_READ_BIT |
+            VK_ACCESS_MEMORY_WRITE_BIT,  // dstAccessMask
+        VK_IMAGE_LAYOUT_UNDEFINED,       // oldLayout
+        image.first_layout,              // newLayout
+        VK_QUEUE_FAMILY_IGNORED,         // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,         // dstQueueFamilyIndex
+        image.image,                     // image
+        {AspectsForFormat(image.create_info.format), 0,
+         VK_REMAINING_MIP_LEVELS, 0,
+         VK_REMAINING_ARRAY_LAYERS}  // subresourceRange
+    });
+  }
+  if (barriers.empty()) {
+    return;
+  }
+  // The images that used this memory before may have been written by any
+  // stage, so the barrier has to wait for all of them.
+  (*cmd)->vkCmdPipelineBarrier(
+      *cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr,
+      static_cast<uint32_t>(barriers.size()), barriers.data());
+}
+}  // namespace vulkan
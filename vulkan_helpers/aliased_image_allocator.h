@@ -0,0 +1,107 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_ALIASED_IMAGE_ALLOCATOR_H
+#define VULKAN_HELPERS_ALIASED_IMAGE_ALLOCATOR_H
+
+#include <cstdint>
+
+#include "support/containers/allocator.h"
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_wrapper/command_buffer_wrapper.h"
+#include "vulkan_wrapper/device_wrapper.h"
+#include "vulkan_wrapper/sub_objects.h"
+
+namespace vulkan {
+
+// Packs images that are only alive during part of a frame into a single
+// allocation of device memory. Every image is declared with the first and
+// the last pass that it is used in, and images whose lifetimes do not
+// overlap may be placed in the same memory.
+// Images are placed greedily, largest first, at the lowest offset that does
+// not overlap the memory of any image that is alive at the same time.
+// The contents of an image are undefined at the start of its first pass, so
+// every image has to be fully written before it is read.
+// All of the images of one allocator are expected to be used by a single
+// frame. Frames that may be in flight at the same time need their own
+// allocators.
+class AliasedImageAllocator {
+ public:
+  AliasedImageAllocator(containers::Allocator* allocator,
+                        logging::Logger* log, VkDevice* device);
+  ~AliasedImageAllocator();
+
+  AliasedImageAllocator(const AliasedImageAllocator&) = delete;
+  AliasedImageAllocator& operator=(const AliasedImageAllocator&) = delete;
+
+  // Declares an image that is used from first_pass up to and including
+  // last_pass. first_layout is the layout that the image is transitioned to
+  // by RecordAliasingBarriers before first_pass. Returns the index of the
+  // image. Must be called before Allocate.
+  uint32_t AddImage(const VkImageCreateInfo& create_info, uint32_t first_pass,
+                    uint32_t last_pass, VkImageLayout first_layout);
+
+  // Creates every declared image, and binds all of them to a single
+  // allocation of device memory.
+  void Allocate();
+
+  // Records the barriers that have to precede the given pass to the given
+  // command buffer. Every image whose lifetime starts in this pass is
+  // transitioned from VK_IMAGE_LAYOUT_UNDEFINED to its first layout, after
+  // all previous work on the memory that it may alias.
+  void RecordAliasingBarriers(VkCommandBuffer* cmd, uint32_t pass) const;
+
+  ::VkImage image(uint32_t index) const { return images_[index].image; }
+  // Returns true if the memory of the given image overlaps the memory of
+  // any other image.
+  bool is_aliased(uint32_t index) const { return images_[index].aliased; }
+
+  // Returns the number of bytes of device memory that the images would
+  // need if every one of them had its own range.
+  ::VkDeviceSize separate_size() const { return separate_size_; }
+  // Returns the number of bytes of device memory that are actually used.
+  ::VkDeviceSize aliased_size() const { return aliased_size_; }
+  ::VkDeviceSize saved_size() const { return separate_size_ - aliased_size_; }
+
+ private:
+  struct Image {
+    VkImageCreateInfo create_info;
+    uint32_t first_pass;
+    uint32_t last_pass;
+    VkImageLayout first_layout;
+    ::VkImage image;
+    VkMemoryRequirements requirements;
+    ::VkDeviceSize offset;
+    bool aliased;
+  };
+
+  // Returns true if the lifetimes of the two images overlap.
+  static bool Overlaps(const Image& a, const Image& b) {
+    return a.first_pass <= b.last_pass && b.first_pass <= a.last_pass;
+  }
+
+  containers::Allocator* allocator_;
+  logging::Logger* log_;
+  VkDevice* device_;
+  containers::vector<Image> images_;
+  containers::unique_ptr<VkDeviceMemory> memory_;
+  ::VkDeviceSize separate_size_;
+  ::VkDeviceSize aliased_size_;
+};
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_ALIASED_IMAGE_ALLOCATOR_H
@@ -64,6 +64,9 @@ class BufferFrameData {
   // uniform data. Note that VK_BUFFER_USAGE_TRANSFER_DST_BIT will be added
   // along with |usage| to guarantee data can be copied to the underlying
   // VkBuffer(s).
+  // If the device has device-local memory that is host visible, and
+  // |options| does not select a device mask, the data is written straight
+  // into that memory, and no copies are submitted.
   BufferFrameData(
       VulkanApplication* application, size_t buffered_data_count,
       VkBufferUsageFlags usage,
@@ -103,6 +106,12 @@ class BufferFrameData {
         VK_SHARING_MODE_EXCLUSIVE,
         1,
         &queue_family_index_};
+    if (device_mask_ == 0 && application_->has_device_host_memory()) {
+      buffer_ = application_->CreateAndBindDeviceHostBuffer(&create_info);
+      // The buffer may still have ended up in memory that is only host
+      // visible, but either way the host can write it directly.
+      return;
+    }
     buffer_ = application_->CreateAndBindDeviceBuffer(
         &create_info, set == 0 ? nullptr : &indices[0]);
 
@@ -169,6 +178,16 @@ class BufferFrameData {
   void UpdateBuffer(VkQueue* update_queue, size_t buffer_index,
                     uint32_t kDeviceMask = 0, bool force = false) {
     const size_t offset = get_offset_for_frame(buffer_index);
+    if (!host_buffer_) {
+      // The device reads the data straight from buffer_, and the next
+      // submission makes the host write visible to it. Reading device local
+      // memory back from the host can be very slow, so the data is written
+      // without comparing it first.
+      uninitialized_[buffer_index] = false;
+      memcpy(buffer_->base_address() + offset, &set_value_, size());
+      buffer_->flush(offset, aligned_data_size());
+      return;
+    }
     bool equal =
         memcmp(&set_value_, host_buffer_->base_address() + offset, size()) == 0;
     if (force || !equal || uninitialized_[buffer_index]) {
@@ -224,7 +243,7 @@ class BufferFrameData {
   // This is the gpu-side buffer that contains the uniforms.
   containers::unique_ptr<VulkanApplication::Buffer> buffer_;
   // This is the host-side buffer that contains the data that can be copied to
-  // the uniforms.
+  // the uniforms. This is nullptr if buffer_ is host visible.
   containers::unique_ptr<VulkanApplication::Buffer> host_buffer_;
   // These command-buffers contain the command needed to update the
   // device-buffer from the host buffer.
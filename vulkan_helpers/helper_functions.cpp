@@ -99,7 +99,9 @@ VkInstance CreateDefaultInstance(containers::Allocator* allocator,
              wrapper->vkCreateInstance(&info, nullptr, &raw_instance),
              VK_SUCCESS);
   // vulkan::VkInstance will handle destroying the instance
-  return vulkan::VkInstance(allocator, raw_instance, nullptr, wrapper);
+  return vulkan::VkInstance(allocator, raw_instance, nullptr, wrapper,
+                            info.enabledExtensionCount,
+                            info.ppEnabledExtensionNames);
 }
 
 VkInstance CreateVerisonedInstanceForApplicaiton(
@@ -171,7 +173,9 @@ VkInstance CreateVerisonedInstanceForApplicaiton(
              wrapper->vkCreateInstance(&info, nullptr, &raw_instance),
              VK_SUCCESS);
   // vulkan::VkInstance will handle destroying the instance
-  return vulkan::VkInstance(allocator, raw_instance, nullptr, wrapper);
+  return vulkan::VkInstance(allocator, raw_instance, nullptr, wrapper,
+                            info.enabledExtensionCount,
+                            info.ppEnabledExtensionNames);
 }
 
 VkInstance CreateInstanceForApplication(
@@ -327,7 +331,9 @@ VkDevice CreateDefaultDevice(containers::Allocator* allocator,
       instance->vkCreateDevice(physical_device, &info, nullptr, &raw_device),
       VK_SUCCESS);
   return vulkan::VkDevice(allocator, raw_device, nullptr, &instance,
-                          &properties, physical_device);
+                          &properties, physical_device, 1,
+                          info.enabledExtensionCount,
+                          info.ppEnabledExtensionNames);
 }
 
 bool SupportRequestPhysicalDeviceFeatures(
@@ -658,7 +664,9 @@ VkDevice CreateDeviceForSwapchain(
     *present_queue_index = present_queue_family_index;
     *graphics_queue_index = graphics_queue_family_index;
     return vulkan::VkDevice(allocator, raw_device, nullptr, instance,
-                            &physical_device_properties, physical_device);
+                            &physical_device_properties, physical_device, 1,
+                            info.enabledExtensionCount,
+                            info.ppEnabledExtensionNames);
   }
   instance->GetLogger()->LogError(
       "Could not find physical device or queue that can present");
@@ -925,7 +933,9 @@ VkDevice CreateDeviceGroupForSwapchain(
 
     return vulkan::VkDevice(allocator, raw_device, nullptr, instance, nullptr,
                             group.physicalDevices[0],
-                            group.physicalDeviceCount);
+                            group.physicalDeviceCount,
+                            info.enabledExtensionCount,
+                            info.ppEnabledExtensionNames);
   }
   instance->GetLogger()->LogError(
       "Could not find physical device or queue that can present");
@@ -1515,6 +1525,23 @@ std::tuple<uint32_t, uint32_t, uint32_t> GetElementAndTexelBlockSize(
   return std::make_tuple(0, 0, 0);
 }
 
+VkImageAspectFlags AspectsForFormat(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_S8_UINT:
+      return VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+      return VK_IMAGE_ASPECT_COLOR_BIT;
+  }
+}
+
 size_t GetImageExtentSizeInBytes(const VkExtent3D& extent, VkFormat format) {
   auto element_texel_block_sizes = GetElementAndTexelBlockSize(format);
   uint32_t element_size = size_t(std::get<0>(element_texel_block_sizes));
@@ -406,6 +406,10 @@ inline VkEvent CreateEvent(VkDevice* device) {
 // format is not recognized.
 size_t GetImageExtentSizeInBytes(const VkExtent3D& extent, VkFormat format);
 
+// Returns the aspects of an image with the given format: depth and/or
+// stencil for depth/stencil formats, and color for every other format.
+VkImageAspectFlags AspectsForFormat(VkFormat format);
+
 // Returns true if all the request features are supported by the given physical
 // device, otherwise returns false. The supported features are returned from
 // Vulkan command vkGetPhysicalDeviceFeatures, the command is resolved by the
@@ -0,0 +1,176 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/memory_budget.h"
+
+#include <algorithm>
+
+namespace vulkan {
+
+VulkanMemoryBudget::VulkanMemoryBudget(containers::Allocator* allocator,
+                                       logging::Logger* log,
+                                       VkInstance* instance,
+                                       ::VkPhysicalDevice physical_device,
+                                       float headroom)
+    : instance_(instance),
+      physical_device_(physical_device),
+      headroom_(headroom),
+      num_heaps_(0),
+      marks_(allocator),
+      callback_(nullptr),
+      callback_user_data_(nullptr),
+      crossed_marks_(allocator),
+      has_crossed_marks_(false),
+      log_(log) {
+  LOG_ASSERT(>=, log_, headroom_, 0.0f);
+  LOG_ASSERT(<, log_, headroom_, 1.0f);
+  for (auto& heap : heaps_) {
+    heap = Heap{0, 0, 0, 0};
+  }
+  Update();
+}
+
+void VulkanMemoryBudget::Update() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  UpdateLocked();
+}
+
+void VulkanMemoryBudget::UpdateLocked() {
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT memory_budget_properties{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+      nullptr  // pNext
+  };
+  VkPhysicalDeviceMemoryProperties2 memory_properties{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+      &memory_budget_properties  // pNext;
+  };
+  (*instance_)->vkGetPhysicalDeviceMemoryProperties2(physical_device_,
+                                                     &memory_properties);
+
+  num_heaps_ = memory_properties.memoryProperties.memoryHeapCount;
+  for (uint32_t i = 0; i < num_heaps_; ++i) {
+    heaps_[i].budget = memory_budget_properties.heapBudget[i];
+    heaps_[i].usage = memory_budget_properties.heapUsage[i];
+    heaps_[i].allocated_since_update = 0;
+    CheckHighWaterMarks(i);
+  }
+}
+
+::VkDeviceSize VulkanMemoryBudget::budget(uint32_t heap_index) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return heaps_[heap_index].budget;
+}
+
+::VkDeviceSize VulkanMemoryBudget::usage(uint32_t heap_index) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return UsageLocked(heap_index);
+}
+
+::VkDeviceSize VulkanMemoryBudget::UsageLocked(uint32_t heap_index) const {
+  const Heap& heap = heaps_[heap_index];
+  const int64_t usage =
+      static_cast<int64_t>(heap.usage) + heap.allocated_since_update;
+  return usage > 0 ? static_cast<::VkDeviceSize>(usage) : 0;
+}
+
+::VkDeviceSize VulkanMemoryBudget::available(uint32_t heap_index) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const ::VkDeviceSize limit = static_cast<::VkDeviceSize>(
+      static_cast<double>(heaps_[heap_index].budget) * (1.0 - headroom_));
+  const ::VkDeviceSize used = UsageLocked(heap_index);
+  return limit > used ? limit - used : 0;
+}
+
+void VulkanMemoryBudget::ReportAllocation(uint32_t heap_index,
+                                          ::VkDeviceSize size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  heaps_[heap_index].allocated_since_update += static_cast<int64_t>(size);
+  CheckHighWaterMarks(heap_index);
+}
+
+void VulkanMemoryBudget::ReportFree(uint32_t heap_index, ::VkDeviceSize size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  heaps_[heap_index].allocated_since_update -= static_cast<int64_t>(size);
+  CheckHighWaterMarks(heap_index);
+}
+
+void VulkanMemoryBudget::SetHighWaterMarks(
+    std::initializer_list<float> marks, MemoryHighWaterMarkCallback callback,
+    void* user_data) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    marks_.assign(marks.begin(), marks.end());
+    std::sort(marks_.begin(), marks_.end());
+    callback_ = callback;
+    callback_user_data_ = user_data;
+    // Marks that were crossed before were meant for the old callback.
+    crossed_marks_.clear();
+    for (uint32_t i = 0; i < num_heaps_; ++i) {
+      heaps_[i].marks_crossed = 0;
+      CheckHighWaterMarks(i);
+    }
+  }
+  NotifyHighWaterMarks();
+}
+
+void VulkanMemoryBudget::NotifyHighWaterMarks() {
+  if (!has_crossed_marks_.load(std::memory_order_acquire)) {
+    return;
+  }
+  while (true) {
+    CrossedMark crossed;
+    MemoryHighWaterMarkCallback callback;
+    void* user_data;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (crossed_marks_.empty()) {
+        has_crossed_marks_.store(false, std::memory_order_release);
+        return;
+      }
+      crossed = crossed_marks_.front();
+      crossed_marks_.erase(crossed_marks_.begin());
+      callback = callback_;
+      user_data = callback_user_data_;
+    }
+    log_->LogInfo("Memory heap ", crossed.heap_index, " is using ",
+                  crossed.usage, " of its ", crossed.budget, " byte budget");
+    if (callback) {
+      callback(user_data, crossed.heap_index, crossed.mark, crossed.usage,
+               crossed.budget);
+    }
+  }
+}
+
+void VulkanMemoryBudget::CheckHighWaterMarks(uint32_t heap_index) {
+  Heap& heap = heaps_[heap_index];
+  if (!callback_ || heap.budget == 0) {
+    return;
+  }
+  const ::VkDeviceSize used = UsageLocked(heap_index);
+  const double fraction =
+      static_cast<double>(used) / static_cast<double>(heap.budget);
+  size_t marks_crossed = 0;
+  while (marks_crossed < marks_.size() && fraction > marks_[marks_crossed]) {
+    ++marks_crossed;
+  }
+  // Only rising above a mark is reported, dropping below one re-arms it.
+  for (size_t i = heap.marks_crossed; i < marks_crossed; ++i) {
+    crossed_marks_.push_back(
+        CrossedMark{heap_index, marks_[i], used, heap.budget});
+    has_crossed_marks_.store(true, std::memory_order_release);
+  }
+  heap.marks_crossed = marks_crossed;
+}
+}  // namespace vulkan
@@ -0,0 +1,133 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_MEMORY_BUDGET_H
+#define VULKAN_HELPERS_MEMORY_BUDGET_H
+
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+
+#include "support/containers/allocator.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_wrapper/instance_wrapper.h"
+
+namespace vulkan {
+
+// Called when the usage of a memory heap rises above mark * budget.
+// usage and budget are in bytes.
+typedef void (*MemoryHighWaterMarkCallback)(void* user_data,
+                                            uint32_t heap_index, float mark,
+                                            ::VkDeviceSize usage,
+                                            ::VkDeviceSize budget);
+
+// Keeps track of the memory budget of every memory heap of a physical
+// device, as reported by VK_EXT_memory_budget. The budget accounts for the
+// memory that is used by other processes.
+// The driver is only queried when Update is called. In between, the usage
+// is estimated from the allocations that are reported to this object.
+// One budget is shared by every arena of a device, so it may be used from
+// several threads at once.
+class VulkanMemoryBudget {
+ public:
+  // headroom is the fraction of every heap's budget that should be left
+  // unused. VK_EXT_memory_budget must be enabled on the device, and the
+  // instance must support vkGetPhysicalDeviceMemoryProperties2.
+  VulkanMemoryBudget(containers::Allocator* allocator, logging::Logger* log,
+                     VkInstance* instance, ::VkPhysicalDevice physical_device,
+                     float headroom);
+
+  // Queries the current budget and usage of every heap from the driver.
+  void Update();
+
+  // Returns the number of bytes that can still be allocated from the given
+  // heap while staying below the budget minus the headroom.
+  ::VkDeviceSize available(uint32_t heap_index) const;
+
+  // Returns the budget and the estimated usage of the given heap, in bytes.
+  ::VkDeviceSize budget(uint32_t heap_index) const;
+  ::VkDeviceSize usage(uint32_t heap_index) const;
+
+  // Records that size bytes of device memory were allocated from, or
+  // returned to, the given heap.
+  void ReportAllocation(uint32_t heap_index, ::VkDeviceSize size);
+  void ReportFree(uint32_t heap_index, ::VkDeviceSize size);
+
+  // Calls callback whenever the usage of a heap rises above one of the given
+  // fractions of its budget. The callback is called again for a mark once
+  // usage has dropped below it and risen above it again. Replaces any
+  // previously set marks.
+  // Update, ReportAllocation and ReportFree are called by arenas with their
+  // lock held, so they only queue the marks that were crossed. The callback
+  // is called from NotifyHighWaterMarks, which the arenas call once they
+  // have released their lock, so the callback may allocate and free memory.
+  void SetHighWaterMarks(std::initializer_list<float> marks,
+                         MemoryHighWaterMarkCallback callback,
+                         void* user_data);
+
+  // Calls the high-water mark callback for every mark that was crossed since
+  // the last call. This must not be called with any lock held that the
+  // callback may need.
+  void NotifyHighWaterMarks();
+
+ private:
+  struct Heap {
+    ::VkDeviceSize budget;
+    // The usage that the driver reported at the last Update.
+    ::VkDeviceSize usage;
+    // The bytes that were reported as allocated minus the bytes that were
+    // reported as freed since the last Update. This may be negative.
+    int64_t allocated_since_update;
+    // The number of high-water marks that usage is currently above.
+    size_t marks_crossed;
+  };
+
+  // A mark that was crossed, and that the callback has not been called for.
+  struct CrossedMark {
+    uint32_t heap_index;
+    float mark;
+    ::VkDeviceSize usage;
+    ::VkDeviceSize budget;
+  };
+
+  // These must be called with mutex_ held.
+  ::VkDeviceSize UsageLocked(uint32_t heap_index) const;
+  void UpdateLocked();
+  // Queues a CrossedMark for every mark that the given heap has risen above
+  // since the last check.
+  void CheckHighWaterMarks(uint32_t heap_index);
+
+  VkInstance* instance_;
+  ::VkPhysicalDevice physical_device_;
+  float headroom_;
+  // Guards everything below.
+  mutable std::mutex mutex_;
+  uint32_t num_heaps_;
+  Heap heaps_[VK_MAX_MEMORY_HEAPS];
+  // Sorted in increasing order.
+  containers::vector<float> marks_;
+  MemoryHighWaterMarkCallback callback_;
+  void* callback_user_data_;
+  containers::vector<CrossedMark> crossed_marks_;
+  // Set while crossed_marks_ is not empty, so that NotifyHighWaterMarks
+  // does not have to take the lock when there is nothing to do.
+  std::atomic<bool> has_crossed_marks_;
+  logging::Logger* log_;
+};
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_MEMORY_BUDGET_H
@@ -16,12 +16,16 @@
 #include "vulkan_helpers/vulkan_application.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <fstream>
 #include <tuple>
 
-#include "support/containers/unordered_map.h"
+#include "support/containers/flat_hash_map.h"
+#include "support/containers/small_vector.h"
 #include "vulkan_helpers/helper_functions.h"
 #include "vulkan_helpers/vulkan_model.h"
+#include "vulkan_wrapper/call_stats.h"
 
 typedef void(VKAPI_PTR* PFN_vkSetSwapchainCallback)(
     VkSwapchainKHR, void(void*, uint8_t*, size_t), void*);
@@ -30,13 +34,14 @@ namespace vulkan {
 VkDescriptorPool DescriptorSet::CreateDescriptorPool(
     containers::Allocator* allocator, VkDevice* device,
     std::initializer_list<VkDescriptorSetLayoutBinding> bindings, void* pNext) {
-  containers::unordered_map<uint32_t, uint32_t> counts(allocator);
+  containers::flat_hash_map<uint32_t, uint32_t> counts(allocator);
   for (auto binding : bindings) {
     counts[static_cast<uint32_t>(binding.descriptorType)] +=
         binding.descriptorCount;
   }
 
-  containers::vector<VkDescriptorPoolSize> pool_sizes(allocator);
+  // There are only a handful of descriptor types in use at once.
+  containers::small_vector<VkDescriptorPoolSize, 8> pool_sizes(allocator);
   pool_sizes.reserve(counts.size());
   for (auto p : counts) {
     pool_sizes.push_back({static_cast<VkDescriptorType>(p.first), p.second});
@@ -70,6 +75,8 @@ VulkanApplication::VulkanApplication(
       render_queue_index_(0u),
       present_queue_index_(0u),
       use_protected_memory_(options.use_protected_memory),
+      use_dedicated_allocations_(false),
+      dedicated_allocation_threshold_(options.dedicated_allocation_threshold),
       library_wrapper_(allocator_, log_),
       instance_(CreateVerisonedInstanceForApplicaiton(
           allocator_, &library_wrapper_, entry_data_,
@@ -99,7 +106,20 @@ VulkanApplication::VulkanApplication(
       host_accessible_heap_(allocator_),
       coherent_heap_(allocator_),
       device_peer_memory_heaps_(allocator_),
+      defragmented_buffers_(allocator_),
+      defragmented_images_(allocator_),
+      defragmented_tokens_(allocator_),
+      defragmented_arena_size_(0),
       should_exit_(false) {
+  if (entry_data_->vulkan_call_stats()) {
+#if defined(VULKAN_CALL_PROFILING)
+    call_stats::Start();
+#else
+    LOG_WARNING(log_,
+                "-vulkan-call-stats needs a build with VULKAN_CALL_PROFILING, "
+                "no calls are recorded");
+#endif
+  }
   if (!device_.is_valid()) {
     return;
   }
@@ -189,10 +209,28 @@ VulkanApplication::VulkanApplication(
                                      options.coherent_buffer_size};
 
   VkMemoryAllocateFlags flags[3] = {0, 0, 0};
+  bool has_memory_budget = false;
   for (auto ext : device_extensions) {
     if (strcmp(ext, VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME) == 0) {
       flags[1] = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-      break;
+    } else if (strcmp(ext, VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME) == 0) {
+      use_dedicated_allocations_ = true;
+    } else if (strcmp(ext, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+      has_memory_budget = true;
+    }
+  }
+
+  VulkanArenaGrowthPolicy growth_policy = options.arena_growth_policy;
+  if (options.use_memory_budget) {
+    if (has_memory_budget) {
+      memory_budget_ = containers::make_unique<VulkanMemoryBudget>(
+          allocator_, allocator_, log_, &instance_, device_.physical_device(),
+          options.memory_budget_headroom);
+      growth_policy.budget = memory_budget_.get();
+    } else {
+      log_->LogError("The memory budget was requested, but ",
+                     VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+                     " is not enabled. Ignoring the budget.");
     }
   }
 
@@ -210,6 +248,59 @@ VulkanApplication::VulkanApplication(
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
           (use_protected_memory_ ? VK_MEMORY_PROPERTY_PROTECTED_BIT : 0u),
       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+  VkPhysicalDeviceProperties physical_device_properties;
+  instance_->vkGetPhysicalDeviceProperties(device_.physical_device(),
+                                           &physical_device_properties);
+  const ::VkDeviceSize buffer_image_granularity =
+      physical_device_properties.limits.bufferImageGranularity;
+
+  // Find the memory type of device-only images up front. If buffers can use
+  // it as well, buffers and images share one arena, which has to be sized
+  // for both.
+  // The relevant bits from the spec are:
+  //  The memoryTypeBits member is identical for all VkImage objects created
+  //  with the same combination of values for the tiling member and the
+  //  VK_IMAGE_CREATE_SPARSE_BINDING_BIT bit of the flags member and the
+  //  VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT of the usage member in the
+  //  VkImageCreateInfo structure passed to vkCreateImage.
+  VkImageCreateInfo image_create_info{
+      VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+      nullptr,                              // pNext
+      0,                                    // flags
+      VK_IMAGE_TYPE_2D,                     // imageType
+      VK_FORMAT_R8G8B8A8_UNORM,             // format
+      {
+          // extent
+          1,  // width
+          1,  // height
+          1,  // depth
+      },
+      1,                                    // mipLevels
+      1,                                    // arrayLayers
+      VK_SAMPLE_COUNT_1_BIT,                // samples
+      VK_IMAGE_TILING_OPTIMAL,              // tiling
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,  // usage
+      VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+      0,                                    // queueFamilyIndexCount
+      nullptr,                              // pQueueFamilyIndices
+      VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+  };
+  uint32_t device_image_memory_index = 0;
+  {
+    ::VkImage image;
+    LOG_ASSERT(
+        ==, log_,
+        device_->vkCreateImage(device_, &image_create_info, nullptr, &image),
+        VK_SUCCESS);
+    VkMemoryRequirements requirements;
+    device_->vkGetImageMemoryRequirements(device_, image, &requirements);
+    device_->vkDestroyImage(device_, image, nullptr);
+    device_image_memory_index =
+        GetMemoryIndex(&device_, log_, requirements.memoryTypeBits,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+
+  uint32_t device_buffer_memory_index = 0;
   bool m_gpu = device_.num_devices() > 1;
   for (size_t j = 0; j < device_.num_devices(); ++j) {
     for (size_t i = 0; i < 3; ++i) {
@@ -251,9 +342,78 @@ VulkanApplication::VulkanApplication(
 
       uint32_t memory_index = GetMemoryIndex(
           &device_, log_, requirements.memoryTypeBits, property_flags[i]);
+      ::VkDeviceSize size = device_memory_sizes[i];
+      if (i == 1 && memory_index == device_image_memory_index) {
+        // Images are allocated from this arena as well.
+        size += options.device_image_size;
+      }
       *device_memories[i][j] = containers::make_unique<VulkanArena>(
-          allocator_, allocator_, log_, device_memory_sizes[i], memory_index,
-          &device_, host_mapped, m_gpu ? device_mask : 0, flags[i]);
+          allocator_, allocator_, log_, size, memory_index, &device_,
+          host_mapped, m_gpu ? device_mask : 0, flags[i], growth_policy,
+          options.arena_strategy, options.arena_thread_caches);
+      if (i == 1) {
+        device_buffer_memory_index = memory_index;
+        device_only_buffer_heap_->SetBufferImageGranularity(
+            buffer_image_granularity);
+      }
+
+      // The transient ring shares its memory type with the host-visible
+      // heap. It is only used when there is a single device, and only if the
+      // application retires its frames.
+      if (i == 0 && !m_gpu && options.use_transient_host_ring &&
+          options.transient_host_buffer_size > 0) {
+        transient_host_heap_ = containers::make_unique<VulkanLinearArena>(
+            allocator_, allocator_, log_, options.transient_host_buffer_size,
+            memory_index, &device_);
+      }
+    }
+  }
+
+  // On UMA devices, and on discrete devices with resizable BAR, some device
+  // local memory can be mapped. Buffers that the host rewrites every frame
+  // can live there without staging copies.
+  if (options.device_host_buffer_size > 0 && !m_gpu &&
+      !use_protected_memory_) {
+    VkBufferCreateInfo create_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+        nullptr,                               // pNext
+        0,                                     // flags
+        1,                                     // size
+        kAllBufferBits,                        // usage
+        VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+        0,                                     // queueFamilyIndexCount
+        nullptr,                               //  pQueueFamilyIndices
+    };
+    ::VkBuffer buffer;
+    LOG_ASSERT(==, log_,
+               device_->vkCreateBuffer(device_, &create_info, nullptr, &buffer),
+               VK_SUCCESS);
+    VkMemoryRequirements requirements;
+    device_->vkGetBufferMemoryRequirements(device_, buffer, &requirements);
+    device_->vkDestroyBuffer(device_, buffer, nullptr);
+
+    // GetMemoryIndex would fall back to memory that is not device local,
+    // so look for the memory type by hand.
+    const VkMemoryPropertyFlags device_host_flags =
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    const VkPhysicalDeviceMemoryProperties& memory_properties =
+        device_.physical_device_memory_properties();
+    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
+      if ((requirements.memoryTypeBits & (1 << i)) &&
+          (memory_properties.memoryTypes[i].propertyFlags &
+           device_host_flags) == device_host_flags) {
+        device_host_heap_ = containers::make_unique<VulkanArena>(
+            allocator_, allocator_, log_, options.device_host_buffer_size, i,
+            &device_, true, 0, flags[1], growth_policy,
+            options.arena_strategy, options.arena_thread_caches);
+        break;
+      }
+    }
+    if (!device_host_heap_) {
+      log_->LogInfo(
+          "No device local memory is host visible, device-host buffers will "
+          "use the host-visible heap");
     }
   }
 
@@ -322,58 +482,64 @@ VulkanApplication::VulkanApplication(
 
     device_peer_memory_heaps_.push_back(containers::make_unique<VulkanArena>(
         allocator_, allocator_, log_, options.device_peer_memory_size,
-        memory_index0, &device_, false));
+        memory_index0, &device_, false, 0, 0, growth_policy,
+        options.arena_strategy, options.arena_thread_caches));
 
     device_peer_memory_heaps_.push_back(containers::make_unique<VulkanArena>(
         allocator_, allocator_, log_, options.device_peer_memory_size,
-        memory_index1, &device_, false));
+        memory_index1, &device_, false, 0, 0, growth_policy,
+        options.arena_strategy, options.arena_thread_caches));
   }
 
-  // Same idea as above, but for image memory.
-  // The relevant bits from the spec are:
-  //  The memoryTypeBits member is identical for all VkImage objects created
-  //  with the same combination of values for the tiling member and the
-  //  VK_IMAGE_CREATE_SPARSE_BINDING_BIT bit of the flags member and the
-  //  VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT of the usage member in the
-  //  VkImageCreateInfo structure passed to vkCreateImage.
+  // Now the image memory.
   {
-    VkImageCreateInfo image_create_info{
-        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
-        nullptr,                              // pNext
-        0,                                    // flags
-        VK_IMAGE_TYPE_2D,                     // imageType
-        VK_FORMAT_R8G8B8A8_UNORM,             // format
-        {
-            // extent
-            1,  // width
-            1,  // height
-            1,  // depth
-        },
-        1,                                    // mipLevels
-        1,                                    // arrayLayers
-        VK_SAMPLE_COUNT_1_BIT,                // samples
-        VK_IMAGE_TILING_OPTIMAL,              // tiling
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,  // usage
-        VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
-        0,                                    // queueFamilyIndexCount
-        nullptr,                              // pQueueFamilyIndices
-        VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
-    };
-    ::VkImage image;
-    LOG_ASSERT(
-        ==, log_,
-        device_->vkCreateImage(device_, &image_create_info, nullptr, &image),
-        VK_SUCCESS);
-    VkMemoryRequirements requirements;
-    device_->vkGetImageMemoryRequirements(device_, image, &requirements);
-    device_->vkDestroyImage(device_, image, nullptr);
+    if (device_image_memory_index == device_buffer_memory_index) {
+      // Buffers and images can live in the same memory, the arena takes
+      // care of bufferImageGranularity, so do not reserve a second heap.
+      image_heap_ = device_only_buffer_heap_.get();
+    } else {
+      device_only_image_heap_ = containers::make_unique<VulkanArena>(
+          allocator_, allocator_, log_, options.device_image_size,
+          device_image_memory_index, &device_, false, 0, 0, growth_policy,
+          options.arena_strategy, options.arena_thread_caches);
+      device_only_image_heap_->SetBufferImageGranularity(
+          buffer_image_granularity);
+      image_heap_ = device_only_image_heap_.get();
+    }
 
-    uint32_t memory_index =
-        GetMemoryIndex(&device_, log_, requirements.memoryTypeBits,
-                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    device_only_image_heap_ = containers::make_unique<VulkanArena>(
-        allocator_, allocator_, log_, options.device_image_size, memory_index,
-        &device_, false);
+    // Transient attachments may be able to live in lazily allocated memory,
+    // which on tiled GPUs may never actually be backed by physical memory.
+    if (options.transient_image_size > 0) {
+      image_create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+      ::VkImage image;
+      LOG_ASSERT(
+          ==, log_,
+          device_->vkCreateImage(device_, &image_create_info, nullptr, &image),
+          VK_SUCCESS);
+      VkMemoryRequirements requirements;
+      device_->vkGetImageMemoryRequirements(device_, image, &requirements);
+      device_->vkDestroyImage(device_, image, nullptr);
+
+      const VkPhysicalDeviceMemoryProperties& memory_properties =
+          device_.physical_device_memory_properties();
+      for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
+        if ((requirements.memoryTypeBits & (1 << i)) &&
+            (memory_properties.memoryTypes[i].propertyFlags &
+             VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+          transient_image_heap_ = containers::make_unique<VulkanArena>(
+              allocator_, allocator_, log_, options.transient_image_size, i,
+              &device_, false, 0, 0, growth_policy, options.arena_strategy,
+              options.arena_thread_caches);
+          break;
+        }
+      }
+      if (!transient_image_heap_) {
+        log_->LogInfo(
+            "No lazily allocated memory type, transient attachments will use "
+            "the device-only image heap");
+      }
+    }
   }
 }
 
@@ -463,6 +629,165 @@ void VulkanApplication::InitializationComplete() {
   }
 }
 
+VulkanApplication::~VulkanApplication() {
+#if defined(VULKAN_CALL_PROFILING)
+  if (entry_data_->vulkan_call_stats()) {
+    call_stats::Stop();
+    call_stats::Log(allocator_, log_);
+  }
+#endif
+  if (entry_data_->memory_stats_file()) {
+    if (!WriteMemoryStats(entry_data_->memory_stats_file())) {
+      log_->LogError("Could not write memory statistics to ",
+                     entry_data_->memory_stats_file());
+    }
+  }
+}
+
+void VulkanApplication::GetMemoryStats(
+    containers::vector<NamedArenaStats>* stats) const {
+  auto add = [stats](const char* name, const VulkanArena* arena) {
+    if (!arena) {
+      return;
+    }
+    stats->push_back(NamedArenaStats{name, VulkanArenaStats()});
+    arena->GetStats(&stats->back().stats);
+  };
+  for (auto& heap : host_accessible_heap_) {
+    add("host_accessible", heap.get());
+  }
+  for (auto& heap : coherent_heap_) {
+    add("coherent", heap.get());
+  }
+  add("device_only_buffer", device_only_buffer_heap_.get());
+  add("device_only_image", device_only_image_heap_.get());
+  add("transient_image", transient_image_heap_.get());
+  add("device_host", device_host_heap_.get());
+  for (auto& heap : device_peer_memory_heaps_) {
+    add("device_peer_memory", heap.get());
+  }
+}
+
+bool VulkanApplication::WriteMemoryStats(const char* file_name) const {
+  containers::vector<NamedArenaStats> stats(allocator_);
+  GetMemoryStats(&stats);
+
+  std::ofstream file(file_name, std::ios::out | std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+  file << "{\n  \"arenas\": [";
+  for (size_t i = 0; i < stats.size(); ++i) {
+    const VulkanArenaStats& arena = stats[i].stats;
+    file << (i == 0 ? "\n" : ",\n") << "    {"
+         << "\"name\": \"" << stats[i].name << "\", "
+         << "\"memory_type_index\": " << arena.memory_type_index << ", "
+         << "\"heap_index\": " << arena.heap_index << ", "
+         << "\"total_size\": " << arena.total_size << ", "
+         << "\"peak_total_size\": " << arena.peak_total_size << ", "
+         << "\"dedicated_size\": " << arena.dedicated_size << ", "
+         << "\"num_blocks\": " << arena.num_blocks << ", "
+         << "\"used_size\": " << arena.used_size << ", "
+         << "\"peak_used_size\": " << arena.peak_used_size << ", "
+         << "\"num_free_ranges\": " << arena.num_free_ranges << ", "
+         << "\"free_size\": " << arena.free_size << ", "
+         << "\"largest_free_range\": " << arena.largest_free_range << ", "
+         << "\"fragmentation\": " << arena.fragmentation << ", "
+         << "\"num_allocations\": " << arena.num_allocations << ", "
+         << "\"total_allocations\": " << arena.total_allocations << ", "
+         << "\"total_frees\": " << arena.total_frees << "}";
+  }
+  file << "\n  ]";
+
+  // The same numbers summed over every arena that shares a memory heap.
+  containers::vector<VulkanArenaStats> heaps(allocator_);
+  for (auto& named : stats) {
+    const VulkanArenaStats& arena = named.stats;
+    if (heaps.size() <= arena.heap_index) {
+      heaps.resize(arena.heap_index + 1);
+    }
+    VulkanArenaStats& heap = heaps[arena.heap_index];
+    heap.heap_index = arena.heap_index;
+    heap.total_size += arena.total_size;
+    heap.used_size += arena.used_size;
+    heap.num_allocations += arena.num_allocations;
+    heap.total_allocations += arena.total_allocations;
+    heap.total_frees += arena.total_frees;
+  }
+  file << ",\n  \"heaps\": [";
+  for (size_t i = 0; i < heaps.size(); ++i) {
+    const VulkanArenaStats& heap = heaps[i];
+    file << (i == 0 ? "\n" : ",\n") << "    {"
+         << "\"heap_index\": " << i << ", "
+         << "\"total_size\": " << heap.total_size << ", "
+         << "\"used_size\": " << heap.used_size << ", "
+         << "\"num_allocations\": " << heap.num_allocations << ", "
+         << "\"total_allocations\": " << heap.total_allocations << ", "
+         << "\"total_frees\": " << heap.total_frees << "}";
+  }
+  file << "\n  ]\n}\n";
+  return static_cast<bool>(file);
+}
+
+VkMemoryRequirements VulkanApplication::GetImageMemoryRequirements(
+    ::VkImage image, bool* dedicated) {
+  *dedicated = false;
+  if (!use_dedicated_allocations_) {
+    VkMemoryRequirements requirements;
+    device_->vkGetImageMemoryRequirements(device_, image, &requirements);
+    return requirements;
+  }
+  VkMemoryDedicatedRequirements dedicated_requirements{
+      VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS, nullptr, VK_FALSE,
+      VK_FALSE};
+  VkMemoryRequirements2 requirements{VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+                                     &dedicated_requirements, {}};
+  VkImageMemoryRequirementsInfo2 requirements_info{
+      VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2_KHR, nullptr, image};
+  device_->vkGetImageMemoryRequirements2KHR(device_, &requirements_info,
+                                            &requirements);
+  *dedicated = dedicated_requirements.prefersDedicatedAllocation ||
+               dedicated_requirements.requiresDedicatedAllocation ||
+               (dedicated_allocation_threshold_ != 0 &&
+                requirements.memoryRequirements.size >=
+                    dedicated_allocation_threshold_);
+  return requirements.memoryRequirements;
+}
+
+VkMemoryRequirements VulkanApplication::GetBufferMemoryRequirements(
+    ::VkBuffer buffer, bool* dedicated) {
+  *dedicated = false;
+  if (!use_dedicated_allocations_) {
+    VkMemoryRequirements requirements;
+    device_->vkGetBufferMemoryRequirements(device_, buffer, &requirements);
+    return requirements;
+  }
+  VkMemoryDedicatedRequirements dedicated_requirements{
+      VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS, nullptr, VK_FALSE,
+      VK_FALSE};
+  VkMemoryRequirements2 requirements{VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+                                     &dedicated_requirements, {}};
+  VkBufferMemoryRequirementsInfo2 requirements_info{
+      VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2_KHR, nullptr,
+      buffer};
+  device_->vkGetBufferMemoryRequirements2KHR(device_, &requirements_info,
+                                             &requirements);
+  *dedicated = dedicated_requirements.prefersDedicatedAllocation ||
+               dedicated_requirements.requiresDedicatedAllocation ||
+               (dedicated_allocation_threshold_ != 0 &&
+                requirements.memoryRequirements.size >=
+                    dedicated_allocation_threshold_);
+  return requirements.memoryRequirements;
+}
+
+namespace {
+// Returns the kind of arena resource an image with the given tiling is.
+VulkanArenaResourceKind ResourceKindForTiling(VkImageTiling tiling) {
+  return tiling == VK_IMAGE_TILING_LINEAR ? VulkanArenaResourceKind::kLinear
+                                          : VulkanArenaResourceKind::kNonLinear;
+}
+}  // anonymous namespace
+
 containers::unique_ptr<VulkanApplication::Image>
 VulkanApplication::CreateAndBindImage(const VkImageCreateInfo* create_info,
                                       const uint32_t* device_indices) {
@@ -470,14 +795,33 @@ VulkanApplication::CreateAndBindImage(const VkImageCreateInfo* create_info,
   LOG_ASSERT(==, log_,
              device_->vkCreateImage(device_, create_info, nullptr, &image),
              VK_SUCCESS);
-  VkMemoryRequirements requirements;
-  device_->vkGetImageMemoryRequirements(device_, image, &requirements);
+  bool dedicated;
+  VkMemoryRequirements requirements =
+      GetImageMemoryRequirements(image, &dedicated);
 
   ::VkDeviceMemory memory;
   ::VkDeviceSize offset;
 
-  AllocationToken* token = device_only_image_heap_->AllocateMemory(
-      requirements.size, requirements.alignment, &memory, &offset, nullptr);
+  VulkanArena* heap = image_heap_;
+  if (transient_image_heap_ &&
+      (create_info->usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) &&
+      (requirements.memoryTypeBits &
+       (1 << transient_image_heap_->memory_type_index()))) {
+    // Lazily allocated memory is only committed as needed, so there is
+    // nothing to gain from a dedicated allocation.
+    heap = transient_image_heap_.get();
+    dedicated = false;
+  }
+
+  AllocationToken* token =
+      dedicated ? heap->AllocateDedicatedMemory(
+                      requirements.size, image, VK_NULL_HANDLE, &memory,
+                      &offset, nullptr,
+                      ResourceKindForTiling(create_info->tiling))
+                : heap->AllocateMemory(
+                      requirements.size, requirements.alignment, &memory,
+                      &offset, nullptr,
+                      ResourceKindForTiling(create_info->tiling));
 
   if (device_.num_devices() > 1) {
     uint32_t indices[VK_MAX_DEVICE_GROUP_SIZE];
@@ -507,8 +851,8 @@ VulkanApplication::CreateAndBindImage(const VkImageCreateInfo* create_info,
   // We have to do it this way because Image is private and friended,
   // so we cannot go through make_unique.
   Image* img = new (allocator_->malloc(sizeof(Image)))
-      Image(device_only_image_heap_.get(), token,
-            VkImage(image, nullptr, &device_), create_info->format);
+      Image(heap, token, VkImage(image, nullptr, &device_),
+            create_info->format);
 
   return containers::unique_ptr<Image>(
       img, containers::UniqueDeleter(allocator_, sizeof(Image)));
@@ -537,8 +881,9 @@ VulkanApplication::CreateAndBindSparseImage(
   for (size_t i = 0; i < num_slice; i++) {
     ::VkDeviceMemory memory;
     ::VkDeviceSize offset;
-    AllocationToken* token = device_only_image_heap_->AllocateMemory(
-        slice_size, requirements.alignment, &memory, &offset, nullptr);
+    AllocationToken* token = image_heap_->AllocateMemory(
+        slice_size, requirements.alignment, &memory, &offset, nullptr,
+        ResourceKindForTiling(create_info->tiling));
     tokens.push_back(token);
     binds.emplace_back(
         VkSparseMemoryBind{resourceOffset, slice_size, memory, offset, 0});
@@ -569,7 +914,7 @@ VulkanApplication::CreateAndBindSparseImage(
   // We have to do it this way because Image is private and friended,
   // so we cannot go through make_unique.
   SparseImage* img = new (allocator_->malloc(sizeof(SparseImage)))
-      SparseImage(device_only_image_heap_.get(), std::move(tokens),
+      SparseImage(image_heap_, std::move(tokens),
                   VkImage(image, nullptr, &device_), create_info->format);
 
   return containers::unique_ptr<SparseImage>(
@@ -617,10 +962,10 @@ VulkanApplication::CreateAndBindMultiPlanarImage(
       device_->vkGetImageMemoryRequirements2KHR(device_, &requirementsInfo,
                                                 &requirements);
 
-      token = device_only_image_heap_->AllocateMemory(
+      token = image_heap_->AllocateMemory(
           requirements.memoryRequirements.size,
           requirements.memoryRequirements.alignment, &memory[i], &offset[i],
-          nullptr);
+          nullptr, ResourceKindForTiling(create_info->tiling));
 
       planeBinding[i].sType =
           VK_STRUCTURE_TYPE_BIND_IMAGE_PLANE_MEMORY_INFO_KHR;
@@ -643,16 +988,17 @@ VulkanApplication::CreateAndBindMultiPlanarImage(
     device_->vkGetImageMemoryRequirements2KHR(device_, &requirementsInfo,
                                               &requirements);
 
-    token = device_only_image_heap_->AllocateMemory(
+    token = image_heap_->AllocateMemory(
         requirements.memoryRequirements.size,
-        requirements.memoryRequirements.alignment, &memory, &offset, nullptr);
+        requirements.memoryRequirements.alignment, &memory, &offset, nullptr,
+        ResourceKindForTiling(create_info->tiling));
     device_->vkBindImageMemory(device_, image, memory, offset);
   }
 
   // We have to do it this way because Image is private and friended,
   // so we cannot go through make_unique.
   Image* img = new (allocator_->malloc(sizeof(Image)))
-      Image(device_only_image_heap_.get(), token,
+      Image(image_heap_, token,
             VkImage(image, nullptr, &device_), create_info->format);
 
   return containers::unique_ptr<Image>(
@@ -691,15 +1037,28 @@ VulkanApplication::CreateAndBindBuffer(VulkanArena* heap,
              device_->vkCreateBuffer(device_, create_info, nullptr, &buffer),
              VK_SUCCESS);
   // Get the memory requirements for this buffer.
-  VkMemoryRequirements requirements;
-  device_->vkGetBufferMemoryRequirements(device_, buffer, &requirements);
+  bool dedicated;
+  VkMemoryRequirements requirements =
+      GetBufferMemoryRequirements(buffer, &dedicated);
+  return BindBuffer(heap, buffer, requirements, dedicated, device_indices);
+}
+
+containers::unique_ptr<VulkanApplication::Buffer>
+VulkanApplication::BindBuffer(VulkanArena* heap, ::VkBuffer buffer,
+                              const VkMemoryRequirements& requirements,
+                              bool dedicated, const uint32_t* device_indices) {
   ::VkDeviceMemory memory;
   ::VkDeviceSize offset;
   char* base_address;
 
   AllocationToken* token =
-      heap->AllocateMemory(requirements.size, requirements.alignment, &memory,
-                           &offset, &base_address);
+      dedicated ? heap->AllocateDedicatedMemory(
+                      requirements.size, VK_NULL_HANDLE, buffer, &memory,
+                      &offset, &base_address, VulkanArenaResourceKind::kLinear)
+                : heap->AllocateMemory(requirements.size,
+                                       requirements.alignment, &memory,
+                                       &offset, &base_address,
+                                       VulkanArenaResourceKind::kLinear);
 
   if (device_.num_devices() > 1) {
     uint32_t indices[VK_MAX_DEVICE_GROUP_SIZE];
@@ -746,6 +1105,56 @@ VulkanApplication::CreateAndBindHostBuffer(
                              create_info, device_indices);
 }
 
+containers::unique_ptr<VulkanApplication::Buffer>
+VulkanApplication::CreateTransientHostBuffer(
+    const VkBufferCreateInfo* create_info) {
+  if (!transient_host_heap_) {
+    return CreateAndBindHostBuffer(create_info);
+  }
+  ::VkBuffer buffer;
+  LOG_ASSERT(==, log_,
+             device_->vkCreateBuffer(device_, create_info, nullptr, &buffer),
+             VK_SUCCESS);
+  // Get the memory requirements for this buffer.
+  VkMemoryRequirements requirements;
+  device_->vkGetBufferMemoryRequirements(device_, buffer, &requirements);
+  ::VkDeviceMemory memory;
+  ::VkDeviceSize offset;
+  char* base_address;
+
+  if (!(requirements.memoryTypeBits &
+        (1 << transient_host_heap_->memory_type_index())) ||
+      !transient_host_heap_->AllocateMemory(requirements.size,
+                                            requirements.alignment, &memory,
+                                            &offset, &base_address)) {
+    // The ring cannot hold this buffer, so use the general purpose heap.
+    device_->vkDestroyBuffer(device_, buffer, nullptr);
+    return CreateAndBindHostBuffer(create_info);
+  }
+  device_->vkBindBufferMemory(device_, buffer, memory, offset);
+
+  // The buffer does not own its memory, so it has no heap.
+  Buffer* buff = new (allocator_->malloc(sizeof(Buffer))) Buffer(
+      nullptr, nullptr, VkBuffer(buffer, nullptr, &device_), base_address,
+      device_, memory, offset, requirements.size,
+      &(device_->vkFlushMappedMemoryRanges),
+      &(device_->vkInvalidateMappedMemoryRanges));
+  return containers::unique_ptr<Buffer>(
+      buff, containers::UniqueDeleter(allocator_, sizeof(Buffer)));
+}
+
+void VulkanApplication::EndTransientFrame(::VkFence fence) {
+  if (transient_host_heap_) {
+    transient_host_heap_->EndFrame(fence);
+  }
+}
+
+void VulkanApplication::RetireTransientFrames(::VkFence fence) {
+  if (transient_host_heap_) {
+    transient_host_heap_->RetireFrames(fence);
+  }
+}
+
 containers::unique_ptr<VulkanApplication::Buffer>
 VulkanApplication::CreateAndBindCoherentBuffer(
     const VkBufferCreateInfo* create_info, const uint32_t* device_indices) {
@@ -811,6 +1220,29 @@ VulkanApplication::CreateAndBindDeviceBuffer(
                              device_indices);
 }
 
+containers::unique_ptr<VulkanApplication::Buffer>
+VulkanApplication::CreateAndBindDeviceHostBuffer(
+    const VkBufferCreateInfo* create_info) {
+  ::VkBuffer buffer;
+  LOG_ASSERT(==, log_,
+             device_->vkCreateBuffer(device_, create_info, nullptr, &buffer),
+             VK_SUCCESS);
+  bool dedicated;
+  VkMemoryRequirements requirements =
+      GetBufferMemoryRequirements(buffer, &dedicated);
+  // Some usages may keep the buffer out of the device local memory, those
+  // buffers live in the host-visible heap.
+  VulkanArena* heap = host_accessible_heap_[0].get();
+  if (device_host_heap_ &&
+      (requirements.memoryTypeBits &
+       (1u << device_host_heap_->memory_type_index()))) {
+    heap = device_host_heap_.get();
+  }
+  LOG_ASSERT(!=, log_, 0u,
+             requirements.memoryTypeBits & (1u << heap->memory_type_index()));
+  return BindBuffer(heap, buffer, requirements, dedicated, nullptr);
+}
+
 containers::unique_ptr<VulkanApplication::Buffer>
 VulkanApplication::CreateAndBindPeerBuffer(
     const VkBufferCreateInfo* create_info, uint32_t device_idx) {
@@ -841,6 +1273,234 @@ VulkanApplication::CreateAndBindDefaultExclusiveDeviceBuffer(
   return CreateAndBindDeviceBuffer(&create_info, device_indices);
 }
 
+void VulkanApplication::MarkMovable(Buffer* buffer,
+                                    const VkBufferCreateInfo* create_info) {
+  LOG_ASSERT(==, log_, device_.num_devices(), 1u);
+  LOG_ASSERT(==, log_, buffer->heap_, device_only_buffer_heap_.get());
+  LOG_ASSERT(==, log_, create_info->pNext,
+             static_cast<const void*>(nullptr));
+  LOG_ASSERT(==, log_, create_info->sharingMode, VK_SHARING_MODE_EXCLUSIVE);
+  const VkBufferUsageFlags transfer_usage =
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  LOG_ASSERT(==, log_, create_info->usage & transfer_usage, transfer_usage);
+  buffer->create_info_ = *create_info;
+  buffer->create_info_.queueFamilyIndexCount = 0;
+  buffer->create_info_.pQueueFamilyIndices = nullptr;
+  buffer->heap_->SetOwner(buffer->token_, buffer);
+}
+
+void VulkanApplication::MarkMovable(Image* image,
+                                    const VkImageCreateInfo* create_info,
+                                    VkImageLayout layout) {
+  LOG_ASSERT(==, log_, device_.num_devices(), 1u);
+  LOG_ASSERT(==, log_, image->heap_, image_heap_);
+  LOG_ASSERT(==, log_, create_info->pNext,
+             static_cast<const void*>(nullptr));
+  LOG_ASSERT(==, log_, create_info->sharingMode, VK_SHARING_MODE_EXCLUSIVE);
+  LOG_ASSERT(==, log_, create_info->tiling, VK_IMAGE_TILING_OPTIMAL);
+  LOG_ASSERT(==, log_, create_info->flags & VK_IMAGE_CREATE_DISJOINT_BIT,
+             0u);
+  const VkImageUsageFlags transfer_usage =
+      VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  LOG_ASSERT(==, log_, create_info->usage & transfer_usage, transfer_usage);
+  image->create_info_ = *create_info;
+  image->create_info_.queueFamilyIndexCount = 0;
+  image->create_info_.pQueueFamilyIndices = nullptr;
+  image->create_info_.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  image->layout_ = layout;
+  image->heap_->SetOwner(image->token_, image);
+}
+
+void VulkanApplication::DefragmentDeviceMemory(
+    VkCommandBuffer* command_buffer, ::VkDeviceSize max_bytes_to_move,
+    DefragmentationStats* stats) {
+  // The previous defragmentation must have been finished.
+  LOG_ASSERT(==, log_, defragmented_tokens_.size(), 0u);
+
+  VulkanArena* heaps[2] = {device_only_buffer_heap_.get(), image_heap_};
+  const size_t num_heaps = heaps[0] == heaps[1] ? 1 : 2;
+
+  containers::vector<VulkanArena::Move> moves(allocator_);
+  containers::vector<size_t> heap_move_end(allocator_);
+  defragmented_arena_size_ = 0;
+  stats->allocations_moved = 0;
+  stats->bytes_moved = 0;
+  stats->largest_free_range_before = 0;
+  for (size_t i = 0; i < num_heaps; ++i) {
+    defragmented_arena_size_ += heaps[i]->total_size();
+    stats->largest_free_range_before = std::max(
+        stats->largest_free_range_before, heaps[i]->largest_free_range());
+    heaps[i]->PlanDefragmentation(max_bytes_to_move, &moves);
+    heap_move_end.push_back(moves.size());
+  }
+
+  containers::vector<VkImageMemoryBarrier> pre_barriers(allocator_);
+  containers::vector<VkImageMemoryBarrier> post_barriers(allocator_);
+  // The copies to record once the pre_barriers are in place. Buffers are
+  // only copied whole, images with every mip level and array layer.
+  struct Copy {
+    ::VkBuffer src_buffer;
+    ::VkBuffer dst_buffer;
+    ::VkImage src_image;
+    ::VkImage dst_image;
+    const VulkanApplication::Image* image;
+    ::VkDeviceSize size;
+  };
+  containers::vector<Copy> copies(allocator_);
+
+  size_t heap = 0;
+  for (size_t i = 0; i < moves.size(); ++i) {
+    while (i >= heap_move_end[heap]) {
+      ++heap;
+    }
+    const VulkanArena::Move& move = moves[i];
+    defragmented_tokens_.push_back(std::make_pair(heaps[heap], move.old_token));
+    VkMemoryRequirements requirements;
+    if (move.kind == VulkanArenaResourceKind::kLinear) {
+      // Only buffers can be linear, since movable images must be optimal.
+      Buffer* buffer = static_cast<Buffer*>(move.owner);
+      ::VkBuffer raw_buffer;
+      LOG_ASSERT(==, log_,
+                 device_->vkCreateBuffer(device_, &buffer->create_info_,
+                                         nullptr, &raw_buffer),
+                 VK_SUCCESS);
+      device_->vkGetBufferMemoryRequirements(device_, raw_buffer,
+                                             &requirements);
+      LOG_ASSERT(==, log_, requirements.size, buffer->size_);
+      device_->vkBindBufferMemory(device_, raw_buffer, move.memory,
+                                  move.offset);
+      defragmented_buffers_.push_back(std::move(buffer->buffer_));
+      buffer->buffer_.initialize(raw_buffer);
+      buffer->token_ = move.new_token;
+      buffer->memory_ = move.memory;
+      buffer->offset_ = move.offset;
+      copies.push_back({defragmented_buffers_.back(), raw_buffer,
+                        VK_NULL_HANDLE, VK_NULL_HANDLE, nullptr,
+                        buffer->size_});
+    } else {
+      Image* image = static_cast<Image*>(move.owner);
+      ::VkImage raw_image;
+      LOG_ASSERT(==, log_,
+                 device_->vkCreateImage(device_, &image->create_info_,
+                                        nullptr, &raw_image),
+                 VK_SUCCESS);
+      device_->vkGetImageMemoryRequirements(device_, raw_image, &requirements);
+      device_->vkBindImageMemory(device_, raw_image, move.memory, move.offset);
+      defragmented_images_.push_back(std::move(image->image_));
+      image->image_.initialize(raw_image);
+      image->token_ = move.new_token;
+
+      const VkImageSubresourceRange range{
+          AspectsForFormat(image->create_info_.format), 0,
+          image->create_info_.mipLevels, 0, image->create_info_.arrayLayers};
+      pre_barriers.push_back({VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr,
+                              kAllWriteBits, VK_ACCESS_TRANSFER_READ_BIT,
+                              image->layout_,
+                              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                              VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                              defragmented_images_.back(), range});
+      pre_barriers.push_back({VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr,
+                              0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                              VK_IMAGE_LAYOUT_UNDEFINED,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                              VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                              raw_image, range});
+      post_barriers.push_back(
+          {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr,
+           VK_ACCESS_TRANSFER_WRITE_BIT, kAllReadBits | kAllWriteBits,
+           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, image->layout_,
+           VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, raw_image, range});
+      copies.push_back({VK_NULL_HANDLE, VK_NULL_HANDLE,
+                        defragmented_images_.back(), raw_image, image,
+                        requirements.size});
+    }
+    stats->allocations_moved += 1;
+    stats->bytes_moved += requirements.size;
+  }
+
+  if (copies.empty()) {
+    return;
+  }
+
+  // Wait for all prior work before reading the old locations, and writing
+  // to the new ones.
+  VkMemoryBarrier memory_barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
+                                 kAllWriteBits,
+                                 VK_ACCESS_TRANSFER_READ_BIT |
+                                     VK_ACCESS_TRANSFER_WRITE_BIT};
+  (*command_buffer)
+      ->vkCmdPipelineBarrier(
+          *command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+          VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memory_barrier, 0, nullptr,
+          static_cast<uint32_t>(pre_barriers.size()),
+          pre_barriers.empty() ? nullptr : pre_barriers.data());
+
+  containers::vector<VkImageCopy> regions(allocator_);
+  for (const Copy& copy : copies) {
+    if (copy.image == nullptr) {
+      VkBufferCopy region{0, 0, copy.size};
+      (*command_buffer)
+          ->vkCmdCopyBuffer(*command_buffer, copy.src_buffer, copy.dst_buffer,
+                            1, &region);
+      continue;
+    }
+    const VkImageCreateInfo& info = copy.image->create_info_;
+    const VkImageAspectFlags aspects = AspectsForFormat(info.format);
+    regions.clear();
+    for (uint32_t level = 0; level < info.mipLevels; ++level) {
+      const VkImageSubresourceLayers layers{aspects, level, 0,
+                                            info.arrayLayers};
+      regions.push_back(
+          {layers,
+           {0, 0, 0},
+           layers,
+           {0, 0, 0},
+           {std::max(info.extent.width >> level, 1u),
+            std::max(info.extent.height >> level, 1u),
+            std::max(info.extent.depth >> level, 1u)}});
+    }
+    (*command_buffer)
+        ->vkCmdCopyImage(*command_buffer, copy.src_image,
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, copy.dst_image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(regions.size()),
+                         regions.data());
+  }
+
+  // Make the copies visible to all later work, and put the images back
+  // into the layout they were in.
+  memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  memory_barrier.dstAccessMask = kAllReadBits | kAllWriteBits;
+  (*command_buffer)
+      ->vkCmdPipelineBarrier(
+          *command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memory_barrier, 0,
+          nullptr, static_cast<uint32_t>(post_barriers.size()),
+          post_barriers.empty() ? nullptr : post_barriers.data());
+}
+
+void VulkanApplication::FinishDefragmentation(DefragmentationStats* stats) {
+  defragmented_buffers_.clear();
+  defragmented_images_.clear();
+  for (auto& heap_and_token : defragmented_tokens_) {
+    heap_and_token.first->FreeMemory(heap_and_token.second);
+  }
+  defragmented_tokens_.clear();
+
+  VulkanArena* heaps[2] = {device_only_buffer_heap_.get(), image_heap_};
+  const size_t num_heaps = heaps[0] == heaps[1] ? 1 : 2;
+  ::VkDeviceSize arena_size = 0;
+  stats->largest_free_range_after = 0;
+  for (size_t i = 0; i < num_heaps; ++i) {
+    arena_size += heaps[i]->total_size();
+    stats->largest_free_range_after = std::max(
+        stats->largest_free_range_after, heaps[i]->largest_free_range());
+  }
+  stats->bytes_released = defragmented_arena_size_ > arena_size
+                              ? defragmented_arena_size_ - arena_size
+                              : 0;
+}
+
 containers::unique_ptr<VkBufferView> VulkanApplication::CreateBufferView(
     ::VkBuffer buffer, VkFormat format, VkDeviceSize offset,
     VkDeviceSize range) {
@@ -902,7 +1562,7 @@ VulkanApplication::FillImageLayersData(
       0,
       nullptr,
   };
-  BufferPointer src_buffer = CreateAndBindHostBuffer(&buf_create_info);
+  BufferPointer src_buffer = CreateTransientHostBuffer(&buf_create_info);
   memcpy(src_buffer->base_address(), data.data(), data.size());
   src_buffer->flush();
 
@@ -1191,7 +1851,7 @@ bool VulkanApplication::DumpImageLayersData(
   return true;
 }
 
-// These linked-list nodes are ordered by offset into the heap.
+// These linked-list nodes are ordered by offset into their block.
 // the first node has a prev of nullptr, and the last node has a next of
 // nullptr.
 struct AllocationToken {
@@ -1200,257 +1860,887 @@ struct AllocationToken {
   ::VkDeviceSize allocationSize;
   ::VkDeviceSize offset;
   // Location into the map of unused chunks. This is only valid when
-  // in_use == false.
+  // in_use == false and the arena uses VulkanArenaStrategy::kOrderedMap.
   containers::ordered_multimap<::VkDeviceSize, AllocationToken*>::iterator
       map_location;
   bool in_use;
+  // The kind of resource using this memory. Only valid when in_use == true.
+  VulkanArenaResourceKind kind;
+  // The block of device memory that this token lives in.
+  ArenaBlock* block;
+  // Links in the TLSF free list that holds this token. These are only
+  // valid when in_use == false and the arena uses VulkanArenaStrategy::kTLSF.
+  AllocationToken* next_free;
+  AllocationToken* prev_free;
+  // The offset, size and alignment of the memory that was handed out for
+  // this token. offset and allocationSize also cover the padding that was
+  // needed in front of it. Only valid when in_use == true.
+  ::VkDeviceSize resource_offset;
+  ::VkDeviceSize resource_size;
+  ::VkDeviceSize alignment;
+  // If not nullptr, the object whose memory this is. It is handed back when
+  // the allocation is moved during defragmentation.
+  void* owner;
+  // If not nullptr, this token is a slot of the given run of a thread
+  // cache, and is not linked with the other tokens of its block.
+  ArenaCacheRun* run;
+};
+
+namespace {
+// Returns the index of the most significant set bit of value, which must
+// not be 0.
+uint32_t FindLastSet(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+  return 63 - __builtin_clzll(value);
+#else
+  uint32_t bit = 0;
+  while (value >>= 1) {
+    ++bit;
+  }
+  return bit;
+#endif
+}
+
+// Returns the index of the least significant set bit of value, which must
+// not be 0.
+uint32_t FindFirstSet(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(value);
+#else
+  uint32_t bit = 0;
+  while (!(value & 1)) {
+    value >>= 1;
+    ++bit;
+  }
+  return bit;
+#endif
+}
+
+// Returns the TLSF first and second level indices of the size class that
+// holds free tokens of the given size.
+void TLSFMapping(::VkDeviceSize size, uint32_t second_level_log2,
+                 uint32_t* first_level, uint32_t* second_level) {
+  if (size < (1ull << second_level_log2)) {
+    *first_level = 0;
+    *second_level = static_cast<uint32_t>(size);
+    return;
+  }
+  const uint32_t last_set = FindLastSet(size);
+  *second_level = static_cast<uint32_t>(
+      (size >> (last_set - second_level_log2)) ^ (1ull << second_level_log2));
+  *first_level = last_set - second_level_log2 + 1;
+}
+
+// Returns the cache shard of the calling thread. Threads are assigned
+// shards round-robin the first time they ask for one, so that up to
+// num_shards threads never have to share.
+uint32_t ThreadCacheShard(uint32_t num_shards) {
+  static std::atomic<uint32_t> next_shard(0);
+  thread_local uint32_t shard = next_shard.fetch_add(1);
+  return shard % num_shards;
+}
+
+// The number of bytes that a run of cache slots tries to cover. Runs of the
+// largest size classes have fewer slots.
+const ::VkDeviceSize kCacheRunSize = 256 * 1024;
+const uint32_t kMaxSlotsPerRun = 64;
+}  // anonymous namespace
+
+// An allocation from a VulkanArena that is split into equally sized slots
+// for the cached allocations of a single size class, resource kind, and
+// cache shard.
+struct ArenaCacheRun {
+  // The allocation that holds all of the slots.
+  AllocationToken* token;
+  // Links in the list of runs of the shard that holds this run.
+  ArenaCacheRun* next;
+  ArenaCacheRun* prev;
+  uint32_t shard;
+  uint32_t size_class;
+  VulkanArenaResourceKind kind;
+  uint32_t num_slots;
+  // Bit i is set if slot i is not in use.
+  uint64_t free_slots;
+  AllocationToken* slots[kMaxSlotsPerRun];
+};
+
+namespace {
+void LinkCacheRun(ArenaCacheRun** head, ArenaCacheRun* run) {
+  run->prev = nullptr;
+  run->next = *head;
+  if (*head) {
+    (*head)->prev = run;
+  }
+  *head = run;
+}
+
+void UnlinkCacheRun(ArenaCacheRun** head, ArenaCacheRun* run) {
+  if (run->next) {
+    run->next->prev = run->prev;
+  }
+  if (run->prev) {
+    run->prev->next = run->next;
+  } else {
+    *head = run->next;
+  }
+  run->next = nullptr;
+  run->prev = nullptr;
+}
+
+uint64_t AllCacheSlots(uint32_t num_slots) {
+  return num_slots == 64 ? ~0ull : (1ull << num_slots) - 1;
+}
+}  // anonymous namespace
+
+// A single ::VkDeviceMemory owned by a VulkanArena. The tokens that describe
+// this memory form a linked list starting at first_token.
+struct ArenaBlock {
+  ::VkDeviceMemory memory;
+  ::VkDeviceSize size;
+  char* base_address;
+  AllocationToken* first_token;
+  // If true, this block holds the memory of exactly one resource, and is
+  // never used for any other allocation.
+  bool dedicated;
 };
 
 VulkanArena::VulkanArena(containers::Allocator* allocator, logging::Logger* log,
                          ::VkDeviceSize buffer_size, uint32_t memory_type_index,
                          VkDevice* device, bool map, uint32_t device_mask,
-                         VkMemoryAllocateFlags allocate_flags)
+                         VkMemoryAllocateFlags allocate_flags,
+                         const VulkanArenaGrowthPolicy& growth_policy,
+                         VulkanArenaStrategy strategy, bool thread_caches)
     : allocator_(allocator),
-      freeblocks_(allocator_),
-      first_block_(nullptr),
-      base_address_(nullptr),
+      // Allocator::construct puts a 16 byte header in front of every token.
+      node_allocator_(allocator, sizeof(AllocationToken) + 16),
+      strategy_(strategy),
+      freeblocks_(&node_allocator_),
+      tlsf_first_level_bitmap_(0),
+      blocks_(allocator_),
+      total_size_(0),
+      peak_total_size_(0),
+      dedicated_size_(0),
+      used_size_(0),
+      peak_used_size_(0),
+      total_allocations_(0),
+      total_frees_(0),
+      next_block_size_(0),
+      growth_policy_(growth_policy),
+      buffer_image_granularity_(1),
+      resource_kinds_(0),
+      memory_type_index_(memory_type_index),
+      heap_index_(0),
+      heap_size_(0),
+      map_(map),
+      allocate_flags_info_{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
+                           nullptr, allocate_flags, 0},
+      use_allocate_flags_info_(false),
       device_(*device),
-      unmap_memory_function_(nullptr),
-      memory_(VK_NULL_HANDLE, nullptr, device),
-      log_(log) {
-  void* pNext = nullptr;
-  VkMemoryAllocateFlagsInfo flags = {
-      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO, nullptr, allocate_flags, 0};
+      allocate_memory_function_(&(*device)->vkAllocateMemory),
+      free_memory_function_(&(*device)->vkFreeMemory),
+      map_memory_function_(&(*device)->vkMapMemory),
+      unmap_memory_function_(&(*device)->vkUnmapMemory),
+      log_(log),
+      use_thread_caches_(thread_caches) {
+  memset(tlsf_second_level_bitmaps_, 0, sizeof(tlsf_second_level_bitmaps_));
+  memset(tlsf_free_lists_, 0, sizeof(tlsf_free_lists_));
+  for (auto& shard : cache_shards_) {
+    memset(shard.available_runs, 0, sizeof(shard.available_runs));
+    memset(shard.full_runs, 0, sizeof(shard.full_runs));
+  }
 
+  // We only keep references to the raw device and its function table
+  // from here on, since vulkan::VkDevice is movable.
   uint32_t nDevices = 0;
   if (device->num_devices() > 1) {
-    flags.flags |= VK_MEMORY_ALLOCATE_DEVICE_MASK_BIT;
-    pNext = &flags;
+    allocate_flags_info_.flags |= VK_MEMORY_ALLOCATE_DEVICE_MASK_BIT;
+    use_allocate_flags_info_ = true;
     if (device_mask == 0) {
       for (size_t i = 0; i < device->num_devices(); ++i) {
-        flags.deviceMask |= 1 << i;
+        allocate_flags_info_.deviceMask |= 1 << i;
         nDevices += 1;
       }
     } else {
       for (size_t i = 0; i < device->num_devices(); ++i) {
         if (device_mask & (1 << i)) {
-          flags.deviceMask |= 1 << i;
+          allocate_flags_info_.deviceMask |= 1 << i;
           nDevices += 1;
         }
       }
     }
   }
   if (allocate_flags != 0) {
-    pNext = &flags;
+    use_allocate_flags_info_ = true;
   }
 
   // It is illegal to have map memory that is bound to
   // more than one GPU
   LOG_ASSERT(==, log, true, (!map || nDevices <= 1));
 
-  // Actually allocate the bytes for this heap.
+  const auto& memory_properties = device->physical_device_memory_properties();
+  heap_index_ = memory_properties.memoryTypes[memory_type_index].heapIndex;
+  heap_size_ = memory_properties.memoryHeaps[heap_index_].size;
+
+  log->LogInfo("Trying to allocate ", buffer_size, " bytes from heap that has ",
+               heap_size_, " bytes.");
+
+  // Actually allocate the bytes for this heap. If we cannot even allocate
+  // 1/4 of the requested memory, it is time to fail.
+  ArenaBlock* block = AllocateBlock(buffer_size, buffer_size / 4);
+  LOG_ASSERT(!=, log, static_cast<ArenaBlock*>(nullptr), block);
+  next_block_size_ = block->size;
+  NotifyBudget();
+}
+
+VulkanArena::~VulkanArena() {
+  // Every cached allocation must have been freed as well, which leaves at
+  // most one empty run per size class in each shard.
+  for (auto& shard : cache_shards_) {
+    for (uint32_t kind = 0; kind < kNumResourceKinds; ++kind) {
+      for (uint32_t size_class = 0; size_class < kNumCacheSizeClasses;
+           ++size_class) {
+        LOG_ASSERT(==, log_, true,
+                   shard.full_runs[kind][size_class] == nullptr);
+        while (ArenaCacheRun* run = shard.available_runs[kind][size_class]) {
+          LOG_ASSERT(==, log_, AllCacheSlots(run->num_slots),
+                     run->free_slots);
+          UnlinkCacheRun(&shard.available_runs[kind][size_class], run);
+          ReleaseCacheRun(run);
+        }
+      }
+    }
+  }
+  // Make sure that there is only one token left in each block, and that it
+  // is not in use. This will trigger if someone has not freed all the memory
+  // before the heap has been destroyed.
+  while (!blocks_.empty()) {
+    ArenaBlock* block = blocks_.back();
+    LOG_ASSERT(==, log_, true, block->first_token->next == nullptr);
+    LOG_ASSERT(==, log_, false, block->first_token->in_use);
+    ReleaseBlock(block);
+  }
+  NotifyBudget();
+}
+
+ArenaBlock* VulkanArena::AllocateBlock(
+    ::VkDeviceSize size, ::VkDeviceSize min_size,
+    VkMemoryDedicatedAllocateInfo* dedicated_info) {
   VkMemoryAllocateInfo allocate_info{
       VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,  // sType
-      pNext,                                   // pNext
-      buffer_size,                             // allocationSize
-      memory_type_index};
+      use_allocate_flags_info_ ? &allocate_flags_info_ : nullptr,  // pNext
+      size,  // allocationSize
+      memory_type_index_};
+  if (dedicated_info) {
+    dedicated_info->pNext = allocate_info.pNext;
+    allocate_info.pNext = dedicated_info;
+  }
+  VulkanMemoryBudget* budget = growth_policy_.budget;
+  if (budget) {
+    // Stay within the budget if we can, but never go below min_size. The
+    // budget is a hint, and the allocation may still succeed beyond it.
+    budget->Update();
+    const ::VkDeviceSize available = budget->available(heap_index_);
+    if (size > available) {
+      size = std::max(available, min_size);
+      log_->LogInfo("Limiting allocation to ", size,
+                    " bytes to stay within the memory budget of heap ",
+                    heap_index_);
+      allocate_info.allocationSize = size;
+    }
+  }
 
   VkResult res = VK_SUCCESS;
   ::VkDeviceMemory device_memory;
-  VkDeviceSize original_size = buffer_size;
-
-  const auto& memory_properties = device->physical_device_memory_properties();
-
-  log->LogInfo("Trying to allocate ", buffer_size, " bytes from heap that has ",
-               memory_properties
-                   .memoryHeaps[memory_properties.memoryTypes[memory_type_index]
-                                    .heapIndex]
-                   .size,
-               " bytes.");
-
   do {
     if (res == VK_ERROR_OUT_OF_DEVICE_MEMORY ||
         res == VK_ERROR_OUT_OF_HOST_MEMORY) {
-      log->LogInfo("Could not allocate ", buffer_size,
-                   " bytes of "
-                   "device memory. Attempting to allocate ",
-                   static_cast<size_t>(buffer_size * 0.75), " bytes instead");
-      buffer_size =
-          static_cast<VkDeviceSize>(static_cast<float>(buffer_size) * 0.75f);
-      allocate_info.allocationSize = buffer_size;
+      ::VkDeviceSize smaller_size =
+          static_cast<VkDeviceSize>(static_cast<float>(size) * 0.75f);
+      size = smaller_size < min_size ? min_size : smaller_size;
+      log_->LogInfo("Could not allocate ", allocate_info.allocationSize,
+                    " bytes of "
+                    "device memory. Attempting to allocate ",
+                    size, " bytes instead");
+      allocate_info.allocationSize = size;
     }
 
-    res = (*device)->vkAllocateMemory(*device, &allocate_info, nullptr,
-                                      &device_memory);
-    // If we cannot even allocate 1/4 of the requested memory, it is time to
-    // fail.
+    res = (*allocate_memory_function_)(device_, &allocate_info, nullptr,
+                                       &device_memory);
   } while ((res == VK_ERROR_OUT_OF_DEVICE_MEMORY ||
             res == VK_ERROR_OUT_OF_HOST_MEMORY) &&
-           buffer_size > original_size / 4);
-  LOG_ASSERT(==, log, VK_SUCCESS, res);
-  memory_.initialize(device_memory);
-
-  // Create a new pointer that is the first block of memory. It contains
-  // all of the memory in the arena.
-  first_block_ = allocator_->construct<AllocationToken>(AllocationToken{
-      nullptr, nullptr, buffer_size, 0, freeblocks_.end(), false});
-
-  // Since this has not been used yet, add it to our freeblock_ map.
-  first_block_->map_location =
-      freeblocks_.insert(std::make_pair(buffer_size, first_block_));
+           size > min_size);
+  if (res == VK_ERROR_OUT_OF_DEVICE_MEMORY ||
+      res == VK_ERROR_OUT_OF_HOST_MEMORY) {
+    return nullptr;
+  }
+  LOG_ASSERT(==, log_, VK_SUCCESS, res);
 
-  if (map) {
+  char* base_address = nullptr;
+  if (map_) {
     // If we were asked to map this memory. (i.e. it is meant to be host
     // visible), then do it now.
-    LOG_ASSERT(
-        ==, log, VK_SUCCESS,
-        (*device)->vkMapMemory(*device, memory_, 0, buffer_size, 0,
-                               reinterpret_cast<void**>(&base_address_)));
-    // Store off the devices unmap memory function for the future, we only
-    // want to keep a reference to the raw device, and not the
-    // vulkan::VkDevice since vulkan::VkDevice is movable.
-    unmap_memory_function_ = &(*device)->vkUnmapMemory;
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               (*map_memory_function_)(
+                   device_, device_memory, 0, size, 0,
+                   reinterpret_cast<void**>(&base_address)));
+  }
+
+  if (budget) {
+    budget->ReportAllocation(heap_index_, size);
+  }
+
+  ArenaBlock* block = allocator_->construct<ArenaBlock>(ArenaBlock{
+      device_memory, size, base_address, nullptr, dedicated_info != nullptr});
+
+  // Create a new token that contains all of the memory in the block.
+  block->first_token = node_allocator_.construct<AllocationToken>(
+      AllocationToken{nullptr, nullptr, size, 0, freeblocks_.end(), false,
+                      VulkanArenaResourceKind::kUnknown, block, nullptr,
+                      nullptr, 0, 0, 0, nullptr, nullptr});
+
+  // Since this has not been used yet, make it available for allocations.
+  // Dedicated blocks are handed out as a whole by AllocateDedicatedMemory.
+  if (dedicated_info) {
+    dedicated_size_ += size;
+  } else {
+    InsertFreeToken(block->first_token);
   }
+
+  blocks_.push_back(block);
+  total_size_ += size;
+  peak_total_size_ = std::max(peak_total_size_, total_size_);
+  return block;
 }
 
-VulkanArena::~VulkanArena() {
-  // Make sure that there is only one block left, and that is is not in use.
-  // This will trigger if someone has not freed all the memory before the
-  // heap has been destroyed.
-  LOG_ASSERT(==, log_, true, first_block_->next == nullptr);
-  LOG_ASSERT(==, log_, false, first_block_->in_use);
-  if (base_address_) {
-    (*unmap_memory_function_)(device_, memory_);
+void VulkanArena::NotifyBudget() {
+  if (growth_policy_.budget) {
+    growth_policy_.budget->NotifyHighWaterMarks();
   }
-  allocator_->destroy(first_block_);
 }
 
-AllocationToken* VulkanArena::AllocateMemory(::VkDeviceSize size,
-                                             ::VkDeviceSize alignment,
-                                             ::VkDeviceMemory* memory,
-                                             ::VkDeviceSize* offset,
-                                             char** base_address) {
+void VulkanArena::ReleaseBlock(ArenaBlock* block) {
+  AllocationToken* token = block->first_token;
+  if (block->dedicated) {
+    dedicated_size_ -= block->size;
+  } else {
+    RemoveFreeToken(token);
+  }
+  node_allocator_.destroy(token);
+
+  if (block->base_address) {
+    (*unmap_memory_function_)(device_, block->memory);
+  }
+  (*free_memory_function_)(device_, block->memory, nullptr);
+  if (growth_policy_.budget) {
+    growth_policy_.budget->ReportFree(heap_index_, block->size);
+  }
+
+  blocks_.erase(std::find(blocks_.begin(), blocks_.end(), block));
+  total_size_ -= block->size;
+  allocator_->destroy(block);
+}
+
+void VulkanArena::ReleaseEmptyBlock(ArenaBlock* block) {
+  if (!growth_policy_.keep_spare_block) {
+    ReleaseBlock(block);
+    return;
+  }
+  // Keep the largest empty block as the spare, there is at most one other.
+  for (size_t i = 1; i < blocks_.size(); ++i) {
+    ArenaBlock* spare = blocks_[i];
+    if (spare == block || spare->dedicated || spare->first_token->next ||
+        spare->first_token->in_use) {
+      continue;
+    }
+    ReleaseBlock(spare->size < block->size ? spare : block);
+    return;
+  }
+}
+
+::VkDeviceSize VulkanArena::PrepareAllocation(::VkDeviceSize* size,
+                                             ::VkDeviceSize* alignment,
+                                             VulkanArenaResourceKind kind,
+                                             bool* check_granularity) {
   // If we are mapped memory, then no matter what alignment says, we
   // must also be aligned to kMaxNonCoherentAtomSize AND
   // for all intents and purposes our size must be a multiple of
   // kMaxNonCoherentAtomSize
-  if (base_address_) {
-    alignment = alignment > kMaxNonCoherentAtomSize ? alignment
-                                                    : kMaxNonCoherentAtomSize;
-    if ((size % kMaxNonCoherentAtomSize) != 0) {
-      size += (kMaxNonCoherentAtomSize - (size % kMaxNonCoherentAtomSize));
+  if (map_) {
+    *alignment = *alignment > kMaxNonCoherentAtomSize ? *alignment
+                                                      : kMaxNonCoherentAtomSize;
+    if ((*size % kMaxNonCoherentAtomSize) != 0) {
+      *size += (kMaxNonCoherentAtomSize - (*size % kMaxNonCoherentAtomSize));
     }
   }
 
-  // We use alignment - 1 quite a bit, so store it off here.
-  const ::VkDeviceSize align_m_1 = alignment - 1;
-  LOG_ASSERT(>, log_, alignment, 0);  // Alignment must be > 0
-  LOG_ASSERT(==, log_, !(alignment & (align_m_1)),
+  LOG_ASSERT(>, log_, *alignment, 0);  // Alignment must be > 0
+  LOG_ASSERT(==, log_, !(*alignment & (*alignment - 1)),
              true);  // Alignment must be power of 2.
 
   // This is the maximum amount of memory we will potentially have to
   // allocate in order to satisfy the alignment.
-  ::VkDeviceSize to_allocate = size + align_m_1;
+  ::VkDeviceSize to_allocate = *size + *alignment - 1;
+
+  // If resources of another kind live in this arena, we may have to move
+  // away from the previous neighbour onto a new page, and keep clear of the
+  // page of the next neighbour. Reserving an extra granularity - 1 bytes
+  // for each of them is always enough.
+  const uint32_t kind_bit = 1u << static_cast<uint32_t>(kind);
+  *check_granularity =
+      buffer_image_granularity_ > 1 && (resource_kinds_ & ~kind_bit) != 0;
+  if (*check_granularity) {
+    to_allocate += 2 * (buffer_image_granularity_ - 1);
+  }
+  resource_kinds_ |= kind_bit;
+  return to_allocate;
+}
+
+AllocationToken* VulkanArena::AllocateMemory(::VkDeviceSize size,
+                                             ::VkDeviceSize alignment,
+                                             ::VkDeviceMemory* memory,
+                                             ::VkDeviceSize* offset,
+                                             char** base_address,
+                                             VulkanArenaResourceKind kind) {
+  AllocationToken* new_token;
+  uint32_t size_class;
+  if (GetCacheSizeClass(size, alignment, &size_class)) {
+    new_token = AllocateCachedMemory(size, size_class, kind);
+  } else {
+    std::lock_guard<std::mutex> lock(mutex_);
+    new_token = AllocateCentralMemory(size, alignment, kind);
+  }
+  NotifyBudget();
+  total_allocations_.fetch_add(1, std::memory_order_relaxed);
+  // The block cannot go away while new_token is in use, so it is safe to
+  // look at without the lock.
+  ArenaBlock* block = new_token->block;
+  *memory = block->memory;
+  *offset = new_token->resource_offset;
+  if (base_address) {
+    *base_address = block->base_address
+                        ? block->base_address + new_token->resource_offset
+                        : nullptr;
+  }
+  return new_token;
+}
+
+AllocationToken* VulkanArena::AllocateCentralMemory(
+    ::VkDeviceSize size, ::VkDeviceSize alignment,
+    VulkanArenaResourceKind kind) {
+  bool check_granularity;
+  const ::VkDeviceSize to_allocate =
+      PrepareAllocation(&size, &alignment, kind, &check_granularity);
 
   // Find a block that contains at LEAST enough memory for our allocation.
-  auto it = freeblocks_.lower_bound(to_allocate);
-  // Fail if there is not even a single free-block that can hold our
-  // allocation.
-  LOG_ASSERT(==, log_, true, freeblocks_.end() != it);
+  AllocationToken* token = FindFreeToken(to_allocate);
+  if (!token) {
+    // None of our blocks can hold this allocation, so grow the arena.
+    ::VkDeviceSize block_size = std::max(next_block_size_, to_allocate);
+    if (growth_policy_.max_block_size != 0 &&
+        block_size > growth_policy_.max_block_size) {
+      block_size = std::max(growth_policy_.max_block_size, to_allocate);
+    }
+    if (growth_policy_.max_total_size != 0) {
+      ::VkDeviceSize remaining =
+          growth_policy_.max_total_size > total_size_
+              ? growth_policy_.max_total_size - total_size_
+              : 0;
+      block_size = std::min(block_size, remaining);
+    }
+    ArenaBlock* block = nullptr;
+    if (block_size >= to_allocate) {
+      log_->LogInfo("Growing arena by ", block_size,
+                    " bytes from heap that has ", heap_size_, " bytes.");
+      block = AllocateBlock(block_size, to_allocate);
+    }
+    if (!block) {
+      log_->LogError("Could not grow arena of ", total_size_,
+                     " bytes to hold an allocation of ", size, " bytes");
+    }
+    // Fail if we could not get a block that can hold our allocation.
+    LOG_ASSERT(!=, log_, static_cast<ArenaBlock*>(nullptr), block);
+    next_block_size_ = static_cast<::VkDeviceSize>(
+        static_cast<float>(block->size) * growth_policy_.growth_factor);
+    token = block->first_token;
+  }
+
+  return AllocateFromToken(token, size, alignment, kind, check_granularity);
+}
+
+bool VulkanArena::GetCacheSizeClass(::VkDeviceSize size,
+                                    ::VkDeviceSize alignment,
+                                    uint32_t* size_class) const {
+  if (!use_thread_caches_) {
+    return false;
+  }
+  // Slots are aligned to their size, so the alignment is covered by
+  // rounding up to it.
+  const ::VkDeviceSize needed = std::max(size, alignment);
+  if (needed > (1ull << kMaxCachedSizeLog2)) {
+    return false;
+  }
+  const uint32_t log2 = needed <= (1ull << kMinCachedSizeLog2)
+                            ? kMinCachedSizeLog2
+                            : FindLastSet(needed - 1) + 1;
+  *size_class = log2 - kMinCachedSizeLog2;
+  return true;
+}
+
+AllocationToken* VulkanArena::AllocateCachedMemory(
+    ::VkDeviceSize size, uint32_t size_class, VulkanArenaResourceKind kind) {
+  const uint32_t kind_index = static_cast<uint32_t>(kind);
+  const uint32_t shard_index = ThreadCacheShard(kNumCacheShards);
+  CacheShard& shard = cache_shards_[shard_index];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  ArenaCacheRun** available = &shard.available_runs[kind_index][size_class];
+  if (!*available) {
+    LinkCacheRun(available, AllocateCacheRun(shard_index, size_class, kind));
+  }
+  ArenaCacheRun* run = *available;
+  const uint32_t slot = FindFirstSet(run->free_slots);
+  run->free_slots &= ~(1ull << slot);
+  if (!run->free_slots) {
+    UnlinkCacheRun(available, run);
+    LinkCacheRun(&shard.full_runs[kind_index][size_class], run);
+  }
+
+  AllocationToken* token = run->slots[slot];
+  token->resource_size = size;
+  return token;
+}
+
+void VulkanArena::FreeCachedMemory(AllocationToken* token) {
+  ArenaCacheRun* run = token->run;
+  const uint32_t kind_index = static_cast<uint32_t>(run->kind);
+  CacheShard& shard = cache_shards_[run->shard];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  ArenaCacheRun** available =
+      &shard.available_runs[kind_index][run->size_class];
+  const uint32_t slot = static_cast<uint32_t>(
+      (token->resource_offset - run->token->resource_offset) >>
+      (run->size_class + kMinCachedSizeLog2));
+  if (!run->free_slots) {
+    UnlinkCacheRun(&shard.full_runs[kind_index][run->size_class], run);
+    LinkCacheRun(available, run);
+  }
+  run->free_slots |= 1ull << slot;
+
+  // Keep one run with free slots around, so that allocating and freeing a
+  // single slot over and over does not go to the arena every time.
+  if (run->free_slots == AllCacheSlots(run->num_slots) &&
+      (run->prev || run->next)) {
+    UnlinkCacheRun(available, run);
+    ReleaseCacheRun(run);
+  }
+}
+
+ArenaCacheRun* VulkanArena::AllocateCacheRun(uint32_t shard,
+                                             uint32_t size_class,
+                                             VulkanArenaResourceKind kind) {
+  const ::VkDeviceSize slot_size = 1ull << (size_class + kMinCachedSizeLog2);
+  const uint32_t num_slots = static_cast<uint32_t>(
+      std::min<::VkDeviceSize>(std::max<::VkDeviceSize>(
+                                   kCacheRunSize / slot_size, 1),
+                               kMaxSlotsPerRun));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  ArenaCacheRun* run = allocator_->construct<ArenaCacheRun>(ArenaCacheRun{});
+  run->token = AllocateCentralMemory(slot_size * num_slots, slot_size, kind);
+  run->shard = shard;
+  run->size_class = size_class;
+  run->kind = kind;
+  run->num_slots = num_slots;
+  run->free_slots = AllCacheSlots(num_slots);
+  for (uint32_t i = 0; i < num_slots; ++i) {
+    const ::VkDeviceSize offset = run->token->resource_offset + i * slot_size;
+    run->slots[i] = node_allocator_.construct<AllocationToken>(
+        AllocationToken{nullptr, nullptr, slot_size, offset,
+                        freeblocks_.end(), true, kind, run->token->block,
+                        nullptr, nullptr, offset, slot_size, slot_size,
+                        nullptr, run});
+  }
+  return run;
+}
+
+void VulkanArena::ReleaseCacheRun(ArenaCacheRun* run) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (uint32_t i = 0; i < run->num_slots; ++i) {
+    node_allocator_.destroy(run->slots[i]);
+  }
+  FreeCentralMemory(run->token);
+  allocator_->destroy(run);
+}
+
+AllocationToken* VulkanArena::AllocateDedicatedMemory(
+    ::VkDeviceSize size, ::VkImage image, ::VkBuffer buffer,
+    ::VkDeviceMemory* memory, ::VkDeviceSize* offset, char** base_address,
+    VulkanArenaResourceKind kind) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  VkMemoryDedicatedAllocateInfo dedicated_info{
+      VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,  // sType
+      nullptr,                                           // pNext
+      image,                                             // image
+      buffer                                             // buffer
+  };
+  ArenaBlock* block = AllocateBlock(size, size, &dedicated_info);
+  if (!block) {
+    log_->LogError("Could not allocate ", size,
+                   " bytes of dedicated device memory");
+  }
+  LOG_ASSERT(!=, log_, static_cast<ArenaBlock*>(nullptr), block);
+
+  AllocationToken* token = block->first_token;
+  token->in_use = true;
+  used_size_ += size;
+  peak_used_size_ = std::max(peak_used_size_, used_size_);
+  total_allocations_.fetch_add(1, std::memory_order_relaxed);
+  token->kind = kind;
+  token->resource_offset = 0;
+  token->resource_size = size;
+  token->alignment = 1;
+  *memory = block->memory;
+  *offset = 0;
+  if (base_address) {
+    *base_address = block->base_address;
+  }
+  lock.unlock();
+  NotifyBudget();
+  return token;
+}
+
+AllocationToken* VulkanArena::AllocateFromToken(AllocationToken* token,
+                                                ::VkDeviceSize size,
+                                                ::VkDeviceSize alignment,
+                                                VulkanArenaResourceKind kind,
+                                                bool check_granularity) {
+  // We use alignment - 1 quite a bit, so store it off here.
+  const ::VkDeviceSize align_m_1 = alignment - 1;
+  const ::VkDeviceSize granularity_m_1 = buffer_image_granularity_ - 1;
 
-  AllocationToken* token = it->second;
-  // Remove the block that we found from the freeblock map.
-  freeblocks_.erase(it);
+  ArenaBlock* block = token->block;
+  // Remove the block that we found from the free tokens.
+  RemoveFreeToken(token);
 
-  // total_offset is the offset from the base of the entire arena to the
-  // correctly aligned base inside of the given block.
+  // total_offset is the offset from the base of the block to the
+  // correctly aligned base inside of the given token.
   ::VkDeviceSize total_offset = (token->offset + (align_m_1)) & ~(align_m_1);
-  // offset_from_start is the offset from the start of the block to
-  // the alignment location.
-  ::VkDeviceSize offset_from_start = total_offset - token->offset;
+  // A free token is always preceded by a token in use, if the two are of
+  // different kinds and would share a page, start on the next page.
+  // The next neighbour is at least granularity - 1 bytes past the end of
+  // the allocation, because of the extra memory we asked for.
+  if (check_granularity && token->prev && token->prev->kind != kind &&
+      ((token->offset - 1) & ~granularity_m_1) ==
+          (total_offset & ~granularity_m_1)) {
+    total_offset = (total_offset + granularity_m_1) & ~granularity_m_1;
+  }
 
   // Our block may satisfy the alignment already, so only actually allocate
-  // the amount of memory we need.
+  // the amount of memory we need, including any padding at the front.
   // TODO(awoloszyn): If we find fragmentation to be a problem here, then
   //   eventually actually allocate the total. If we do not do this,
   //   then if we have (for example) a 128byte aligned block and we need
   //   4K of memory, we wont be able to re-use this block for another 4K
   //   allocation.
-  ::VkDeviceSize total_allocated =
-      to_allocate - (align_m_1 - offset_from_start);
+  ::VkDeviceSize total_allocated = (total_offset - token->offset) + size;
+
+  // Create a new token that contains the memory in question. It starts
+  // where the free token used to start, so that the alignment padding is
+  // returned along with it.
+  AllocationToken* new_token =
+      node_allocator_.construct<AllocationToken>(AllocationToken{
+          token, token->prev, total_allocated, token->offset,
+          freeblocks_.end(), true, kind, block, nullptr, nullptr, total_offset,
+          size, alignment, nullptr, nullptr});
+  if (token->prev) {
+    token->prev->next = new_token;
+  } else {
+    block->first_token = new_token;
+  }
+  token->prev = new_token;
+
+  used_size_ += total_allocated;
+  peak_used_size_ = std::max(peak_used_size_, used_size_);
 
-  // Remove the memory from the block.
-  // Push the block's base up by the allocated memory
+  // Remove the memory from the free token.
+  // Push the token's base up by the allocated memory
   token->allocationSize -= total_allocated;
   token->offset += total_allocated;
 
-  // Create a new block that contains the memory in question.
-  AllocationToken* new_token = allocator_->construct<AllocationToken>(
-      AllocationToken{nullptr, token->prev, total_allocated, total_offset,
-                      freeblocks_.end(), true});
-
   if (token->allocationSize > 0) {
     // If there is still some space in this allocation, put it back, so we can
     // get more out of it later.
-    token->map_location =
-        freeblocks_.insert(std::make_pair(token->allocationSize, token));
-
-    // Hook up all of our linked-list nodes.
-    new_token->next = token;
-    if (!token->prev) {
-      first_block_ = new_token;
-    } else {
-      new_token->prev = token->prev;
-      new_token->prev->next = new_token;
-    }
-    token->prev = new_token;
-    new_token->next = token;
-    if (first_block_ == token) {
-      first_block_ = new_token;
-    }
+    InsertFreeToken(token);
   } else {
     // token happens to now be an empty block. So let's not put it back.
+    new_token->next = token->next;
     if (token->next) {
-      new_token->next = token->next;
       token->next->prev = new_token;
     }
-    if (token->prev) {
-      token->prev->next = new_token;
-    } else {
-      first_block_ = new_token;
+    node_allocator_.destroy(token);
+  }
+  return new_token;
+}
+
+void VulkanArena::SetOwner(AllocationToken* token, void* owner) {
+  if (token->run) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  token->owner = owner;
+}
+
+void VulkanArena::PlanDefragmentation(::VkDeviceSize max_bytes,
+                                      containers::vector<Move>* moves) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Gather the allocations that may be moved, from the back of the arena to
+  // the front. Tokens that are in use are never destroyed while planning,
+  // so this list stays valid as we go.
+  containers::vector<AllocationToken*> movable(allocator_);
+  for (size_t i = blocks_.size(); i > 0; --i) {
+    // Dedicated memory belongs to its resource, so it is never moved.
+    if (blocks_[i - 1]->dedicated) {
+      continue;
+    }
+    AllocationToken* token = blocks_[i - 1]->first_token;
+    while (token->next) {
+      token = token->next;
+    }
+    for (; token; token = token->prev) {
+      if (token->in_use && token->owner) {
+        movable.push_back(token);
+      }
     }
+  }
 
-    allocator_->destroy(token);
+  ::VkDeviceSize moved_bytes = 0;
+  for (AllocationToken* token : movable) {
+    if (moved_bytes >= max_bytes) {
+      break;
+    }
+    ::VkDeviceSize size = token->resource_size;
+    ::VkDeviceSize alignment = token->alignment;
+    bool check_granularity;
+    const ::VkDeviceSize to_allocate =
+        PrepareAllocation(&size, &alignment, token->kind, &check_granularity);
+
+    // Find the first free range that fits, in block order, before this
+    // token.
+    AllocationToken* destination = nullptr;
+    for (ArenaBlock* block : blocks_) {
+      for (AllocationToken* candidate = block->first_token;
+           candidate && candidate != token && !destination;
+           candidate = candidate->next) {
+        if (!candidate->in_use && candidate->allocationSize >= to_allocate) {
+          destination = candidate;
+        }
+      }
+      if (destination || block == token->block) {
+        break;
+      }
+    }
+    if (!destination) {
+      continue;
+    }
+    AllocationToken* new_token = AllocateFromToken(
+        destination, size, alignment, token->kind, check_granularity);
+    new_token->owner = token->owner;
+    token->owner = nullptr;
+    // The old token is freed once the move is done, so the move counts as
+    // an allocation of its own.
+    total_allocations_.fetch_add(1, std::memory_order_relaxed);
+    moves->push_back(Move{token, new_token, new_token->owner, new_token->kind,
+                          new_token->block->memory,
+                          new_token->resource_offset});
+    moved_bytes += size;
   }
-  *memory = memory_;
-  *offset = total_offset;
-  if (base_address) {
-    *base_address = base_address_ ? base_address_ + total_offset : nullptr;
+}
+
+::VkDeviceSize VulkanArena::largest_free_range() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ::VkDeviceSize largest = 0;
+  for (ArenaBlock* block : blocks_) {
+    for (AllocationToken* token = block->first_token; token;
+         token = token->next) {
+      if (!token->in_use && token->allocationSize > largest) {
+        largest = token->allocationSize;
+      }
+    }
   }
-  return new_token;
+  return largest;
+}
+
+void VulkanArena::GetStats(VulkanArenaStats* stats) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  *stats = VulkanArenaStats();
+  stats->memory_type_index = memory_type_index_;
+  stats->heap_index = heap_index_;
+  stats->total_size = total_size_;
+  stats->peak_total_size = peak_total_size_;
+  stats->dedicated_size = dedicated_size_;
+  stats->num_blocks = blocks_.size();
+  stats->used_size = used_size_;
+  stats->peak_used_size = peak_used_size_;
+  for (ArenaBlock* block : blocks_) {
+    for (AllocationToken* token = block->first_token; token;
+         token = token->next) {
+      if (token->in_use) {
+        continue;
+      }
+      stats->num_free_ranges += 1;
+      stats->free_size += token->allocationSize;
+      stats->largest_free_range =
+          std::max(stats->largest_free_range, token->allocationSize);
+    }
+  }
+  if (stats->free_size != 0) {
+    stats->fragmentation =
+        1.0f - static_cast<float>(stats->largest_free_range) /
+                   static_cast<float>(stats->free_size);
+  }
+  stats->total_allocations =
+      total_allocations_.load(std::memory_order_relaxed);
+  stats->total_frees = total_frees_.load(std::memory_order_relaxed);
+  stats->num_allocations = stats->total_allocations - stats->total_frees;
 }
 
 void VulkanArena::FreeMemory(AllocationToken* token) {
-  bool atAll = false;
+  total_frees_.fetch_add(1, std::memory_order_relaxed);
+  if (token->run) {
+    FreeCachedMemory(token);
+  } else {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FreeCentralMemory(token);
+  }
+  NotifyBudget();
+}
+
+void VulkanArena::FreeCentralMemory(AllocationToken* token) {
+  used_size_ -= token->allocationSize;
+  // Dedicated memory is never shared, so give it straight back.
+  if (token->block->dedicated) {
+    token->in_use = false;
+    ReleaseBlock(token->block);
+    return;
+  }
   // First try to coalesce this with its previous block.
   while (token->prev && !token->prev->in_use) {
-    atAll = true;
     // Take the previous token out of the map, and merge it with this one.
     AllocationToken* prev_token = token->prev;
+    // Remove the previous block from the free tokens before it grows, the
+    // free lists find it by its size.
+    RemoveFreeToken(prev_token);
     prev_token->allocationSize += token->allocationSize;
     prev_token->next = token->next;
     if (token->next) {
       token->next->prev = prev_token;
     }
-    // Remove the previous block from freeblocks_,
-    // we have now merged with it.
-    freeblocks_.erase(prev_token->map_location);
-    allocator_->destroy(token);
+    node_allocator_.destroy(token);
     token = prev_token;
   }
   // Now try to coalesce this with any subsequent blocks.
   while (token->next && !token->next->in_use) {
-    atAll = true;
     // Take the previous token out of the map, and merge it with this one.
     AllocationToken* next_token = token->next;
     token->allocationSize += next_token->allocationSize;
@@ -1458,16 +2748,214 @@ void VulkanArena::FreeMemory(AllocationToken* token) {
     if (token->next) {
       token->next->prev = token;
     }
-    // Remove the next block from freeblocks_,
+    // Remove the next block from the free tokens,
     // we have now merged with it.
-    freeblocks_.erase(next_token->map_location);
-    allocator_->destroy(next_token);
+    RemoveFreeToken(next_token);
+    node_allocator_.destroy(next_token);
   }
   // This block is no longer being used.
   token->in_use = false;
-  // Push it back into freeblocks_.
-  token->map_location =
-      freeblocks_.insert(std::make_pair(token->allocationSize, token));
+  token->owner = nullptr;
+  // Push it back into the free tokens.
+  InsertFreeToken(token);
+
+  // If this token now covers an entire block that we grew into, give
+  // the memory back to the device.
+  if (growth_policy_.release_empty_blocks && !token->prev && !token->next &&
+      token->block != blocks_.front()) {
+    ReleaseEmptyBlock(token->block);
+  }
+}
+
+void VulkanArena::InsertFreeToken(AllocationToken* token) {
+  if (strategy_ == VulkanArenaStrategy::kOrderedMap) {
+    token->map_location =
+        freeblocks_.insert(std::make_pair(token->allocationSize, token));
+    return;
+  }
+  uint32_t first_level, second_level;
+  TLSFMapping(token->allocationSize, kTLSFSecondLevelLog2, &first_level,
+              &second_level);
+  AllocationToken*& head = tlsf_free_lists_[first_level][second_level];
+  token->prev_free = nullptr;
+  token->next_free = head;
+  if (head) {
+    head->prev_free = token;
+  }
+  head = token;
+  tlsf_first_level_bitmap_ |= 1ull << first_level;
+  tlsf_second_level_bitmaps_[first_level] |= 1u << second_level;
+}
+
+void VulkanArena::RemoveFreeToken(AllocationToken* token) {
+  if (strategy_ == VulkanArenaStrategy::kOrderedMap) {
+    freeblocks_.erase(token->map_location);
+    return;
+  }
+  uint32_t first_level, second_level;
+  TLSFMapping(token->allocationSize, kTLSFSecondLevelLog2, &first_level,
+              &second_level);
+  if (token->next_free) {
+    token->next_free->prev_free = token->prev_free;
+  }
+  if (token->prev_free) {
+    token->prev_free->next_free = token->next_free;
+  } else {
+    AllocationToken*& head = tlsf_free_lists_[first_level][second_level];
+    head = token->next_free;
+    if (!head) {
+      tlsf_second_level_bitmaps_[first_level] &= ~(1u << second_level);
+      if (!tlsf_second_level_bitmaps_[first_level]) {
+        tlsf_first_level_bitmap_ &= ~(1ull << first_level);
+      }
+    }
+  }
+  token->next_free = nullptr;
+  token->prev_free = nullptr;
+}
+
+AllocationToken* VulkanArena::FindFreeToken(::VkDeviceSize size) {
+  if (strategy_ == VulkanArenaStrategy::kOrderedMap) {
+    auto it = freeblocks_.lower_bound(size);
+    return it == freeblocks_.end() ? nullptr : it->second;
+  }
+  // Round the size up to the next size class, so that every token in the
+  // class we find is large enough.
+  if (size >= kTLSFSecondLevelCount) {
+    size += (1ull << (FindLastSet(size) - kTLSFSecondLevelLog2)) - 1;
+  }
+  uint32_t first_level, second_level;
+  TLSFMapping(size, kTLSFSecondLevelLog2, &first_level, &second_level);
+
+  // Look for a non-empty list in this power-of-two class first, then fall
+  // back to the smallest larger class.
+  uint32_t second_level_map =
+      tlsf_second_level_bitmaps_[first_level] & (~0u << second_level);
+  if (!second_level_map) {
+    if (first_level + 1 >= kTLSFFirstLevelCount) {
+      return nullptr;
+    }
+    const uint64_t first_level_map =
+        tlsf_first_level_bitmap_ & (~0ull << (first_level + 1));
+    if (!first_level_map) {
+      return nullptr;
+    }
+    first_level = FindFirstSet(first_level_map);
+    second_level_map = tlsf_second_level_bitmaps_[first_level];
+  }
+  second_level = FindFirstSet(second_level_map);
+  return tlsf_free_lists_[first_level][second_level];
+}
+
+VulkanLinearArena::VulkanLinearArena(containers::Allocator* allocator,
+                                     logging::Logger* log,
+                                     ::VkDeviceSize buffer_size,
+                                     uint32_t memory_type_index,
+                                     VkDevice* device)
+    : frames_(allocator),
+      first_frame_(0),
+      num_frames_(0),
+      size_(buffer_size),
+      head_(0),
+      tail_(0),
+      memory_type_index_(memory_type_index),
+      base_address_(nullptr),
+      device_(*device),
+      unmap_memory_function_(&(*device)->vkUnmapMemory),
+      memory_(VK_NULL_HANDLE, nullptr, device),
+      log_(log) {
+  // Every allocation is rounded to kMaxNonCoherentAtomSize, so make sure
+  // the ring is as well.
+  if ((size_ % kMaxNonCoherentAtomSize) != 0) {
+    size_ += (kMaxNonCoherentAtomSize - (size_ % kMaxNonCoherentAtomSize));
+  }
+  VkMemoryAllocateInfo allocate_info{
+      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,  // sType
+      nullptr,                                 // pNext
+      size_,                                   // allocationSize
+      memory_type_index};
+  ::VkDeviceMemory device_memory;
+  LOG_ASSERT(==, log, VK_SUCCESS,
+             (*device)->vkAllocateMemory(*device, &allocate_info, nullptr,
+                                         &device_memory));
+  memory_.initialize(device_memory);
+  LOG_ASSERT(==, log, VK_SUCCESS,
+             (*device)->vkMapMemory(*device, memory_, 0, size_, 0,
+                                    reinterpret_cast<void**>(&base_address_)));
+  // Two frames in flight per swapchain image is plenty, we grow if more
+  // frames are pending.
+  frames_.resize(8);
+}
+
+VulkanLinearArena::~VulkanLinearArena() {
+  (*unmap_memory_function_)(device_, memory_);
+}
+
+bool VulkanLinearArena::AllocateMemory(::VkDeviceSize size,
+                                       ::VkDeviceSize alignment,
+                                       ::VkDeviceMemory* memory,
+                                       ::VkDeviceSize* offset,
+                                       char** base_address) {
+  // Just like in VulkanArena, mapped memory must be aligned to
+  // kMaxNonCoherentAtomSize, and sized in multiples of it.
+  alignment = alignment > kMaxNonCoherentAtomSize ? alignment
+                                                  : kMaxNonCoherentAtomSize;
+  if ((size % kMaxNonCoherentAtomSize) != 0) {
+    size += (kMaxNonCoherentAtomSize - (size % kMaxNonCoherentAtomSize));
+  }
+  const ::VkDeviceSize align_m_1 = alignment - 1;
+  LOG_ASSERT(==, log_, !(alignment & (align_m_1)),
+             true);  // Alignment must be power of 2.
+
+  const ::VkDeviceSize position = head_ % size_;
+  ::VkDeviceSize aligned_position = (position + align_m_1) & ~align_m_1;
+  ::VkDeviceSize new_head = head_ + (aligned_position - position) + size;
+  if (aligned_position + size > size_) {
+    // We do not fit at the end of the ring, skip what is left of it and
+    // start over at the beginning.
+    aligned_position = 0;
+    new_head = head_ + (size_ - position) + size;
+  }
+  if (new_head - tail_ > size_) {
+    return false;
+  }
+  head_ = new_head;
+
+  *memory = memory_;
+  *offset = aligned_position;
+  *base_address = base_address_ + aligned_position;
+  return true;
+}
+
+void VulkanLinearArena::EndFrame(::VkFence fence) {
+  if (num_frames_ == frames_.size()) {
+    // Grow the queue, keeping the pending frames in order.
+    containers::vector<Frame> frames(frames_.get_allocator());
+    frames.resize(frames_.size() * 2);
+    for (size_t i = 0; i < num_frames_; ++i) {
+      frames[i] = frames_[(first_frame_ + i) % frames_.size()];
+    }
+    frames_.swap(frames);
+    first_frame_ = 0;
+  }
+  frames_[(first_frame_ + num_frames_) % frames_.size()] = Frame{fence, head_};
+  ++num_frames_;
+}
+
+void VulkanLinearArena::RetireFrames(::VkFence fence) {
+  // Find the newest pending frame that was ended with the fence.
+  size_t retired = 0;
+  for (size_t i = 0; i < num_frames_; ++i) {
+    if (frames_[(first_frame_ + i) % frames_.size()].fence == fence) {
+      retired = i + 1;
+    }
+  }
+  if (retired == 0) {
+    return;
+  }
+  tail_ = frames_[(first_frame_ + retired - 1) % frames_.size()].end;
+  first_frame_ = (first_frame_ + retired) % frames_.size();
+  num_frames_ -= retired;
 }
 
 VulkanGraphicsPipeline::VulkanGraphicsPipeline(containers::Allocator* allocator,
@@ -17,15 +17,21 @@
 #define VULKAN_HELPERS_VULKAN_APPLICATION
 
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <mutex>
+#include <utility>
 
 #include "support/containers/allocator.h"
+#include "support/containers/flat_hash_map.h"
 #include "support/containers/ordered_multimap.h"
-#include "support/containers/unordered_map.h"
+#include "support/containers/slab_allocator.h"
+#include "support/containers/small_vector.h"
 #include "support/containers/vector.h"
 #include "support/entry/entry.h"
 #include "support/log/log.h"
 #include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/memory_budget.h"
 #include "vulkan_wrapper/command_buffer_wrapper.h"
 #include "vulkan_wrapper/device_wrapper.h"
 #include "vulkan_wrapper/instance_wrapper.h"
@@ -43,6 +49,46 @@ const ::VkDeviceSize kMaxNonCoherentAtomSize = 256;
 
 struct VulkanModel;
 struct AllocationToken;
+struct ArenaBlock;
+struct ArenaCacheRun;
+
+// Describes how a VulkanArena grows once the memory it was created with has
+// been exhausted.
+struct VulkanArenaGrowthPolicy {
+  // Each new block of device memory is growth_factor times the size of the
+  // previously allocated block, but never smaller than the allocation that
+  // triggered the growth.
+  float growth_factor = 2.0f;
+  // The largest block the arena will try to allocate, unless a single
+  // allocation requires more. 0 means unbounded.
+  ::VkDeviceSize max_block_size = 256 * 1024 * 1024;  // 256 MiB
+  // The most memory the arena may hold across all of its blocks.
+  // 0 means that the arena may grow until the device runs out of memory.
+  ::VkDeviceSize max_total_size = 0;
+  // If true, blocks other than the first one are returned to the device as
+  // soon as nothing is allocated from them.
+  bool release_empty_blocks = true;
+  // If true, release_empty_blocks still keeps one empty block as a spare,
+  // the largest one, so that an arena whose usage goes up and down across
+  // the end of a block does not allocate and free device memory every
+  // time.
+  bool keep_spare_block = true;
+  // If not nullptr, new blocks are shrunk so that they fit in what is left
+  // of the memory budget of their heap, if possible, and every block is
+  // reported to the budget.
+  VulkanMemoryBudget* budget = nullptr;
+};
+
+// Selects the structure a VulkanArena uses to keep track of free memory.
+enum class VulkanArenaStrategy {
+  // Best-fit search over an ordered multimap of free ranges. Every free
+  // range that is inserted into the map costs a heap allocation.
+  kOrderedMap,
+  // Two-Level Segregated Fit. Free ranges are kept in intrusive lists that
+  // are bucketed by size class and indexed by a pair of bitmaps, so that
+  // finding, inserting and removing a free range is O(1).
+  kTLSF,
+};
 
 struct VulkanApplicationOptions {
   uint32_t host_buffer_size = 1024 * 1024;      // 1 MiB
@@ -50,14 +96,30 @@ struct VulkanApplicationOptions {
   uint32_t device_buffer_size = 1024 * 1024;    // 1 MiB
   uint32_t coherent_buffer_size = 1024 * 1024;  // 1 MiB
   uint32_t device_peer_memory_size = 0;
+  uint32_t transient_host_buffer_size = 1024 * 1024;  // 1 MiB
+  uint32_t transient_image_size = 1024 * 1024;        // 1 MiB
+  uint32_t device_host_buffer_size = 1024 * 1024;     // 1 MiB
+  VulkanArenaGrowthPolicy arena_growth_policy;
+  VulkanArenaStrategy arena_strategy = VulkanArenaStrategy::kOrderedMap;
+  bool arena_thread_caches = false;
+  // Images and buffers of at least this many bytes get their own
+  // ::VkDeviceMemory, as do any that the driver prefers to give one.
+  // 0 means that only the driver's preference is taken into account.
+  // This only has an effect if VK_KHR_dedicated_allocation is enabled.
+  ::VkDeviceSize dedicated_allocation_threshold = 0;
+  // The fraction of every heap's budget that arenas try to leave unused when
+  // the memory budget is enabled.
+  float memory_budget_headroom = 0.1f;
 
   bool use_async_compute_queue = false;
   bool use_sparse_binding = false;
   bool use_device_groups = false;
   bool use_protected_memory = false;
   bool use_host_query_reset = false;
+  bool use_memory_budget = false;
   bool use_shared_presentation = false;
   bool use_mutable_swapchain_format = false;
+  bool use_transient_host_ring = false;
   uint32_t vulkan_api_version = VK_API_VERSION_1_0;
   bool use_10bit_hdr = false;
 
@@ -86,6 +148,56 @@ struct VulkanApplicationOptions {
     device_peer_memory_size = size_in_bytes;
     return *this;
   }
+  // Sets the size of the transient host-visible ring, if it is enabled.
+  VulkanApplicationOptions& SetTransientHostBufferSize(
+      uint32_t size_in_bytes) {
+    transient_host_buffer_size = size_in_bytes;
+    return *this;
+  }
+  // Creates the transient host-visible ring for CreateTransientHostBuffer.
+  // Only enable this if the application's frame loop calls
+  // EndTransientFrame and RetireTransientFrames, otherwise the ring fills up
+  // and is never reclaimed.
+  VulkanApplicationOptions& EnableTransientHostRing() {
+    use_transient_host_ring = true;
+    return *this;
+  }
+  // Sets the initial size of the arena for CreateAndBindDeviceHostBuffer.
+  // 0 disables the arena.
+  VulkanApplicationOptions& SetDeviceHostBufferSize(uint32_t size_in_bytes) {
+    device_host_buffer_size = size_in_bytes;
+    return *this;
+  }
+  // Sets the initial size of the lazily allocated arena for images created
+  // with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT. 0 disables the arena.
+  VulkanApplicationOptions& SetTransientImageSize(uint32_t size_in_bytes) {
+    transient_image_size = size_in_bytes;
+    return *this;
+  }
+  VulkanApplicationOptions& SetArenaGrowthPolicy(
+      const VulkanArenaGrowthPolicy& policy) {
+    arena_growth_policy = policy;
+    return *this;
+  }
+  VulkanApplicationOptions& SetArenaStrategy(VulkanArenaStrategy strategy) {
+    arena_strategy = strategy;
+    return *this;
+  }
+  // Serves small allocations from the arenas out of per-thread caches, see
+  // VulkanArena.
+  VulkanApplicationOptions& EnableArenaThreadCaches() {
+    arena_thread_caches = true;
+    return *this;
+  }
+  VulkanApplicationOptions& SetDedicatedAllocationThreshold(
+      ::VkDeviceSize size_in_bytes) {
+    dedicated_allocation_threshold = size_in_bytes;
+    return *this;
+  }
+  VulkanApplicationOptions& SetMemoryBudgetHeadroom(float fraction) {
+    memory_budget_headroom = fraction;
+    return *this;
+  }
 
   VulkanApplicationOptions& EnableAsyncComputeQueue() {
     use_async_compute_queue = true;
@@ -107,6 +219,12 @@ struct VulkanApplicationOptions {
     use_host_query_reset = true;
     return *this;
   }
+  // Sizes and grows the arenas from the memory budget of their heaps.
+  // VK_EXT_memory_budget must be passed as a device extension.
+  VulkanApplicationOptions& EnableMemoryBudget() {
+    use_memory_budget = true;
+    return *this;
+  }
   VulkanApplicationOptions& EnableSharedPresentation() {
     use_shared_presentation = true;
     return *this;
@@ -147,17 +265,74 @@ struct VulkanApplicationOptions {
   }
 };
 
+// The kind of resource that is bound to a range of arena memory.
+// Linear and non-linear resources must not share a page of
+// bufferImageGranularity bytes.
+enum class VulkanArenaResourceKind {
+  // The caller did not say, this is only compatible with other kUnknown
+  // resources.
+  kUnknown,
+  // Buffers and images with VK_IMAGE_TILING_LINEAR.
+  kLinear,
+  // Images with any other tiling.
+  kNonLinear,
+};
+
+// A snapshot of the memory held by a VulkanArena, see VulkanArena::GetStats.
+struct VulkanArenaStats {
+  uint32_t memory_type_index = 0;
+  uint32_t heap_index = 0;
+  // The device memory held by the arena, including dedicated allocations,
+  // now and at its peak.
+  ::VkDeviceSize total_size = 0;
+  ::VkDeviceSize peak_total_size = 0;
+  ::VkDeviceSize dedicated_size = 0;
+  uint64_t num_blocks = 0;
+  // The bytes handed out by the arena, including alignment padding, now and
+  // at its peak. Cached allocations count with the whole run of slots that
+  // they were carved out of.
+  ::VkDeviceSize used_size = 0;
+  ::VkDeviceSize peak_used_size = 0;
+  // The free ranges between allocations, and the largest of them.
+  uint64_t num_free_ranges = 0;
+  ::VkDeviceSize free_size = 0;
+  ::VkDeviceSize largest_free_range = 0;
+  // 1 - largest_free_range / free_size. 0 means that all free memory is in
+  // one range, values close to 1 mean that it is scattered in small ranges.
+  float fragmentation = 0.0f;
+  // The number of allocations that are currently live, and the number of
+  // allocations and frees over the lifetime of the arena.
+  uint64_t num_allocations = 0;
+  uint64_t total_allocations = 0;
+  uint64_t total_frees = 0;
+};
+
 // This class represents a location in GPU memory for storing data.
 // You can suballocate memory from this region, and return memory to the
 // arena for future use.
+// The arena starts out with a single block of device memory. If an
+// allocation cannot be satisfied from the existing blocks, a new block is
+// allocated according to the arena's VulkanArenaGrowthPolicy.
+// The arena may be used from multiple threads at once. Its blocks and free
+// ranges are guarded by a single lock. If thread caches are enabled, small
+// allocations are instead carved out of runs of equally sized slots, which
+// are kept in one of several cache shards. Every thread sticks to its own
+// shard, so threads only contend for the central lock when a run has to be
+// allocated or released.
 class VulkanArena {
  public:
   // If map==true then the memory for this Arena is mapped to a host-visible
   // address.
+  // If thread_caches==true, allocations of up to 64 KiB are rounded up to a
+  // power of two, and served from per-thread caches.
   VulkanArena(containers::Allocator* allocator, logging::Logger* log,
               ::VkDeviceSize buffer_size, uint32_t memory_type_index,
               VkDevice* device, bool map, uint32_t device_mask = 0,
-              VkMemoryAllocateFlags allocate_flags = 0);
+              VkMemoryAllocateFlags allocate_flags = 0,
+              const VulkanArenaGrowthPolicy& growth_policy =
+                  VulkanArenaGrowthPolicy(),
+              VulkanArenaStrategy strategy = VulkanArenaStrategy::kOrderedMap,
+              bool thread_caches = false);
   ~VulkanArena();
 
   // Returns an AllocationToken for the memory of a given size and
@@ -165,20 +340,274 @@ class VulkanArena {
   // ::VkDeviceSize representing the allocation location. If base_address is
   // not nullptr, sets *base_address to the host-visible address of the
   // returned memory, or nullptr if the memory was not mappable.
-  AllocationToken* AllocateMemory(::VkDeviceSize size, ::VkDeviceSize alignment,
-                                  ::VkDeviceMemory* memory,
-                                  ::VkDeviceSize* offset, char** base_address);
+  // If resources of different kinds are allocated from this arena, the
+  // allocation is padded as needed so that it does not share a page of
+  // bufferImageGranularity bytes with a neighbour of another kind.
+  AllocationToken* AllocateMemory(
+      ::VkDeviceSize size, ::VkDeviceSize alignment, ::VkDeviceMemory* memory,
+      ::VkDeviceSize* offset, char** base_address,
+      VulkanArenaResourceKind kind = VulkanArenaResourceKind::kUnknown);
+
+  // Allocates a new ::VkDeviceMemory of the given size from the memory type
+  // of this arena, that is dedicated to the given image or buffer through
+  // VkMemoryDedicatedAllocateInfo. Exactly one of image and buffer must not
+  // be VK_NULL_HANDLE. The memory is tracked with the rest of the arena,
+  // and is returned to the device as soon as the token is freed.
+  // VK_KHR_dedicated_allocation must be enabled on the device.
+  AllocationToken* AllocateDedicatedMemory(
+      ::VkDeviceSize size, ::VkImage image, ::VkBuffer buffer,
+      ::VkDeviceMemory* memory, ::VkDeviceSize* offset, char** base_address,
+      VulkanArenaResourceKind kind = VulkanArenaResourceKind::kUnknown);
 
   // Frees the memory pointed to by the AllocationToken.
   void FreeMemory(AllocationToken* token);
 
+  // Sets the bufferImageGranularity limit of the device. This must be called
+  // before the arena is used for both linear and non-linear resources.
+  void SetBufferImageGranularity(::VkDeviceSize granularity) {
+    buffer_image_granularity_ = granularity;
+  }
+
+  // Describes an allocation that PlanDefragmentation gave a new location.
+  struct Move {
+    // The token for the old location. It stays allocated until the caller
+    // frees it, which must not happen before the contents have been copied.
+    AllocationToken* old_token;
+    // The token for the new location.
+    AllocationToken* new_token;
+    void* owner;
+    VulkanArenaResourceKind kind;
+    ::VkDeviceMemory memory;
+    ::VkDeviceSize offset;
+  };
+
+  // Sets the object that owns the memory of the given token. Only
+  // allocations that have an owner are moved by PlanDefragmentation.
+  // Allocations from the thread caches are never moved.
+  void SetOwner(AllocationToken* token, void* owner);
+
+  // Finds new locations, closer to the front of the arena, for allocations
+  // that have an owner, starting with the ones furthest back, until at
+  // least max_bytes have been moved or nothing else can be moved. The new
+  // locations are allocated and the ownership is transferred to their
+  // tokens. Appends one Move for every allocation to moves.
+  void PlanDefragmentation(::VkDeviceSize max_bytes,
+                           containers::vector<Move>* moves);
+
+  uint32_t memory_type_index() const { return memory_type_index_; }
+  // Returns the number of blocks of device memory currently held.
+  size_t num_blocks() const { return blocks_.size(); }
+  // Returns the total number of bytes of device memory currently held,
+  // including dedicated allocations.
+  ::VkDeviceSize total_size() const { return total_size_; }
+  // Returns the number of bytes of device memory currently held in
+  // dedicated allocations.
+  ::VkDeviceSize dedicated_size() const { return dedicated_size_; }
+  // Returns the number of times the arena had to go to its allocator for
+  // the bookkeeping of its allocations. This stops increasing once the arena
+  // has seen its peak number of allocations.
+  uint64_t bookkeeping_root_allocations() const {
+    return node_allocator_.root_allocations();
+  }
+  // Returns the size of the largest contiguous free range in the arena.
+  // This walks every allocation, so it is not meant for hot paths.
+  // Slots that are free in the thread caches are not taken into account.
+  ::VkDeviceSize largest_free_range() const;
+  // Fills stats with the current state of the arena. Like
+  // largest_free_range, this walks every allocation.
+  void GetStats(VulkanArenaStats* stats) const;
+
  private:
+  // Allocations that need between 2^kMinCachedSizeLog2 and
+  // 2^kMaxCachedSizeLog2 bytes may be served from the thread caches.
+  static const uint32_t kMinCachedSizeLog2 = 8;
+  static const uint32_t kMaxCachedSizeLog2 = 16;
+  static const uint32_t kNumCacheSizeClasses =
+      kMaxCachedSizeLog2 - kMinCachedSizeLog2 + 1;
+  static const uint32_t kNumCacheShards = 16;
+  static const uint32_t kNumResourceKinds = 3;
+
+  // The cached runs of the threads that use one shard, by resource kind and
+  // size class. Runs that have free slots are kept apart from full runs.
+  struct CacheShard {
+    std::mutex mutex;
+    ArenaCacheRun* available_runs[kNumResourceKinds][kNumCacheSizeClasses];
+    ArenaCacheRun* full_runs[kNumResourceKinds][kNumCacheSizeClasses];
+  };
+
+  // Allocates and frees memory outside of the thread caches. mutex_ must be
+  // held.
+  AllocationToken* AllocateCentralMemory(::VkDeviceSize size,
+                                         ::VkDeviceSize alignment,
+                                         VulkanArenaResourceKind kind);
+  void FreeCentralMemory(AllocationToken* token);
+  // Lets the memory budget call its high-water mark callback for the blocks
+  // that were allocated or released. mutex_ must not be held.
+  void NotifyBudget();
+  // Returns true and sets *size_class if an allocation of the given size
+  // and alignment should be served from the thread caches.
+  bool GetCacheSizeClass(::VkDeviceSize size, ::VkDeviceSize alignment,
+                         uint32_t* size_class) const;
+  // Allocates and frees memory in the cache shard of the calling thread.
+  AllocationToken* AllocateCachedMemory(::VkDeviceSize size,
+                                        uint32_t size_class,
+                                        VulkanArenaResourceKind kind);
+  void FreeCachedMemory(AllocationToken* token);
+  // Allocates a new run from the arena for the given cache shard, and
+  // returns a run to the arena. Neither must be called with mutex_ held.
+  ArenaCacheRun* AllocateCacheRun(uint32_t shard, uint32_t size_class,
+                                  VulkanArenaResourceKind kind);
+  void ReleaseCacheRun(ArenaCacheRun* run);
+
+  // Applies the alignment and size requirements of the arena to the given
+  // size and alignment, and returns the size of the free range that is
+  // needed to hold them. Sets *check_granularity if the allocation may have
+  // to be kept off the pages of its neighbours.
+  ::VkDeviceSize PrepareAllocation(::VkDeviceSize* size,
+                                   ::VkDeviceSize* alignment,
+                                   VulkanArenaResourceKind kind,
+                                   bool* check_granularity);
+  // Carves an allocation of the given size and alignment, as returned by
+  // PrepareAllocation, out of the front of the given free token.
+  AllocationToken* AllocateFromToken(AllocationToken* token,
+                                     ::VkDeviceSize size,
+                                     ::VkDeviceSize alignment,
+                                     VulkanArenaResourceKind kind,
+                                     bool check_granularity);
+  // Allocates a new block of device memory of at least min_size bytes,
+  // preferring size bytes. Returns nullptr if the memory could not be
+  // allocated. If dedicated_info is not nullptr, it is chained into the
+  // allocation and the block is marked as dedicated.
+  ArenaBlock* AllocateBlock(
+      ::VkDeviceSize size, ::VkDeviceSize min_size,
+      VkMemoryDedicatedAllocateInfo* dedicated_info = nullptr);
+  // Returns the memory of the given block to the device. The block must
+  // contain a single free token.
+  void ReleaseBlock(ArenaBlock* block);
+  // Called when the given block, which the arena grew into, has become
+  // empty. Releases it, or another empty block, as the growth policy says.
+  void ReleaseEmptyBlock(ArenaBlock* block);
+
+  // Makes the given unused token available for future allocations.
+  void InsertFreeToken(AllocationToken* token);
+  // Removes the given unused token from the set of free tokens.
+  void RemoveFreeToken(AllocationToken* token);
+  // Returns an unused token that holds at least size bytes, or nullptr if
+  // there is none.
+  AllocationToken* FindFreeToken(::VkDeviceSize size);
+
+  // Every power-of-two size class in the TLSF index is split into
+  // 2^kTLSFSecondLevelLog2 linearly spaced buckets.
+  static const uint32_t kTLSFSecondLevelLog2 = 5;
+  static const uint32_t kTLSFSecondLevelCount = 1 << kTLSFSecondLevelLog2;
+  // Sizes below kTLSFSecondLevelCount share the first first-level class,
+  // every other bit of a 64-bit size gets its own.
+  static const uint32_t kTLSFFirstLevelCount = 64 - kTLSFSecondLevelLog2 + 1;
+
   containers::Allocator* allocator_;
+  // Guards everything below, except for the cache shards.
+  mutable std::mutex mutex_;
+  // Every AllocationToken, and every node of freeblocks_, is allocated from
+  // here so that splitting and coalescing free ranges does not have to go
+  // to allocator_ once the arena has warmed up.
+  containers::SlabAllocator node_allocator_;
+  VulkanArenaStrategy strategy_;
+  // Free tokens, used when strategy_ == VulkanArenaStrategy::kOrderedMap.
   containers::ordered_multimap<::VkDeviceSize, AllocationToken*> freeblocks_;
-  AllocationToken* first_block_;
+  // Free tokens, used when strategy_ == VulkanArenaStrategy::kTLSF.
+  // Bit i of tlsf_first_level_bitmap_ is set if any bit of
+  // tlsf_second_level_bitmaps_[i] is set, and bit j of
+  // tlsf_second_level_bitmaps_[i] is set if tlsf_free_lists_[i][j] is not
+  // empty.
+  uint64_t tlsf_first_level_bitmap_;
+  uint32_t tlsf_second_level_bitmaps_[kTLSFFirstLevelCount];
+  AllocationToken* tlsf_free_lists_[kTLSFFirstLevelCount]
+                                   [kTLSFSecondLevelCount];
+  containers::vector<ArenaBlock*> blocks_;
+  ::VkDeviceSize total_size_;
+  ::VkDeviceSize peak_total_size_;
+  ::VkDeviceSize dedicated_size_;
+  ::VkDeviceSize used_size_;
+  ::VkDeviceSize peak_used_size_;
+  // Cached allocations are counted outside of mutex_.
+  std::atomic<uint64_t> total_allocations_;
+  std::atomic<uint64_t> total_frees_;
+  ::VkDeviceSize next_block_size_;
+  VulkanArenaGrowthPolicy growth_policy_;
+  ::VkDeviceSize buffer_image_granularity_;
+  // Bit i is set if a resource of VulkanArenaResourceKind i was ever
+  // allocated from this arena.
+  uint32_t resource_kinds_;
+  uint32_t memory_type_index_;
+  uint32_t heap_index_;
+  ::VkDeviceSize heap_size_;
+  bool map_;
+  VkMemoryAllocateFlagsInfo allocate_flags_info_;
+  bool use_allocate_flags_info_;
+  ::VkDevice device_;
+  EagerDeviceFunction<PFN_vkAllocateMemory>* allocate_memory_function_;
+  EagerDeviceFunction<PFN_vkFreeMemory>* free_memory_function_;
+  EagerDeviceFunction<PFN_vkMapMemory>* map_memory_function_;
+  EagerDeviceFunction<PFN_vkUnmapMemory>* unmap_memory_function_;
+  logging::Logger* log_;
+  bool use_thread_caches_;
+  CacheShard cache_shards_[kNumCacheShards];
+};
+
+// This class is a ring of host-visible memory for allocations that only
+// live for a frame or two. Allocating memory just moves a pointer forward.
+// Memory is never freed individually. Instead, everything allocated before a
+// call to EndFrame is retired together, once the fence given to EndFrame
+// has signaled and RetireFrames has been called with it.
+// Unlike VulkanArena, this is not thread-safe.
+class VulkanLinearArena {
+ public:
+  VulkanLinearArena(containers::Allocator* allocator, logging::Logger* log,
+                    ::VkDeviceSize buffer_size, uint32_t memory_type_index,
+                    VkDevice* device);
+  ~VulkanLinearArena();
+
+  // Reserves memory of a given size and alignment. Fills *memory, *offset
+  // and *base_address with the ::VkDeviceMemory, ::VkDeviceSize and
+  // host-visible address of the allocation. Returns false, without
+  // touching any of them, if there is not enough room left in the ring.
+  bool AllocateMemory(::VkDeviceSize size, ::VkDeviceSize alignment,
+                      ::VkDeviceMemory* memory, ::VkDeviceSize* offset,
+                      char** base_address);
+
+  // Closes the current frame. Everything allocated since the last call
+  // to EndFrame will be retired by the RetireFrames call for this fence.
+  void EndFrame(::VkFence fence);
+
+  // Retires every frame up to and including the most recent one that was
+  // ended with the given fence. The caller must make sure that the fence
+  // has signaled. Does nothing if no pending frame was ended with the fence.
+  void RetireFrames(::VkFence fence);
+
+  uint32_t memory_type_index() const { return memory_type_index_; }
+
+ private:
+  struct Frame {
+    ::VkFence fence;
+    // The value of head_ when the frame was ended.
+    ::VkDeviceSize end;
+  };
+
+  // Pending frames, stored as a circular queue of num_frames_ elements
+  // starting at first_frame_.
+  containers::vector<Frame> frames_;
+  size_t first_frame_;
+  size_t num_frames_;
+
+  ::VkDeviceSize size_;
+  // head_ and tail_ only ever increase, their difference is the number of
+  // bytes of the ring that are in use.
+  ::VkDeviceSize head_;
+  ::VkDeviceSize tail_;
+  uint32_t memory_type_index_;
   char* base_address_;
   ::VkDevice device_;
-  LazyDeviceFunction<PFN_vkUnmapMemory>* unmap_memory_function_;
+  EagerDeviceFunction<PFN_vkUnmapMemory>* unmap_memory_function_;
   VkDeviceMemory memory_;
   logging::Logger* log_;
 };
@@ -365,7 +794,9 @@ class PipelineLayout {
                  std::initializer_list<VkPushConstantRange> ranges = {})
       : pipeline_layout_(VK_NULL_HANDLE, nullptr, device),
         descriptor_set_layouts_(allocator) {
-    containers::vector<::VkDescriptorSetLayout> raw_layouts(allocator);
+    // Pipelines rarely use more than a handful of sets.
+    containers::small_vector<::VkDescriptorSetLayout, 8> raw_layouts(
+        allocator);
     raw_layouts.reserve(layouts.size());
 
     descriptor_set_layouts_.reserve(layouts.size());
@@ -375,18 +806,14 @@ class PipelineLayout {
       raw_layouts.push_back(descriptor_set_layouts_.back());
     }
 
-    containers::vector<VkPushConstantRange> push_constant_ranges(
-        ranges.begin(), ranges.end(), allocator);
-
     VkPipelineLayoutCreateInfo create_info = {
         VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,  // sType
         nullptr,                                        // pNext
         0,                                              // flags
         static_cast<uint32_t>(raw_layouts.size()),      // setLayoutCount
         raw_layouts.data(),                             // pSetLayouts
-        static_cast<uint32_t>(
-            push_constant_ranges.size()),  // pushConstantRangeCount
-        push_constant_ranges.data(),       // pPushConstantRanges
+        static_cast<uint32_t>(ranges.size()),  // pushConstantRangeCount
+        ranges.begin(),                        // pPushConstantRanges
     };
 
     ::VkPipelineLayout layout;
@@ -445,6 +872,7 @@ class VulkanApplication {
         : image_(std::move(image)), format_(format) {}
 
    private:
+    friend class ::vulkan::VulkanApplication;
     VkImage image_;
     VkFormat format_;
   };
@@ -465,6 +893,9 @@ class VulkanApplication {
         : ImageCore(std::move(image), format), heap_(heap), token_(token) {}
     VulkanArena* heap_;
     AllocationToken* token_;
+    // Only valid if the image was passed to MarkMovable.
+    VkImageCreateInfo create_info_;
+    VkImageLayout layout_;
   };
 
   // The SparseImage class holds onto a VkImage as well as the memories that
@@ -498,7 +929,11 @@ class VulkanApplication {
   class Buffer {
    public:
     operator ::VkBuffer() const { return buffer_; }
-    ~Buffer() { heap_->FreeMemory(token_); }
+    ~Buffer() {
+      if (heap_) {
+        heap_->FreeMemory(token_);
+      }
+    }
     ::VkDeviceSize size() const { return size_; }
 
     // Returns the base_address of the host-visible section of memory.
@@ -554,8 +989,8 @@ class VulkanApplication {
         VulkanArena* heap, AllocationToken* token, VkBuffer&& buffer,
         char* base_address, ::VkDevice device, ::VkDeviceMemory memory,
         ::VkDeviceSize offset, ::VkDeviceSize size,
-        LazyDeviceFunction<PFN_vkFlushMappedMemoryRanges>* flush_memory_range,
-        LazyDeviceFunction<PFN_vkInvalidateMappedMemoryRanges>*
+        EagerDeviceFunction<PFN_vkFlushMappedMemoryRanges>* flush_memory_range,
+        EagerDeviceFunction<PFN_vkInvalidateMappedMemoryRanges>*
             invalidate_memory_range)
         : base_address_(base_address),
           heap_(heap),
@@ -575,9 +1010,33 @@ class VulkanApplication {
     ::VkDeviceMemory memory_;
     ::VkDeviceSize offset_;
     ::VkDeviceSize size_;
-    LazyDeviceFunction<PFN_vkFlushMappedMemoryRanges>* flush_memory_range_;
-    LazyDeviceFunction<PFN_vkInvalidateMappedMemoryRanges>*
+    EagerDeviceFunction<PFN_vkFlushMappedMemoryRanges>* flush_memory_range_;
+    EagerDeviceFunction<PFN_vkInvalidateMappedMemoryRanges>*
         invalidate_memory_range_;
+    // Only valid if the buffer was passed to MarkMovable.
+    VkBufferCreateInfo create_info_;
+  };
+
+  // Reports on what DefragmentDeviceMemory and FinishDefragmentation did.
+  struct DefragmentationStats {
+    uint32_t allocations_moved = 0;
+    ::VkDeviceSize bytes_moved = 0;
+    // The amount of device memory that was given back to the device. Memory
+    // is only given back when the moves leave a block that the arena grew
+    // empty, and the growth policy releases empty blocks other than its
+    // spare block, so this is often 0 even when bytes were moved.
+    // largest_free_range_after shows how much the arenas were compacted.
+    ::VkDeviceSize bytes_released = 0;
+    // The largest contiguous free ranges of the device-only arenas, before
+    // DefragmentDeviceMemory and after FinishDefragmentation.
+    ::VkDeviceSize largest_free_range_before = 0;
+    ::VkDeviceSize largest_free_range_after = 0;
+  };
+
+  // The statistics of one of the arenas of the application.
+  struct NamedArenaStats {
+    const char* name;
+    VulkanArenaStats stats;
   };
 
   // On creation creates an instance, device, surface, swapchain, queues,
@@ -589,9 +1048,20 @@ class VulkanApplication {
       const std::initializer_list<const char*> instance_extensions = {},
       const std::initializer_list<const char*> device_extensions = {},
       const VkPhysicalDeviceFeatures& features = {0});
+  // Writes the memory statistics of the application to the file that was
+  // given on the command-line, if any.
+  ~VulkanApplication();
+
+  // Appends the statistics of every arena of the application to stats.
+  void GetMemoryStats(containers::vector<NamedArenaStats>* stats) const;
+  // Writes the statistics of every arena to the given file as JSON.
+  // Returns false if the file could not be written.
+  bool WriteMemoryStats(const char* file_name) const;
 
   // Creates an image from the given create_info, and binds memory from the
-  // device-only image Arena.
+  // device-only image Arena. Images with
+  // VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT are bound to lazily allocated
+  // memory instead, if the device has any.
   containers::unique_ptr<Image> CreateAndBindImage(
       const VkImageCreateInfo* create_info,
       const uint32_t* device_indices = nullptr);
@@ -618,6 +1088,26 @@ class VulkanApplication {
       const VkBufferCreateInfo* create_info,
       const uint32_t* device_indices = nullptr);
   // Creates a buffer from the given create_info, and binds memory from the
+  // transient host-visible ring. The memory stays valid until the frame it
+  // was allocated in has been retired, see EndTransientFrame. The ring only
+  // exists if VulkanApplicationOptions::EnableTransientHostRing was called.
+  // If the ring is full, or was not created, this falls back to
+  // CreateAndBindHostBuffer.
+  // The ring is not thread-safe, so this, EndTransientFrame and
+  // RetireTransientFrames must not be called from several threads at once.
+  containers::unique_ptr<Buffer> CreateTransientHostBuffer(
+      const VkBufferCreateInfo* create_info);
+  // Marks the end of a frame for the transient host-visible ring.
+  // Memory for the buffers created by CreateTransientHostBuffer since the
+  // previous call is reclaimed by the RetireTransientFrames call for fence.
+  // fence must be signaled by a submission that is ordered after every use
+  // of those buffers.
+  void EndTransientFrame(::VkFence fence);
+  // Reclaims the transient host-visible memory of every frame up to and
+  // including the one that was ended with the given fence. The fence must
+  // have signaled.
+  void RetireTransientFrames(::VkFence fence);
+  // Creates a buffer from the given create_info, and binds memory from the
   // host-coherent buffer arena. Also maps the memory needed for the device.
   containers::unique_ptr<Buffer> CreateAndBindCoherentBuffer(
       const VkBufferCreateInfo* create_info,
@@ -641,6 +1131,17 @@ class VulkanApplication {
       const VkBufferCreateInfo* create_info,
       const uint32_t* device_indices = nullptr);
 
+  // Creates a buffer from the given create_info, and binds memory that is
+  // both device local and host visible, if the device has any. Also maps
+  // the memory. Otherwise, or if the buffer cannot live in that memory,
+  // this falls back to CreateAndBindHostBuffer.
+  // This is only supported with a single device.
+  containers::unique_ptr<Buffer> CreateAndBindDeviceHostBuffer(
+      const VkBufferCreateInfo* create_info);
+  // Returns true if CreateAndBindDeviceHostBuffer can bind device local
+  // memory.
+  bool has_device_host_memory() const { return device_host_heap_ != nullptr; }
+
   // Creates a buffer from the given create_info, and bind memory
   // from the device-only peer buffer Arena. That is to say,
   // this memory can be copied into.
@@ -652,6 +1153,39 @@ class VulkanApplication {
   containers::unique_ptr<Buffer> CreateAndBindDefaultExclusiveDeviceBuffer(
       VkDeviceSize size, VkBufferUsageFlags usages,
       const uint32_t* device_indices = nullptr);
+  // Allows DefragmentDeviceMemory to move the given buffer, which must have
+  // been created by CreateAndBindDeviceBuffer from create_info, on a single
+  // device. The buffer must have been created with
+  // VK_BUFFER_USAGE_TRANSFER_SRC_BIT and VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+  // exclusive sharing and no pNext chain.
+  void MarkMovable(Buffer* buffer, const VkBufferCreateInfo* create_info);
+  // Allows DefragmentDeviceMemory to move the given image, which must have
+  // been created by CreateAndBindImage from create_info, on a single device.
+  // The image must have optimal tiling, a single plane, exclusive sharing,
+  // no pNext chain, and VK_IMAGE_USAGE_TRANSFER_SRC_BIT and
+  // VK_IMAGE_USAGE_TRANSFER_DST_BIT. layout is the layout the image is in
+  // whenever a defragmentation command buffer executes, it is left in the
+  // same layout.
+  void MarkMovable(Image* image, const VkImageCreateInfo* create_info,
+                   VkImageLayout layout);
+  // Compacts the device-only arenas by moving up to about
+  // max_bytes_to_move bytes of movable buffers and images to free ranges
+  // closer to the front of their arena. For every moved resource a new
+  // VkBuffer or VkImage is created and bound to the new location, and the
+  // copy of its contents is recorded into command_buffer, between barriers
+  // that wait for all prior work and make the copies visible to all later
+  // work. The Buffer and Image objects are updated in place to refer to the
+  // new resources, so any views or descriptors that refer to them must be
+  // recreated. The old resources and their memory are kept until
+  // FinishDefragmentation is called, which must only happen once
+  // command_buffer has completed execution.
+  void DefragmentDeviceMemory(VkCommandBuffer* command_buffer,
+                              ::VkDeviceSize max_bytes_to_move,
+                              DefragmentationStats* stats);
+  // Destroys the resources that were replaced by the last call to
+  // DefragmentDeviceMemory, and returns their memory to the arenas.
+  void FinishDefragmentation(DefragmentationStats* stats);
+
   // Create a buffer view for the given buffer, with the same format of the
   // given buffer and the given buffer view offset and range.
   containers::unique_ptr<VkBufferView> CreateBufferView(::VkBuffer buffer,
@@ -751,25 +1285,21 @@ class VulkanApplication {
       std::initializer_list<::VkSemaphore> wait_semaphores,
       std::initializer_list<VkPipelineStageFlags> wait_stages,
       std::initializer_list<::VkSemaphore> signal_semaphores, ::VkFence fence) {
-    containers::vector<::VkSemaphore> wait_semaphores_vec(wait_semaphores,
-                                                          allocator_);
-    containers::vector<VkPipelineStageFlags> wait_stages_vec(wait_stages,
-                                                             allocator_);
-    containers::vector<::VkSemaphore> signal_semaphores_vec(signal_semaphores,
-                                                            allocator_);
     (*cmd_buf)->vkEndCommandBuffer(*cmd_buf);
 
     auto& q = *queue;
+    // The elements of an initializer_list are already contiguous, so they
+    // can be handed to Vulkan as they are.
     VkSubmitInfo submit_info{
-        VK_STRUCTURE_TYPE_SUBMIT_INFO,         // sType
-        nullptr,                               // pNext
-        uint32_t(wait_semaphores_vec.size()),  // waitSemaphoreCount
-        wait_semaphores_vec.data(),            // pWaitSemaphores
-        wait_stages_vec.data(),                // pWaitDstStageMask,
-        1,                                     // commandBufferCount
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,     // sType
+        nullptr,                           // pNext
+        uint32_t(wait_semaphores.size()),  // waitSemaphoreCount
+        wait_semaphores.begin(),           // pWaitSemaphores
+        wait_stages.begin(),               // pWaitDstStageMask,
+        1,                                 // commandBufferCount
         &cmd_buf->get_command_buffer(),
-        uint32_t(signal_semaphores_vec.size()),  // signalSemaphoreCount
-        signal_semaphores_vec.data()             // pSignalSemaphores
+        uint32_t(signal_semaphores.size()),  // signalSemaphoreCount
+        signal_semaphores.begin()            // pSignalSemaphores
     };
 
     VkResult r = q->vkQueueSubmit(q, 1, &submit_info, fence);
@@ -864,23 +1394,16 @@ class VulkanApplication {
       std::initializer_list<VkAttachmentDescription> attachments,
       std::initializer_list<VkSubpassDescription> subpasses,
       std::initializer_list<VkSubpassDependency> dependencies) {
-    containers::vector<VkAttachmentDescription> attach(allocator_);
-    containers::vector<VkSubpassDescription> subpass(allocator_);
-    containers::vector<VkSubpassDependency> dep(allocator_);
-    attach.insert(attach.begin(), attachments.begin(), attachments.end());
-    subpass.insert(subpass.begin(), subpasses.begin(), subpasses.end());
-    dep.insert(dep.begin(), dependencies.begin(), dependencies.end());
-
     VkRenderPassCreateInfo create_info{
         VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,  // sType
         nullptr,                                    // pNext
         0,                                          // flags
-        static_cast<uint32_t>(attach.size()),       // attachmentCount
-        attach.size() ? attach.data() : nullptr,    // pAttachments
-        static_cast<uint32_t>(subpass.size()),      // subpassCount
-        subpass.size() ? subpass.data() : nullptr,  // pSubpasses
-        static_cast<uint32_t>(dep.size()),          // dependencyCount
-        dep.size() ? dep.data() : nullptr,          // pDependencies
+        static_cast<uint32_t>(attachments.size()),  // attachmentCount
+        attachments.size() ? attachments.begin() : nullptr,  // pAttachments
+        static_cast<uint32_t>(subpasses.size()),             // subpassCount
+        subpasses.size() ? subpasses.begin() : nullptr,      // pSubpasses
+        static_cast<uint32_t>(dependencies.size()),          // dependencyCount
+        dependencies.size() ? dependencies.begin() : nullptr,  // pDependencies
     };
 
     ::VkRenderPass render_pass;
@@ -911,23 +1434,16 @@ class VulkanApplication {
       std::initializer_list<VkSubpassDependency2KHR> dependencies,
       uint32_t correlated_view_mask_count = 0,
       const uint32_t* correlated_view_masks = nullptr) {
-    containers::vector<VkAttachmentDescription2KHR> attach(allocator_);
-    containers::vector<VkSubpassDescription2KHR> subpass(allocator_);
-    containers::vector<VkSubpassDependency2KHR> dep(allocator_);
-    attach.insert(attach.begin(), attachments.begin(), attachments.end());
-    subpass.insert(subpass.begin(), subpasses.begin(), subpasses.end());
-    dep.insert(dep.begin(), dependencies.begin(), dependencies.end());
-
     VkRenderPassCreateInfo2KHR create_info{
         VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2_KHR,  // sType
         nullptr,                                          // pNext
         0,                                                // flags
-        static_cast<uint32_t>(attach.size()),             // attachmentCount
-        attach.size() ? attach.data() : nullptr,          // pAttachments
-        static_cast<uint32_t>(subpass.size()),            // subpassCount
-        subpass.size() ? subpass.data() : nullptr,        // pSubpasses
-        static_cast<uint32_t>(dep.size()),                // dependencyCount
-        dep.size() ? dep.data() : nullptr,                // pDependencies
+        static_cast<uint32_t>(attachments.size()),        // attachmentCount
+        attachments.size() ? attachments.begin() : nullptr,  // pAttachments
+        static_cast<uint32_t>(subpasses.size()),             // subpassCount
+        subpasses.size() ? subpasses.begin() : nullptr,      // pSubpasses
+        static_cast<uint32_t>(dependencies.size()),          // dependencyCount
+        dependencies.size() ? dependencies.begin() : nullptr,  // pDependencies
         correlated_view_mask_count,  // correlatedViewMaskCount
         correlated_view_masks        // pCorrelatedViewMasks
     };
@@ -970,10 +1486,29 @@ class VulkanApplication {
 
   containers::Allocator* GetAllocator() { return allocator_; }
 
+  // Returns the memory budget that the arenas are sized from, or nullptr if
+  // the application was not created with the memory budget enabled. Use it
+  // to register high-water mark callbacks, and call Update on it to refresh
+  // the usage of other processes.
+  VulkanMemoryBudget* memory_budget() { return memory_budget_.get(); }
+
  private:
   containers::unique_ptr<Buffer> CreateAndBindBuffer(
       VulkanArena* heap, const VkBufferCreateInfo* create_info,
       const uint32_t* device_indices);
+  // Binds memory from the given heap to buffer, which must be able to live
+  // in the memory type of the heap, and takes ownership of buffer.
+  containers::unique_ptr<Buffer> BindBuffer(
+      VulkanArena* heap, ::VkBuffer buffer,
+      const VkMemoryRequirements& requirements, bool dedicated,
+      const uint32_t* device_indices);
+
+  // Return the memory requirements of the given image or buffer, and set
+  // *dedicated if it should be given a dedicated allocation.
+  VkMemoryRequirements GetImageMemoryRequirements(::VkImage image,
+                                                  bool* dedicated);
+  VkMemoryRequirements GetBufferMemoryRequirements(::VkBuffer buffer,
+                                                   bool* dedicated);
 
   // Intended to be called by the constructor to create the device, since
   // VkDevice does not have a default constructor.
@@ -993,14 +1528,21 @@ class VulkanApplication {
       const VkPhysicalDeviceFeatures& features, bool create_async_compute_queue,
       bool use_sparse_binding, void* device_next);
 
+  // Command buffers hold on to a pointer to their pool, so every pool lives
+  // in its own allocation that does not move when command_pools_ grows.
   VkCommandPool& GetCommandPool(uint32_t queueFamilyIndex = 0) {
-    if (command_pools_.find(queueFamilyIndex) == command_pools_.end()) {
-      command_pools_.emplace(
-          queueFamilyIndex,
-          CreateDefaultCommandPool(allocator_, device_, use_protected_memory_,
-                                   queueFamilyIndex));
+    auto pool = command_pools_.find(queueFamilyIndex);
+    if (pool == command_pools_.end()) {
+      pool = command_pools_
+                 .emplace(queueFamilyIndex,
+                          containers::make_unique<VkCommandPool>(
+                              allocator_,
+                              CreateDefaultCommandPool(allocator_, device_,
+                                                       use_protected_memory_,
+                                                       queueFamilyIndex)))
+                 .first;
     }
-    return command_pools_.at(queueFamilyIndex);
+    return *pool->second;
   }
 
   containers::Allocator* allocator_;
@@ -1018,20 +1560,46 @@ class VulkanApplication {
   uint32_t compute_queue_index_;
   uint32_t sparse_binding_queue_index_;
   bool use_protected_memory_;
+  // True if VK_KHR_dedicated_allocation was enabled on the device.
+  bool use_dedicated_allocations_;
+  ::VkDeviceSize dedicated_allocation_threshold_;
 
   LibraryWrapper library_wrapper_;
   VkInstance instance_;
   VkSurfaceKHR surface_;
   VkDevice device_;
   VkSwapchainKHR swapchain_;
-  containers::unordered_map<uint32_t, VkCommandPool> command_pools_;
+  containers::flat_hash_map<uint32_t, containers::unique_ptr<VkCommandPool>>
+      command_pools_;
   VkPipelineCache pipeline_cache_;
+  // This must outlive every arena, since they report to it.
+  containers::unique_ptr<VulkanMemoryBudget> memory_budget_;
   containers::vector<containers::unique_ptr<VulkanArena>> host_accessible_heap_;
   containers::vector<containers::unique_ptr<VulkanArena>> coherent_heap_;
   containers::unique_ptr<VulkanArena> device_only_image_heap_;
   containers::unique_ptr<VulkanArena> device_only_buffer_heap_;
+  // Device local memory that can be mapped. This is nullptr if the device
+  // has none.
+  containers::unique_ptr<VulkanArena> device_host_heap_;
+  // The arena that images are allocated from. This is
+  // device_only_buffer_heap_ if buffers and images can share a memory type,
+  // otherwise it is device_only_image_heap_.
+  VulkanArena* image_heap_;
+  // Lazily allocated memory for transient attachments. This is nullptr if
+  // the device has no lazily allocated memory type.
+  containers::unique_ptr<VulkanArena> transient_image_heap_;
   containers::vector<containers::unique_ptr<VulkanArena>>
       device_peer_memory_heaps_;
+  // The transient host-visible ring. This is nullptr unless the options
+  // enabled it.
+  containers::unique_ptr<VulkanLinearArena> transient_host_heap_;
+  // The resources that were replaced by DefragmentDeviceMemory, and the
+  // memory that they are bound to, until FinishDefragmentation is called.
+  containers::vector<VkBuffer> defragmented_buffers_;
+  containers::vector<VkImage> defragmented_images_;
+  containers::vector<std::pair<VulkanArena*, AllocationToken*>>
+      defragmented_tokens_;
+  ::VkDeviceSize defragmented_arena_size_;
   containers::vector<::VkImage> swapchain_images_;
   std::atomic<bool> should_exit_;
 };
@@ -0,0 +1,217 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_wrapper/call_stats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include "support/containers/vector.h"
+
+namespace vulkan {
+namespace call_stats {
+namespace internal {
+std::atomic<bool> recording(false);
+}  // namespace internal
+
+namespace {
+// The counts of one function on one thread. Only the owning thread writes
+// them, so they are updated with plain loads and stores, and are atomic only
+// so that Log and Reset can read and clear them at the same time.
+struct Counter {
+  std::atomic<uint64_t> calls;
+  std::atomic<uint64_t> total_nanoseconds;
+  std::atomic<uint64_t> max_nanoseconds;
+};
+
+// The counters of one thread. They are taken by a thread on the first call
+// it records, and handed back when the thread exits so that the next thread
+// to start reuses them. They are never freed, as threads may record until
+// the program exits, so they are not taken from an allocator.
+struct ThreadCounters {
+  Counter counters[kMaxFunctions];
+  std::atomic<bool> in_use;
+  ThreadCounters* next;
+};
+
+// Guards the registered names and the list of thread counters.
+std::mutex mutex;
+const char* names[kMaxFunctions];
+std::atomic<uint32_t> num_functions(0);
+// The counters of every thread that has recorded a call.
+ThreadCounters* thread_counters = nullptr;
+
+ThreadCounters* TakeThreadCounters() {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (ThreadCounters* counters = thread_counters; counters;
+       counters = counters->next) {
+    if (!counters->in_use.load(std::memory_order_relaxed)) {
+      counters->in_use.store(true, std::memory_order_relaxed);
+      return counters;
+    }
+  }
+  ThreadCounters* counters = new ThreadCounters();
+  counters->in_use.store(true, std::memory_order_relaxed);
+  counters->next = thread_counters;
+  thread_counters = counters;
+  return counters;
+}
+
+// Hands the counters of a thread back when the thread exits.
+class ThreadCountersHolder {
+ public:
+  ThreadCountersHolder() : counters_(nullptr) {}
+  ~ThreadCountersHolder() {
+    if (counters_) {
+      std::lock_guard<std::mutex> lock(mutex);
+      counters_->in_use.store(false, std::memory_order_relaxed);
+      // Another thread may take the counters from now on, so calls that are
+      // recorded later on this thread must not write to them.
+      counters_ = nullptr;
+    }
+  }
+
+  ThreadCounters* get() {
+    if (!counters_) {
+      counters_ = TakeThreadCounters();
+    }
+    return counters_;
+  }
+
+ private:
+  ThreadCounters* counters_;
+};
+
+thread_local ThreadCountersHolder thread_counters_holder;
+
+struct FunctionStats {
+  const char* name;
+  uint64_t calls;
+  uint64_t total_nanoseconds;
+  uint64_t max_nanoseconds;
+};
+}  // anonymous namespace
+
+uint32_t Register(const char* function_name) {
+  std::lock_guard<std::mutex> lock(mutex);
+  const uint32_t count = num_functions.load(std::memory_order_relaxed);
+  for (uint32_t i = 0; i < count; ++i) {
+    // The names are usually the same string constant.
+    if (names[i] == function_name || strcmp(names[i], function_name) == 0) {
+      return i;
+    }
+  }
+  if (count == kMaxFunctions) {
+    return kMaxFunctions;
+  }
+  names[count] = function_name;
+  num_functions.store(count + 1, std::memory_order_release);
+  return count;
+}
+
+void Start() { internal::recording.store(true, std::memory_order_relaxed); }
+
+void Stop() { internal::recording.store(false, std::memory_order_relaxed); }
+
+void Reset() {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (ThreadCounters* counters = thread_counters; counters;
+       counters = counters->next) {
+    for (uint32_t i = 0; i < kMaxFunctions; ++i) {
+      Counter& counter = counters->counters[i];
+      counter.calls.store(0, std::memory_order_relaxed);
+      counter.total_nanoseconds.store(0, std::memory_order_relaxed);
+      counter.max_nanoseconds.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+void Log(containers::Allocator* allocator, logging::Logger* log) {
+  containers::vector<FunctionStats> stats(allocator);
+  uint64_t total_nanoseconds = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint32_t count = num_functions.load(std::memory_order_relaxed);
+    stats.resize(count, FunctionStats{nullptr, 0, 0, 0});
+    for (uint32_t i = 0; i < count; ++i) {
+      stats[i].name = names[i];
+    }
+    for (ThreadCounters* counters = thread_counters; counters;
+         counters = counters->next) {
+      for (uint32_t i = 0; i < count; ++i) {
+        const Counter& counter = counters->counters[i];
+        stats[i].calls += counter.calls.load(std::memory_order_relaxed);
+        stats[i].total_nanoseconds +=
+            counter.total_nanoseconds.load(std::memory_order_relaxed);
+        stats[i].max_nanoseconds =
+            std::max(stats[i].max_nanoseconds,
+                     counter.max_nanoseconds.load(std::memory_order_relaxed));
+      }
+    }
+  }
+  stats.erase(std::remove_if(stats.begin(), stats.end(),
+                             [](const FunctionStats& function) {
+                               return function.calls == 0;
+                             }),
+              stats.end());
+  std::sort(stats.begin(), stats.end(),
+            [](const FunctionStats& a, const FunctionStats& b) {
+              return a.total_nanoseconds > b.total_nanoseconds;
+            });
+  for (const FunctionStats& function : stats) {
+    total_nanoseconds += function.total_nanoseconds;
+  }
+
+  char line[256];
+  snprintf(line, sizeof(line), "%-48s %10s %12s %10s %10s %6s", "Function",
+           "Calls", "Total ms", "Mean us", "Max us", "%");
+  log->LogInfo(line);
+  for (const FunctionStats& function : stats) {
+    snprintf(line, sizeof(line), "%-48s %10llu %12.3f %10.3f %10.3f %6.2f",
+             function.name, static_cast<unsigned long long>(function.calls),
+             function.total_nanoseconds / 1e6,
+             function.total_nanoseconds / 1e3 / function.calls,
+             function.max_nanoseconds / 1e3,
+             total_nanoseconds
+                 ? 100.0 * function.total_nanoseconds / total_nanoseconds
+                 : 0.0);
+    log->LogInfo(line);
+  }
+  snprintf(line, sizeof(line), "%-48s %10s %12.3f", "Total", "",
+           total_nanoseconds / 1e6);
+  log->LogInfo(line);
+}
+
+namespace internal {
+void Record(uint32_t id, uint64_t nanoseconds) {
+  if (id >= kMaxFunctions) {
+    return;
+  }
+  Counter& counter = thread_counters_holder.get()->counters[id];
+  counter.calls.store(counter.calls.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+  counter.total_nanoseconds.store(
+      counter.total_nanoseconds.load(std::memory_order_relaxed) + nanoseconds,
+      std::memory_order_relaxed);
+  if (nanoseconds > counter.max_nanoseconds.load(std::memory_order_relaxed)) {
+    counter.max_nanoseconds.store(nanoseconds, std::memory_order_relaxed);
+  }
+}
+}  // namespace internal
+
+}  // namespace call_stats
+}  // namespace vulkan
@@ -0,0 +1,96 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_WRAPPER_CALL_STATS_H_
+#define VULKAN_WRAPPER_CALL_STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "support/containers/allocator.h"
+#include "support/log/log.h"
+
+// Counts the calls that are made through the function tables, and measures
+// the host time that each Vulkan function takes. Calls are only timed in
+// builds with VULKAN_CALL_PROFILING defined, and only while recording.
+// Every thread counts its own calls, so recording a call is two clock reads
+// and a few stores, and never waits on another thread.
+namespace vulkan {
+namespace call_stats {
+
+// The most functions that are counted, the calls to functions that are
+// registered past this are not recorded.
+const uint32_t kMaxFunctions = 2048;
+
+// Returns the id that the calls to function_name are counted under. The
+// same name always gets the same id. Functions are registered when they are
+// resolved, rather than when they are called.
+uint32_t Register(const char* function_name);
+
+// Starts and stops recording calls. The counts are kept while not
+// recording.
+void Start();
+void Stop();
+
+// Forgets every call recorded so far. Calls that are in flight on other
+// threads may still be counted partially.
+void Reset();
+
+// Logs a table of the functions that were called, with the number of calls
+// and the total, mean and maximum time of each, sorted by total time. This
+// can be called at any time, the calls of other threads are counted up to
+// about when it is called.
+void Log(containers::Allocator* allocator, logging::Logger* log);
+
+namespace internal {
+extern std::atomic<bool> recording;
+void Record(uint32_t id, uint64_t nanoseconds);
+}  // namespace internal
+
+// Records the time from its construction to its destruction as a call to
+// the function with the given id, if calls are being recorded.
+class CallTimer {
+ public:
+  explicit CallTimer(uint32_t id)
+      : id_(id),
+        recording_(internal::recording.load(std::memory_order_relaxed)) {
+    if (recording_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~CallTimer() {
+    if (recording_) {
+      const auto duration = std::chrono::steady_clock::now() - start_;
+      internal::Record(
+          id_, std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+                   .count());
+    }
+  }
+
+  CallTimer(const CallTimer&) = delete;
+  CallTimer& operator=(const CallTimer&) = delete;
+
+ private:
+  uint32_t id_;
+  bool recording_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace call_stats
+}  // namespace vulkan
+
+#endif  // VULKAN_WRAPPER_CALL_STATS_H_
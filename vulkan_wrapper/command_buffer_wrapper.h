@@ -26,9 +26,9 @@
 namespace vulkan {
 
 // VkCommandBuffer takes the ownership and wraps a native VkCommandBuffer
-// object. It provides lazily initialized function pointers for all of its
-// methods. It will automatically call VkFreeCommandBuffers when it goes out of
-// scope.
+// object. It provides the function pointers for all of its methods, which
+// are resolved along with the device. It will automatically call
+// VkFreeCommandBuffers when it goes out of scope.
 class VkCommandBuffer {
  public:
   VkCommandBuffer(VkCommandBuffer&& other)
@@ -85,7 +85,7 @@ class VkCommandBuffer {
   ::VkCommandPool pool_;
   ::VkDevice device_;
   logging::Logger* log_;
-  LazyFunction<PFN_vkFreeCommandBuffers, ::VkDevice, DeviceFunctions>*
+  EagerFunction<PFN_vkFreeCommandBuffers, ::VkDevice, DeviceFunctions>*
       destruction_function_;
   CommandBufferFunctions* functions_;
   uint32_t device_mask_ = 0;
@@ -60,7 +60,7 @@ class VkDescriptorSet {
   ::VkDescriptorPool pool_;
   ::VkDevice device_;
   logging::Logger* log_;
-  LazyFunction<PFN_vkFreeDescriptorSets, ::VkDevice, DeviceFunctions>*
+  EagerFunction<PFN_vkFreeDescriptorSets, ::VkDevice, DeviceFunctions>*
       destruction_function_;
 
  public:
@@ -30,8 +30,8 @@
 namespace vulkan {
 
 // VkDevice wraps a native vulkan VkDevice handle. It provides
-// lazily initialized function pointers for all of its
-// methods. It will automatically call VkDestroyDevice when it
+// function pointers for all of its methods, which are resolved when it is
+// created. It will automatically call VkDestroyDevice when it
 // goes out of scope.
 class VkDevice {
  public:
@@ -40,11 +40,14 @@ class VkDevice {
   // VkAllocationCallbacks object, it does take ownership of the device.
   // If properties is not nullptr, then the device_id, vendor_id and
   // driver_version will be copied out of it.
+  // enabled_extensions should be the extensions the device was created
+  // with, only their functions are resolved.
   VkDevice(containers::Allocator* container_allocator, ::VkDevice device,
            VkAllocationCallbacks* allocator, VkInstance* instance,
            VkPhysicalDeviceProperties* properties = nullptr,
            ::VkPhysicalDevice physical_device = VK_NULL_HANDLE,
-           uint32_t num_devices = 1)
+           uint32_t num_devices = 1, uint32_t num_enabled_extensions = 0,
+           const char* const* enabled_extensions = nullptr)
       : device_(device),
         physical_device_(physical_device),
         has_allocator_(allocator != nullptr),
@@ -68,9 +71,10 @@ class VkDevice {
       vendor_id_ = properties->vendorID;
       driver_version_ = properties->driverVersion;
     }
-    // Initialize the lazily resolved device functions.
+    // Resolve the device functions.
     functions_ = containers::make_unique<DeviceFunctions>(
-        container_allocator, device_, vkGetDeviceProcAddr, log_);
+        container_allocator, device_, vkGetDeviceProcAddr, log_,
+        instance->functions(), num_enabled_extensions, enabled_extensions);
     if (physical_device) {
       (*instance)->vkGetPhysicalDeviceMemoryProperties(
           physical_device, &physical_device_memory_properties_);
@@ -115,7 +119,7 @@ class VkDevice {
   VkAllocationCallbacks allocator_;
   logging::Logger* log_;
   PFN_vkGetDeviceProcAddr vkGetDeviceProcAddr;
-  // Lazily resolved Vulkan device functions.
+  // The resolved Vulkan device functions.
   containers::unique_ptr<DeviceFunctions> functions_;
 
   uint32_t device_id_;
@@ -131,7 +135,7 @@ class VkDevice {
   ::VkDevice get_device() const { return device_; }
   operator ::VkDevice() const { return device_; }
 
-  // Override operators to access the lazily resolved functions stored in
+  // Override operators to access the resolved functions stored in
   // functions_;
   DeviceFunctions* operator->() { return functions_.get(); }
   DeviceFunctions& operator*() { return *functions_.get(); }
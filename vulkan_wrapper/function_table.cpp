@@ -0,0 +1,98 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_wrapper/function_table.h"
+
+#include <cstring>
+
+namespace vulkan {
+namespace {
+bool IsEnabled(const char* extension, uint32_t num_enabled_extensions,
+               const char* const* enabled_extensions) {
+  for (uint32_t i = 0; i < num_enabled_extensions; ++i) {
+    if (strcmp(extension, enabled_extensions[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // anonymous namespace
+
+InstanceFunctions::InstanceFunctions(
+    containers::Allocator* allocator, ::VkInstance instance,
+    PFN_vkGetInstanceProcAddr get_proc_addr_func, logging::Logger* log,
+    uint32_t num_enabled_extensions, const char* const* enabled_extensions)
+    : log_(log),
+      vkGetInstanceProcAddr_(get_proc_addr_func),
+      enabled_extensions_(allocator) {
+  for (uint32_t i = 0; i < num_enabled_extensions; ++i) {
+    const char* extension = enabled_extensions[i];
+    enabled_extensions_.insert(enabled_extensions_.end(), extension,
+                               extension + strlen(extension) + 1);
+  }
+  if (instance == VK_NULL_HANDLE) {
+    return;
+  }
+
+#define RESOLVE_FUNCTION(function) function.Resolve(instance, #function, this)
+#define EXTENSION_ENABLED(extension) \
+  IsEnabled(extension, num_enabled_extensions, enabled_extensions)
+#define VULKAN_RESOLVE_INSTANCE_FUNCTIONS
+#include "vulkan_wrapper/function_tables.inc"
+#undef RESOLVE_FUNCTION
+#undef EXTENSION_ENABLED
+}
+
+bool InstanceFunctions::IsExtensionEnabled(const char* extension) const {
+  for (size_t i = 0; i < enabled_extensions_.size();
+       i += strlen(&enabled_extensions_[i]) + 1) {
+    if (strcmp(extension, &enabled_extensions_[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+DeviceFunctions::DeviceFunctions(::VkDevice device,
+                                 PFN_vkGetDeviceProcAddr get_proc_addr_func,
+                                 logging::Logger* log,
+                                 const InstanceFunctions* instance_functions,
+                                 uint32_t num_enabled_extensions,
+                                 const char* const* enabled_extensions)
+    : log_(log), vkGetDeviceProcAddr_(get_proc_addr_func) {
+  if (device == VK_NULL_HANDLE) {
+    return;
+  }
+
+#define RESOLVE_DEVICE_FUNCTION(function) \
+  function.Resolve(device, #function, this)
+#define RESOLVE_COMMAND_BUFFER_FUNCTION(function) \
+  command_buffer_functions_.function.Resolve(device, #function, this)
+#define RESOLVE_QUEUE_FUNCTION(function) \
+  queue_functions_.function.Resolve(device, #function, this)
+#define DEVICE_EXTENSION_ENABLED(extension) \
+  IsEnabled(extension, num_enabled_extensions, enabled_extensions)
+#define INSTANCE_EXTENSION_ENABLED(extension) \
+  instance_functions->IsExtensionEnabled(extension)
+#define VULKAN_RESOLVE_DEVICE_FUNCTIONS
+#include "vulkan_wrapper/function_tables.inc"
+#undef RESOLVE_DEVICE_FUNCTION
+#undef RESOLVE_COMMAND_BUFFER_FUNCTION
+#undef RESOLVE_QUEUE_FUNCTION
+#undef DEVICE_EXTENSION_ENABLED
+#undef INSTANCE_EXTENSION_ENABLED
+}
+
+}  // namespace vulkan
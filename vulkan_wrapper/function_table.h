@@ -16,20 +16,33 @@
 #ifndef VULKAN_WRAPPER_FUNCTION_TABLE_H_
 #define VULKAN_WRAPPER_FUNCTION_TABLE_H_
 
+#include <cstdint>
+
+#include "support/containers/allocator.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+
+#include "vulkan_helpers/vulkan_header_wrapper.h"
 #include "vulkan_wrapper/lazy_function.h"
 
+// The members of the tables are generated from vk.xml at build time, by
+// tools/generate_function_tables.py. Every function of the registry has a
+// member, and the functions of each extension are declared together.
+
 namespace vulkan {
 
 class InstanceFunctions;
 template <typename T>
-using LazyInstanceFunction = LazyFunction<T, ::VkInstance, InstanceFunctions>;
-
-// InstanceFunctions contains a list of lazily resolved Vulkan instance
-// functions. All the lazily resolved functions are implemented through
-// LazyFunction template, GetLogger() and getProcAddr() methods are required to
-// conform the LazyFunction template. As this class is the source of lazily
-// resolved Vulkan functions, the instance of this class is non-movable and
-// non-copyable.
+using EagerInstanceFunction = EagerFunction<T, ::VkInstance, InstanceFunctions>;
+
+// InstanceFunctions contains the Vulkan instance functions. The core
+// functions, the functions of the enabled instance extensions and the
+// physical device functions of all device extensions are resolved when this
+// is constructed. The functions of the instance extensions that were not
+// enabled are never resolved. GetLogger() and getProcAddr() methods are
+// required to conform the EagerFunction template. As this class is the source
+// of the resolved Vulkan functions, the instance of this class is non-movable
+// and non-copyable.
 class InstanceFunctions {
  public:
   InstanceFunctions(const InstanceFunctions& other) = delete;
@@ -37,360 +50,69 @@ class InstanceFunctions {
   InstanceFunctions& operator=(const InstanceFunctions& other) = delete;
   InstanceFunctions& operator=(InstanceFunctions&& other) = delete;
 
-  InstanceFunctions(::VkInstance instance,
+  // enabled_extensions are the names of the extensions the instance was
+  // created with, they are copied so that devices can check them later.
+  // Nothing is resolved if instance is VK_NULL_HANDLE.
+  InstanceFunctions(containers::Allocator* allocator, ::VkInstance instance,
                     PFN_vkGetInstanceProcAddr get_proc_addr_func,
-                    logging::Logger* log)
-      : log_(log),
-        vkGetInstanceProcAddr_(get_proc_addr_func),
-#define CONSTRUCT_LAZY_FUNCTION(function) function(instance, #function, this)
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyInstance),
-        CONSTRUCT_LAZY_FUNCTION(vkEnumeratePhysicalDevices),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateDevice),
-        CONSTRUCT_LAZY_FUNCTION(vkEnumerateDeviceExtensionProperties),
-        CONSTRUCT_LAZY_FUNCTION(vkEnumerateDeviceLayerProperties),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceCalibrateableTimeDomainsEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceFeatures),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceFeatures2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceMemoryProperties),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceMemoryProperties2),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceProperties),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceProperties2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceFormatProperties),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceFormatProperties2),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceImageFormatProperties),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceImageFormatProperties2),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceMultisamplePropertiesEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceSparseImageFormatProperties),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroySurfaceKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceSurfaceSupportKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceSurfaceCapabilitiesKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceSurfaceFormatsKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceSurfaceFormats2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceSurfacePresentModesKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPastPresentationTimingGOOGLE),
-        CONSTRUCT_LAZY_FUNCTION(vkGetRefreshCycleDurationGOOGLE),
-        CONSTRUCT_LAZY_FUNCTION(vkEnumeratePhysicalDeviceGroups),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateDebugUtilsMessengerEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyDebugUtilsMessengerEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkSubmitDebugUtilsMessageEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceDisplayProperties2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceDisplayPlaneProperties2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetDisplayModeProperties2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetDisplayPlaneCapabilities2KHR)
-#if defined __ANDROID__
-        ,
-        CONSTRUCT_LAZY_FUNCTION(vkCreateAndroidSurfaceKHR)
-#elif defined __ggp__
-        ,
-        CONSTRUCT_LAZY_FUNCTION(vkCreateStreamDescriptorSurfaceGGP)
-#elif defined __linux__
-        ,
-        CONSTRUCT_LAZY_FUNCTION(vkCreateXcbSurfaceKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceXcbPresentationSupportKHR)
-#elif defined _WIN32
-        ,
-        CONSTRUCT_LAZY_FUNCTION(vkCreateWin32SurfaceKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceWin32PresentationSupportKHR)
-#elif defined __APPLE__
-        ,
-        CONSTRUCT_LAZY_FUNCTION(vkCreateMacOSSurfaceMVK)
-#endif
-#undef CONSTRUCT_LAZY_FUNCTION
-  {
-  }
+                    logging::Logger* log, uint32_t num_enabled_extensions,
+                    const char* const* enabled_extensions);
 
  private:
   logging::Logger* log_;
   // The function pointer to Vulkan vkGetInstanceProcAddr().
   PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr_;
+  // The names of the enabled extensions, each one followed by a '\0'.
+  containers::vector<char> enabled_extensions_;
 
  public:
-  // Returns the logger. This is required to conform LazyFunction template.
+  // Returns the logger. This is required to conform EagerFunction template.
   logging::Logger* GetLogger() { return log_; }
   // Resolves an instance function with the given name. This is required to
-  // conform LazyFunction template.
+  // conform EagerFunction template.
   PFN_vkVoidFunction getProcAddr(::VkInstance instance, const char* function) {
     return vkGetInstanceProcAddr_(instance, function);
   }
+  // Returns true if the instance was created with the given extension.
+  bool IsExtensionEnabled(const char* extension) const;
 
-#define LAZY_FUNCTION(function) LazyInstanceFunction<PFN_##function> function;
-  LAZY_FUNCTION(vkDestroyInstance);
-  LAZY_FUNCTION(vkEnumeratePhysicalDevices);
-  LAZY_FUNCTION(vkCreateDevice);
-  LAZY_FUNCTION(vkEnumerateDeviceExtensionProperties);
-  LAZY_FUNCTION(vkEnumerateDeviceLayerProperties);
-  LAZY_FUNCTION(vkGetPhysicalDeviceCalibrateableTimeDomainsEXT);
-  LAZY_FUNCTION(vkGetPhysicalDeviceFeatures);
-  LAZY_FUNCTION(vkGetPhysicalDeviceFeatures2KHR);
-  LAZY_FUNCTION(vkGetPhysicalDeviceMemoryProperties);
-  LAZY_FUNCTION(vkGetPhysicalDeviceMemoryProperties2);
-  LAZY_FUNCTION(vkGetPhysicalDeviceProperties);
-  LAZY_FUNCTION(vkGetPhysicalDeviceProperties2KHR);
-  LAZY_FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties);
-  LAZY_FUNCTION(vkGetPhysicalDeviceFormatProperties);
-  LAZY_FUNCTION(vkGetPhysicalDeviceFormatProperties2);
-  LAZY_FUNCTION(vkGetPhysicalDeviceImageFormatProperties);
-  LAZY_FUNCTION(vkGetPhysicalDeviceImageFormatProperties2);
-  LAZY_FUNCTION(vkGetPhysicalDeviceMultisamplePropertiesEXT);
-  LAZY_FUNCTION(vkGetPhysicalDeviceSparseImageFormatProperties);
-  LAZY_FUNCTION(vkDestroySurfaceKHR);
-  LAZY_FUNCTION(vkGetPhysicalDeviceSurfaceSupportKHR);
-  LAZY_FUNCTION(vkGetPhysicalDeviceSurfaceCapabilitiesKHR);
-  LAZY_FUNCTION(vkGetPhysicalDeviceSurfaceFormatsKHR);
-  LAZY_FUNCTION(vkGetPhysicalDeviceSurfaceFormats2KHR);
-  LAZY_FUNCTION(vkGetPhysicalDeviceSurfacePresentModesKHR);
-  LAZY_FUNCTION(vkGetPastPresentationTimingGOOGLE);
-  LAZY_FUNCTION(vkGetRefreshCycleDurationGOOGLE);
-  LAZY_FUNCTION(vkEnumeratePhysicalDeviceGroups);
-  LAZY_FUNCTION(vkCreateDebugUtilsMessengerEXT);
-  LAZY_FUNCTION(vkDestroyDebugUtilsMessengerEXT);
-  LAZY_FUNCTION(vkSubmitDebugUtilsMessageEXT);
-  LAZY_FUNCTION(vkGetPhysicalDeviceDisplayProperties2KHR);
-  LAZY_FUNCTION(vkGetPhysicalDeviceDisplayPlaneProperties2KHR);
-  LAZY_FUNCTION(vkGetDisplayModeProperties2KHR);
-  LAZY_FUNCTION(vkGetDisplayPlaneCapabilities2KHR);
-#if defined __ANDROID__
-  LAZY_FUNCTION(vkCreateAndroidSurfaceKHR);
-#elif defined __ggp__
-  LAZY_FUNCTION(vkCreateStreamDescriptorSurfaceGGP);
-#elif defined __linux__
-  LAZY_FUNCTION(vkCreateXcbSurfaceKHR);
-  LAZY_FUNCTION(vkGetPhysicalDeviceXcbPresentationSupportKHR);
-#elif defined _WIN32
-  LAZY_FUNCTION(vkCreateWin32SurfaceKHR);
-  LAZY_FUNCTION(vkGetPhysicalDeviceWin32PresentationSupportKHR);
-#elif defined __APPLE__
-  LAZY_FUNCTION(vkCreateMacOSSurfaceMVK);
-#endif
-#undef LAZY_FUNCTION
+#define FUNCTION(function) EagerInstanceFunction<PFN_##function> function;
+#define VULKAN_INSTANCE_FUNCTIONS
+#include "vulkan_wrapper/function_tables.inc"
+#undef FUNCTION
 };
 
 class DeviceFunctions;
 template <typename T>
-using LazyDeviceFunction = LazyFunction<T, ::VkDevice, DeviceFunctions>;
+using EagerDeviceFunction = EagerFunction<T, ::VkDevice, DeviceFunctions>;
 
-// CommandBufferFunctions stores a list of lazily resolved Vulkan Command
-// buffer functions. The instance of this class should be owned and the
-// functions listed inside should be resolved by DeviceFunctions. This class
-// does not need to conform LazyFunction template as no function is resolved
-// through it.
+// CommandBufferFunctions stores the Vulkan command buffer functions. The
+// instance of this class should be owned and the functions listed inside
+// should be resolved by DeviceFunctions. This class does not need to conform
+// EagerFunction template as no function is resolved through it.
 struct CommandBufferFunctions {
- public:
-  CommandBufferFunctions(::VkDevice device, DeviceFunctions* device_functions)
-      :
-#define CONSTRUCT_LAZY_FUNCTION(function) \
-  function(device, #function, device_functions)
-        CONSTRUCT_LAZY_FUNCTION(vkBeginCommandBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkEndCommandBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkResetCommandBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdPipelineBarrier),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdPipelineBarrier2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdCopyBufferToImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdCopyImageToBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginRenderPass),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndRenderPass),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdNextSubpass),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginConditionalRenderingEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndConditionalRenderingEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginTransformFeedbackEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndTransformFeedbackEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindPipeline),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetLineWidth),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetBlendConstants),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthBias),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthBounds),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetScissor),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilCompareMask),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilReference),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilWriteMask),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetViewport),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdCopyBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindDescriptorSets),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindVertexBuffers),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindTransformFeedbackBuffersEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdClearColorImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdClearDepthStencilImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindIndexBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDraw),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndexed),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndirect),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndexedIndirect),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDispatch),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDispatchIndirect),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBlitImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdPushConstants),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdExecuteCommands),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdResolveImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdCopyImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdClearAttachments),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdUpdateBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdFillBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdResetQueryPool),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginQuery),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndQuery),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdCopyQueryPoolResults),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdWriteTimestamp),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdWriteTimestamp2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetEvent),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdResetEvent),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdWaitEvents),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdWaitEvents2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDeviceMask),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndexedIndirectCountKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginDebugUtilsLabelEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndDebugUtilsLabelEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdInsertDebugUtilsLabelEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdPushDescriptorSetKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindVertexBuffers2EXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetCullModeEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthBoundsTestEnableEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthBiasEnableEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthCompareOpEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthTestEnableEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthWriteEnableEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetFrontFaceEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetLogicOpEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetPatchControlPointsEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetPrimitiveTopologyEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetPrimitiveRestartEnableEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetRasterizerDiscardEnableEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetScissorWithCountEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilOpEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilTestEnableEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetViewportWithCountEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginRenderingKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndRenderingKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginRendering),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndRendering)
-#undef CONSTRUCT_LAZY_FUNCTION
-  {
-  }
-
- public:
-#define LAZY_FUNCTION(function) LazyDeviceFunction<PFN_##function> function;
-  LAZY_FUNCTION(vkBeginCommandBuffer);
-  LAZY_FUNCTION(vkEndCommandBuffer);
-  LAZY_FUNCTION(vkResetCommandBuffer);
-  LAZY_FUNCTION(vkCmdPipelineBarrier);
-  LAZY_FUNCTION(vkCmdPipelineBarrier2KHR);
-  LAZY_FUNCTION(vkCmdCopyBufferToImage);
-  LAZY_FUNCTION(vkCmdCopyImageToBuffer);
-  LAZY_FUNCTION(vkCmdBeginRenderPass);
-  LAZY_FUNCTION(vkCmdEndRenderPass);
-  LAZY_FUNCTION(vkCmdNextSubpass);
-  LAZY_FUNCTION(vkCmdBeginConditionalRenderingEXT);
-  LAZY_FUNCTION(vkCmdEndConditionalRenderingEXT);
-  LAZY_FUNCTION(vkCmdBeginTransformFeedbackEXT);
-  LAZY_FUNCTION(vkCmdEndTransformFeedbackEXT);
-  LAZY_FUNCTION(vkCmdBindPipeline);
-  LAZY_FUNCTION(vkCmdSetLineWidth);
-  LAZY_FUNCTION(vkCmdSetBlendConstants);
-  LAZY_FUNCTION(vkCmdSetDepthBias);
-  LAZY_FUNCTION(vkCmdSetDepthBounds);
-  LAZY_FUNCTION(vkCmdSetScissor);
-  LAZY_FUNCTION(vkCmdSetStencilCompareMask);
-  LAZY_FUNCTION(vkCmdSetStencilReference);
-  LAZY_FUNCTION(vkCmdSetStencilWriteMask);
-  LAZY_FUNCTION(vkCmdSetViewport);
-  LAZY_FUNCTION(vkCmdCopyBuffer);
-  LAZY_FUNCTION(vkCmdBindDescriptorSets);
-  LAZY_FUNCTION(vkCmdBindVertexBuffers);
-  LAZY_FUNCTION(vkCmdBindTransformFeedbackBuffersEXT);
-  LAZY_FUNCTION(vkCmdClearColorImage);
-  LAZY_FUNCTION(vkCmdClearDepthStencilImage);
-  LAZY_FUNCTION(vkCmdBindIndexBuffer);
-  LAZY_FUNCTION(vkCmdDraw);
-  LAZY_FUNCTION(vkCmdDrawIndexed);
-  LAZY_FUNCTION(vkCmdDrawIndirect);
-  LAZY_FUNCTION(vkCmdDrawIndexedIndirect);
-  LAZY_FUNCTION(vkCmdDispatch);
-  LAZY_FUNCTION(vkCmdDispatchIndirect);
-  LAZY_FUNCTION(vkCmdBlitImage);
-  LAZY_FUNCTION(vkCmdPushConstants);
-  LAZY_FUNCTION(vkCmdExecuteCommands);
-  LAZY_FUNCTION(vkCmdResolveImage);
-  LAZY_FUNCTION(vkCmdCopyImage);
-  LAZY_FUNCTION(vkCmdClearAttachments);
-  LAZY_FUNCTION(vkCmdUpdateBuffer);
-  LAZY_FUNCTION(vkCmdFillBuffer);
-  LAZY_FUNCTION(vkCmdResetQueryPool);
-  LAZY_FUNCTION(vkCmdBeginQuery);
-  LAZY_FUNCTION(vkCmdEndQuery);
-  LAZY_FUNCTION(vkCmdCopyQueryPoolResults);
-  LAZY_FUNCTION(vkCmdWriteTimestamp);
-  LAZY_FUNCTION(vkCmdWriteTimestamp2KHR);
-  LAZY_FUNCTION(vkCmdSetEvent);
-  LAZY_FUNCTION(vkCmdResetEvent);
-  LAZY_FUNCTION(vkCmdWaitEvents);
-  LAZY_FUNCTION(vkCmdWaitEvents2KHR);
-  LAZY_FUNCTION(vkCmdSetDeviceMask);
-  LAZY_FUNCTION(vkCmdDrawIndexedIndirectCountKHR);
-  LAZY_FUNCTION(vkCmdBeginDebugUtilsLabelEXT);
-  LAZY_FUNCTION(vkCmdEndDebugUtilsLabelEXT);
-  LAZY_FUNCTION(vkCmdInsertDebugUtilsLabelEXT);
-  LAZY_FUNCTION(vkCmdPushDescriptorSetKHR);
-  LAZY_FUNCTION(vkCmdBindVertexBuffers2EXT);
-  LAZY_FUNCTION(vkCmdSetCullModeEXT);
-  LAZY_FUNCTION(vkCmdSetDepthBiasEnableEXT);
-  LAZY_FUNCTION(vkCmdSetDepthBoundsTestEnableEXT);
-  LAZY_FUNCTION(vkCmdSetDepthCompareOpEXT);
-  LAZY_FUNCTION(vkCmdSetDepthTestEnableEXT);
-  LAZY_FUNCTION(vkCmdSetDepthWriteEnableEXT);
-  LAZY_FUNCTION(vkCmdSetFrontFaceEXT);
-  LAZY_FUNCTION(vkCmdSetLogicOpEXT);
-  LAZY_FUNCTION(vkCmdSetPatchControlPointsEXT);
-  LAZY_FUNCTION(vkCmdSetPrimitiveTopologyEXT);
-  LAZY_FUNCTION(vkCmdSetPrimitiveRestartEnableEXT)
-  LAZY_FUNCTION(vkCmdSetRasterizerDiscardEnableEXT)
-  LAZY_FUNCTION(vkCmdSetScissorWithCountEXT);
-  LAZY_FUNCTION(vkCmdSetStencilOpEXT);
-  LAZY_FUNCTION(vkCmdSetStencilTestEnableEXT);
-  LAZY_FUNCTION(vkCmdSetViewportWithCountEXT);
-  LAZY_FUNCTION(vkCmdBeginRenderingKHR);
-  LAZY_FUNCTION(vkCmdEndRenderingKHR);
-  LAZY_FUNCTION(vkCmdBeginRendering);
-  LAZY_FUNCTION(vkCmdEndRendering);
-#undef LAZY_FUNCTION
+#define FUNCTION(function) EagerDeviceFunction<PFN_##function> function;
+#define VULKAN_COMMAND_BUFFER_FUNCTIONS
+#include "vulkan_wrapper/function_tables.inc"
+#undef FUNCTION
 };
 
+// QueueFunctions stores the Vulkan queue functions, like
+// CommandBufferFunctions.
 struct QueueFunctions {
- public:
-  QueueFunctions(::VkDevice device, DeviceFunctions* device_functions)
-      :
-#define CONSTRUCT_LAZY_FUNCTION(function) \
-  function(device, #function, device_functions)
-        CONSTRUCT_LAZY_FUNCTION(vkQueueSubmit),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueSubmit2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueWaitIdle),
-        CONSTRUCT_LAZY_FUNCTION(vkQueuePresentKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueBindSparse),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueBeginDebugUtilsLabelEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueEndDebugUtilsLabelEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueInsertDebugUtilsLabelEXT)
-#undef CONSTRUCT_LAZY_FUNCTION
-  {
-  }
-
- public:
-#define LAZY_FUNCTION(function) LazyDeviceFunction<PFN_##function> function;
-  LAZY_FUNCTION(vkQueueSubmit);
-  LAZY_FUNCTION(vkQueueSubmit2KHR);
-  LAZY_FUNCTION(vkQueueWaitIdle);
-  LAZY_FUNCTION(vkQueuePresentKHR);
-  LAZY_FUNCTION(vkQueueBindSparse);
-  LAZY_FUNCTION(vkQueueBeginDebugUtilsLabelEXT);
-  LAZY_FUNCTION(vkQueueEndDebugUtilsLabelEXT);
-  LAZY_FUNCTION(vkQueueInsertDebugUtilsLabelEXT);
-#undef LAZY_FUNCTION
+#define FUNCTION(function) EagerDeviceFunction<PFN_##function> function;
+#define VULKAN_QUEUE_FUNCTIONS
+#include "vulkan_wrapper/function_tables.inc"
+#undef FUNCTION
 };
 
-// DeviceFunctions contains a list of lazily resolved Vulkan device functions
-// and the functions of sub-device objects.All the lazily resolved functions
-// are implemented through LazyFunction template, GetLogger() and getProcAddr()
-// methods are required to conform the LazyFunction template. As this class is
-// the source of lazily resolved Vulkan functions, the instance of this class
-// is non-movable and non-copyable.
+// DeviceFunctions contains the Vulkan device functions and the functions of
+// sub-device objects. The core functions and the functions of the enabled
+// extensions are resolved when this is constructed, the functions of the
+// other extensions are never resolved. GetLogger() and getProcAddr() methods
+// are required to conform the EagerFunction template. As this class is the
+// source of the resolved Vulkan functions, the instance of this class is
+// non-movable and non-copyable.
 class DeviceFunctions {
  public:
   DeviceFunctions(const DeviceFunctions& other) = delete;
@@ -398,131 +120,15 @@ class DeviceFunctions {
   DeviceFunctions& operator=(const DeviceFunctions& other) = delete;
   DeviceFunctions& operator=(DeviceFunctions&& other) = delete;
 
+  // enabled_extensions are the names of the extensions the device was
+  // created with, they are not retained. The functions that instance
+  // extensions add to devices are resolved if they are enabled in
+  // instance_functions. Nothing is resolved if device is VK_NULL_HANDLE.
   DeviceFunctions(::VkDevice device, PFN_vkGetDeviceProcAddr get_proc_addr_func,
-                  logging::Logger* log)
-      : log_(log),
-        vkGetDeviceProcAddr_(get_proc_addr_func),
-        command_buffer_functions_(device, this),
-        queue_functions_(device, this),
-#define CONSTRUCT_LAZY_FUNCTION(function) function(device, #function, this)
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyDevice),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateCommandPool),
-        CONSTRUCT_LAZY_FUNCTION(vkTrimCommandPool),
-        CONSTRUCT_LAZY_FUNCTION(vkResetCommandPool),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyCommandPool),
-        CONSTRUCT_LAZY_FUNCTION(vkAllocateCommandBuffers),
-        CONSTRUCT_LAZY_FUNCTION(vkFreeCommandBuffers),
-        CONSTRUCT_LAZY_FUNCTION(vkGetDeviceQueue),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateSemaphore),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroySemaphore),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateImage),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateSwapchainKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroySwapchainKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetSwapchainImagesKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetCalibratedTimestampsEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkGetImageMemoryRequirements),
-        CONSTRUCT_LAZY_FUNCTION(vkGetImageSparseMemoryRequirements),
-        CONSTRUCT_LAZY_FUNCTION(vkGetImageMemoryRequirements2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetImageSubresourceLayout),
-        CONSTRUCT_LAZY_FUNCTION(vkGetMemoryHostPointerPropertiesEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateImageView),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyImageView),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateRenderPass),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateRenderPass2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyRenderPass),
-        CONSTRUCT_LAZY_FUNCTION(vkCreatePipelineCache),
-        CONSTRUCT_LAZY_FUNCTION(vkMergePipelineCaches),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPipelineCacheData),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyPipelineCache),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateFramebuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyFramebuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkAllocateMemory),
-        CONSTRUCT_LAZY_FUNCTION(vkFreeMemory),
-        CONSTRUCT_LAZY_FUNCTION(vkBindImageMemory),
-        CONSTRUCT_LAZY_FUNCTION(vkBindImageMemory2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateShaderModule),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyShaderModule),
-        CONSTRUCT_LAZY_FUNCTION(vkGetShaderInfoAMD),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateSampler),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateSamplerYcbcrConversionKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroySampler),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateBufferView),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyBufferView),
-        CONSTRUCT_LAZY_FUNCTION(vkGetBufferMemoryRequirements),
-        CONSTRUCT_LAZY_FUNCTION(vkMapMemory),
-        CONSTRUCT_LAZY_FUNCTION(vkUnmapMemory),
-        CONSTRUCT_LAZY_FUNCTION(vkBindBufferMemory),
-        CONSTRUCT_LAZY_FUNCTION(vkBindBufferMemory2),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateDescriptorPool),
-        CONSTRUCT_LAZY_FUNCTION(vkResetDescriptorPool),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyDescriptorPool),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateDescriptorSetLayout),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyDescriptorSetLayout),
-        CONSTRUCT_LAZY_FUNCTION(vkFlushMappedMemoryRanges),
-        CONSTRUCT_LAZY_FUNCTION(vkInvalidateMappedMemoryRanges),
-        CONSTRUCT_LAZY_FUNCTION(vkCreatePipelineLayout),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyPipelineLayout),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateGraphicsPipelines),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateComputePipelines),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyPipeline),
-        CONSTRUCT_LAZY_FUNCTION(vkAllocateDescriptorSets),
-        CONSTRUCT_LAZY_FUNCTION(vkUpdateDescriptorSets),
-        CONSTRUCT_LAZY_FUNCTION(vkFreeDescriptorSets),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateFence),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyFence),
-        CONSTRUCT_LAZY_FUNCTION(vkResetFences),
-        CONSTRUCT_LAZY_FUNCTION(vkWaitForFences),
-        CONSTRUCT_LAZY_FUNCTION(vkGetFenceStatus),
-        CONSTRUCT_LAZY_FUNCTION(vkAcquireNextImageKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkAcquireNextImage2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkDeviceWaitIdle),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateQueryPool),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyQueryPool),
-        CONSTRUCT_LAZY_FUNCTION(vkGetQueryPoolResults),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateEvent),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyEvent),
-        CONSTRUCT_LAZY_FUNCTION(vkGetEventStatus),
-        CONSTRUCT_LAZY_FUNCTION(vkSetEvent),
-        CONSTRUCT_LAZY_FUNCTION(vkResetEvent),
-        CONSTRUCT_LAZY_FUNCTION(vkGetRenderAreaGranularity),
-        CONSTRUCT_LAZY_FUNCTION(vkGetDeviceGroupPeerMemoryFeatures),
-        CONSTRUCT_LAZY_FUNCTION(vkSetDebugUtilsObjectNameEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkSetDebugUtilsObjectTagEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCreateDescriptorUpdateTemplateKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyDescriptorUpdateTemplateKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkUpdateDescriptorSetWithTemplateKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkResetQueryPoolEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPipelineExecutablePropertiesKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPipelineExecutableStatisticsKHR),
-        CONSTRUCT_LAZY_FUNCTION(
-            vkGetPipelineExecutableInternalRepresentationsKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkSetHdrMetadataEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkWaitSemaphoresKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkSignalSemaphoreKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetBufferDeviceAddressKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetBufferOpaqueCaptureAddressKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetDeviceMemoryOpaqueCaptureAddressKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCreatePrivateDataSlotEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkDestroyPrivateDataSlotEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkGetPrivateDataEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkSetPrivateDataEXT)
-#if defined _WIN32
-        ,
-        CONSTRUCT_LAZY_FUNCTION(vkGetMemoryWin32HandleKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetFenceWin32HandleKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkImportFenceWin32HandleKHR)
-#elif __linux__
-        ,
-        CONSTRUCT_LAZY_FUNCTION(vkGetMemoryFdKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetFenceFdKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkImportFenceFdKHR)
-#endif
-#undef CONSTRUCT_LAZY_FUNCTION
-  {
-  }
+                  logging::Logger* log,
+                  const InstanceFunctions* instance_functions,
+                  uint32_t num_enabled_extensions,
+                  const char* const* enabled_extensions);
 
  private:
   logging::Logger* log_;
@@ -533,10 +139,10 @@ class DeviceFunctions {
   QueueFunctions queue_functions_;
 
  public:
-  // Returns the logger. This is required to conform LazyFunction template.
+  // Returns the logger. This is required to conform EagerFunction template.
   logging::Logger* GetLogger() { return log_; }
   // Resolves a device function with the given name. This is required to
-  // conform LazyFunction template.
+  // conform EagerFunction template.
   PFN_vkVoidFunction getProcAddr(::VkDevice device, const char* function) {
     return vkGetDeviceProcAddr_(device, function);
   }
@@ -546,120 +152,10 @@ class DeviceFunctions {
   }
   QueueFunctions* queue_functions() { return &queue_functions_; }
 
-#define LAZY_FUNCTION(function) LazyDeviceFunction<PFN_##function> function;
-  LAZY_FUNCTION(vkDestroyDevice);
-  LAZY_FUNCTION(vkCreateCommandPool);
-  LAZY_FUNCTION(vkTrimCommandPool);
-  LAZY_FUNCTION(vkResetCommandPool);
-  LAZY_FUNCTION(vkDestroyCommandPool);
-  LAZY_FUNCTION(vkAllocateCommandBuffers);
-  LAZY_FUNCTION(vkFreeCommandBuffers);
-  LAZY_FUNCTION(vkGetDeviceQueue);
-  LAZY_FUNCTION(vkCreateSemaphore);
-  LAZY_FUNCTION(vkDestroySemaphore);
-  LAZY_FUNCTION(vkCreateImage);
-  LAZY_FUNCTION(vkDestroyImage);
-  LAZY_FUNCTION(vkCreateSwapchainKHR);
-  LAZY_FUNCTION(vkDestroySwapchainKHR);
-  LAZY_FUNCTION(vkGetSwapchainImagesKHR);
-  LAZY_FUNCTION(vkGetCalibratedTimestampsEXT);
-  LAZY_FUNCTION(vkGetImageMemoryRequirements);
-  LAZY_FUNCTION(vkGetImageSparseMemoryRequirements);
-  LAZY_FUNCTION(vkGetImageMemoryRequirements2KHR);
-  LAZY_FUNCTION(vkGetImageSubresourceLayout);
-  LAZY_FUNCTION(vkGetMemoryHostPointerPropertiesEXT);
-  LAZY_FUNCTION(vkCreateImageView);
-  LAZY_FUNCTION(vkDestroyImageView);
-  LAZY_FUNCTION(vkCreateRenderPass);
-  LAZY_FUNCTION(vkCreateRenderPass2KHR);
-  LAZY_FUNCTION(vkDestroyRenderPass);
-  LAZY_FUNCTION(vkCreatePipelineCache);
-  LAZY_FUNCTION(vkMergePipelineCaches);
-  LAZY_FUNCTION(vkGetPipelineCacheData);
-  LAZY_FUNCTION(vkDestroyPipelineCache);
-  LAZY_FUNCTION(vkCreateFramebuffer);
-  LAZY_FUNCTION(vkDestroyFramebuffer);
-  LAZY_FUNCTION(vkAllocateMemory);
-  LAZY_FUNCTION(vkFreeMemory);
-  LAZY_FUNCTION(vkBindImageMemory);
-  LAZY_FUNCTION(vkBindImageMemory2KHR);
-  LAZY_FUNCTION(vkCreateShaderModule);
-  LAZY_FUNCTION(vkDestroyShaderModule);
-  LAZY_FUNCTION(vkGetShaderInfoAMD);
-  LAZY_FUNCTION(vkCreateSampler);
-  LAZY_FUNCTION(vkCreateSamplerYcbcrConversionKHR);
-  LAZY_FUNCTION(vkDestroySampler);
-  LAZY_FUNCTION(vkCreateBuffer);
-  LAZY_FUNCTION(vkDestroyBuffer);
-  LAZY_FUNCTION(vkCreateBufferView);
-  LAZY_FUNCTION(vkDestroyBufferView);
-  LAZY_FUNCTION(vkGetBufferMemoryRequirements);
-  LAZY_FUNCTION(vkMapMemory)
-  LAZY_FUNCTION(vkUnmapMemory);
-  LAZY_FUNCTION(vkBindBufferMemory);
-  LAZY_FUNCTION(vkBindBufferMemory2);
-  LAZY_FUNCTION(vkCreateDescriptorPool);
-  LAZY_FUNCTION(vkResetDescriptorPool);
-  LAZY_FUNCTION(vkDestroyDescriptorPool);
-  LAZY_FUNCTION(vkCreateDescriptorSetLayout);
-  LAZY_FUNCTION(vkDestroyDescriptorSetLayout);
-  LAZY_FUNCTION(vkFlushMappedMemoryRanges);
-  LAZY_FUNCTION(vkInvalidateMappedMemoryRanges);
-  LAZY_FUNCTION(vkCreatePipelineLayout);
-  LAZY_FUNCTION(vkDestroyPipelineLayout);
-  LAZY_FUNCTION(vkCreateGraphicsPipelines);
-  LAZY_FUNCTION(vkCreateComputePipelines);
-  LAZY_FUNCTION(vkDestroyPipeline);
-  LAZY_FUNCTION(vkAllocateDescriptorSets);
-  LAZY_FUNCTION(vkUpdateDescriptorSets);
-  LAZY_FUNCTION(vkFreeDescriptorSets);
-  LAZY_FUNCTION(vkCreateFence);
-  LAZY_FUNCTION(vkDestroyFence);
-  LAZY_FUNCTION(vkWaitForFences);
-  LAZY_FUNCTION(vkGetFenceStatus);
-  LAZY_FUNCTION(vkResetFences);
-  LAZY_FUNCTION(vkAcquireNextImageKHR);
-  LAZY_FUNCTION(vkAcquireNextImage2KHR);
-  LAZY_FUNCTION(vkDeviceWaitIdle);
-  LAZY_FUNCTION(vkCreateQueryPool);
-  LAZY_FUNCTION(vkDestroyQueryPool);
-  LAZY_FUNCTION(vkGetQueryPoolResults);
-  LAZY_FUNCTION(vkCreateEvent);
-  LAZY_FUNCTION(vkDestroyEvent);
-  LAZY_FUNCTION(vkGetEventStatus);
-  LAZY_FUNCTION(vkSetEvent);
-  LAZY_FUNCTION(vkResetEvent);
-  LAZY_FUNCTION(vkGetRenderAreaGranularity);
-  LAZY_FUNCTION(vkGetDeviceGroupPeerMemoryFeatures);
-  LAZY_FUNCTION(vkSetDebugUtilsObjectNameEXT);
-  LAZY_FUNCTION(vkSetDebugUtilsObjectTagEXT);
-  LAZY_FUNCTION(vkCreateDescriptorUpdateTemplateKHR);
-  LAZY_FUNCTION(vkDestroyDescriptorUpdateTemplateKHR);
-  LAZY_FUNCTION(vkUpdateDescriptorSetWithTemplateKHR);
-  LAZY_FUNCTION(vkResetQueryPoolEXT);
-  LAZY_FUNCTION(vkGetPipelineExecutablePropertiesKHR);
-  LAZY_FUNCTION(vkGetPipelineExecutableStatisticsKHR);
-  LAZY_FUNCTION(vkGetPipelineExecutableInternalRepresentationsKHR);
-  LAZY_FUNCTION(vkSetHdrMetadataEXT);
-  LAZY_FUNCTION(vkWaitSemaphoresKHR);
-  LAZY_FUNCTION(vkSignalSemaphoreKHR);
-  LAZY_FUNCTION(vkGetBufferDeviceAddressKHR);
-  LAZY_FUNCTION(vkGetBufferOpaqueCaptureAddressKHR);
-  LAZY_FUNCTION(vkGetDeviceMemoryOpaqueCaptureAddressKHR);
-  LAZY_FUNCTION(vkCreatePrivateDataSlotEXT);
-  LAZY_FUNCTION(vkDestroyPrivateDataSlotEXT);
-  LAZY_FUNCTION(vkGetPrivateDataEXT);
-  LAZY_FUNCTION(vkSetPrivateDataEXT);
-#if defined _WIN32
-  LAZY_FUNCTION(vkGetMemoryWin32HandleKHR);
-  LAZY_FUNCTION(vkGetFenceWin32HandleKHR);
-  LAZY_FUNCTION(vkImportFenceWin32HandleKHR);
-#elif __linux__
-  LAZY_FUNCTION(vkGetMemoryFdKHR);
-  LAZY_FUNCTION(vkGetFenceFdKHR);
-  LAZY_FUNCTION(vkImportFenceFdKHR);
-#endif
-#undef LAZY_FUNCTION
+#define FUNCTION(function) EagerDeviceFunction<PFN_##function> function;
+#define VULKAN_DEVICE_FUNCTIONS
+#include "vulkan_wrapper/function_tables.inc"
+#undef FUNCTION
 };
 
 }  // namespace vulkan
@@ -30,13 +30,17 @@
 namespace vulkan {
 
 // VkInstance wraps a native vulkan VkInstance handle. It provides
-// lazily initialized function pointers for all of its initialization
-// methods. It will automatically call VkDestroyInstance when it
+// function pointers for all of its methods, which are resolved when it is
+// created. It will automatically call VkDestroyInstance when it
 // goes out of scope.
 class VkInstance {
  public:
+  // enabled_extensions should be the extensions the instance was created
+  // with, only their functions are resolved.
   VkInstance(containers::Allocator* container_allocator, ::VkInstance instance,
-             VkAllocationCallbacks* allocator, LibraryWrapper* wrapper)
+             VkAllocationCallbacks* allocator, LibraryWrapper* wrapper,
+             uint32_t num_enabled_extensions = 0,
+             const char* const* enabled_extensions = nullptr)
       : instance_(instance),
         has_allocator_(allocator != nullptr),
         wrapper_(wrapper) {
@@ -46,10 +50,9 @@ class VkInstance {
       memset(&allocator_, 0, sizeof(allocator_));
     }
     functions_ = containers::make_unique<InstanceFunctions>(
-        container_allocator, instance_, getProcAddrFunction(),
-        wrapper_->GetLogger());
-    // functions_.reset(new InstanceFunctions(instance_, getProcAddrFunction(),
-    // wrapper_->GetLogger()));
+        container_allocator, container_allocator, instance_,
+        getProcAddrFunction(), wrapper_->GetLogger(), num_enabled_extensions,
+        enabled_extensions);
   }
 
   VkInstance(VkInstance&& other)
@@ -16,44 +16,145 @@
 #ifndef VULKAN_WRAPPER_LAZY_FUNCTION_H_
 #define VULKAN_WRAPPER_LAZY_FUNCTION_H_
 
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+#include "support/log/log.h"
+#include "vulkan_wrapper/call_stats.h"
+
 // This wraps a lazily initialized function pointer. It will be resolved
-// when it is first called.
+// when it is first called. This is used for the global functions of the
+// library, which can be resolved before there is an instance, so that only
+// the ones that are used are resolved.
+// Resolving is thread-safe: if several threads make the first call at the
+// same time, they all resolve the function, and store the same pointer.
 template <typename T, typename HANDLE, typename WRAPPER>
 class LazyFunction {
  public:
   // We retain a reference to the function name, so it must remain valid.
   // In practice this is expected to be used with string constants.
   LazyFunction(HANDLE handle, const char* function_name, WRAPPER* wrapper)
-      : handle_(handle), function_name_(function_name), wrapper_(wrapper) {}
+      : handle_(handle),
+        function_name_(function_name),
+        wrapper_(wrapper),
+        ptr_(nullptr)
+#if defined(VULKAN_CALL_PROFILING)
+        ,
+        stats_id_(vulkan::call_stats::Register(function_name))
+#endif
+  {
+  }
+
+  LazyFunction(const LazyFunction&) = delete;
+  LazyFunction& operator=(const LazyFunction&) = delete;
 
   // When this functor is called, it will check if the function pointer
   // has been resolved. If not it will resolve it and then call the function.
   // If it could not be resolved, the program will segfault.
   template <typename... Args>
-  typename std::result_of<T(Args...)>::type operator()(const Args&... args);
+  typename std::result_of<T(Args...)>::type operator()(const Args&... args) {
+    T ptr = ptr_.load(std::memory_order_acquire);
+    if (!ptr) {
+      ptr = Resolve();
+    }
+#if defined(VULKAN_CALL_PROFILING)
+    vulkan::call_stats::CallTimer timer(stats_id_);
+#endif
+    return ptr(args...);
+  }
 
  private:
+  T Resolve();
+
   HANDLE handle_;
   const char* function_name_;
   WRAPPER* wrapper_;
-  T ptr_ = nullptr;
+  std::atomic<T> ptr_;
+#if defined(VULKAN_CALL_PROFILING)
+  uint32_t stats_id_;
+#endif
 };
 
 template <typename T, typename HANDLE, typename WRAPPER>
-template <typename... Args>
-typename std::result_of<T(Args...)>::type LazyFunction<T, HANDLE, WRAPPER>::
-operator()(const Args&... args) {
-  if (!ptr_) {
-    ptr_ = reinterpret_cast<T>(wrapper_->getProcAddr(handle_, function_name_));
-    if (ptr_) {
-      wrapper_->GetLogger()->LogInfo(function_name_, " for instance ", handle_,
-                                     " resolved");
-    } else {
-      wrapper_->GetLogger()->LogError(function_name_, " for instance ", handle_,
-                                      " could not be resolved, crashing now");
-    }
+T LazyFunction<T, HANDLE, WRAPPER>::Resolve() {
+  T ptr = reinterpret_cast<T>(wrapper_->getProcAddr(handle_, function_name_));
+  if (ptr) {
+    LOG_DEBUG(wrapper_->GetLogger(), function_name_, " for instance ",
+              handle_, " resolved");
+  } else {
+    wrapper_->GetLogger()->LogError(function_name_, " for instance ", handle_,
+                                    " could not be resolved, crashing now");
   }
-  return ptr_(args...);
+  ptr_.store(ptr, std::memory_order_release);
+  return ptr;
 }
 
+// This wraps a function pointer that is resolved up front, so that calling
+// it is a single indirect call. The function tables resolve the functions of
+// the core versions and of the enabled extensions right after the instance or
+// device is created, and leave the functions of other extensions unresolved.
+// Calling a function that was not resolved logs its name and crashes.
+template <typename T, typename HANDLE, typename WRAPPER>
+class EagerFunction {
+ public:
+  EagerFunction()
+      : ptr_(nullptr),
+        function_name_(nullptr),
+        log_(nullptr)
+#if defined(VULKAN_CALL_PROFILING)
+        ,
+        stats_id_(vulkan::call_stats::kMaxFunctions)
+#endif
+  {
+  }
+
+  EagerFunction(const EagerFunction&) = delete;
+  EagerFunction& operator=(const EagerFunction&) = delete;
+
+  // The wrapper must already be able to resolve functions.
+  void Resolve(HANDLE handle, const char* function_name, WRAPPER* wrapper) {
+    ptr_ = reinterpret_cast<T>(wrapper->getProcAddr(handle, function_name));
+    function_name_ = function_name;
+    log_ = wrapper->GetLogger();
+    if (!ptr_) {
+      LOG_DEBUG(wrapper->GetLogger(), function_name, " for instance ", handle,
+                " is not available");
+    }
+#if defined(VULKAN_CALL_PROFILING)
+    stats_id_ = vulkan::call_stats::Register(function_name);
+#endif
+  }
+
+  template <typename... Args>
+  typename std::result_of<T(Args...)>::type operator()(
+      const Args&... args) const {
+    if (!ptr_) {
+      CrashUnresolved();
+    }
+#if defined(VULKAN_CALL_PROFILING)
+    vulkan::call_stats::CallTimer timer(stats_id_);
+#endif
+    return ptr_(args...);
+  }
+
+ private:
+  void CrashUnresolved() const {
+    if (log_) {
+      log_->LogError(function_name_,
+                     " was called, but it is not available. Is its "
+                     "extension or core version enabled?");
+      LOG_CRASH(log_, "Called a function that was not resolved");
+    }
+    *reinterpret_cast<volatile int*>(intptr_t(0)) = 4;
+  }
+
+  T ptr_;
+  const char* function_name_;
+  logging::Logger* log_;
+#if defined(VULKAN_CALL_PROFILING)
+  uint32_t stats_id_;
+#endif
+};
+
 #endif  //  VULKAN_WRAPPER_LAZY_FUNCTION_H_
\ No newline at end of file
@@ -36,9 +36,8 @@ class LibraryWrapper {
   LibraryWrapper(containers::Allocator* allocator, logging::Logger* logger);
   bool is_valid() { return vulkan_lib_ && vulkan_lib_->is_valid(); }
 
-#define LAZY_FUNCTION(function)                   \
-  LazyLibraryFunction<PFN_##function> function = \
-      LazyLibraryFunction<PFN_##function>(nullptr, #function, this)
+#define LAZY_FUNCTION(function) \
+  LazyLibraryFunction<PFN_##function> function{nullptr, #function, this}
   LAZY_FUNCTION(vkCreateInstance);
   LAZY_FUNCTION(vkEnumerateInstanceExtensionProperties);
   LAZY_FUNCTION(vkEnumerateInstanceLayerProperties);
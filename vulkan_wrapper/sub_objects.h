@@ -30,7 +30,7 @@ namespace vulkan {
 // struct FooTraits {
 //   using type = VulkanType;
 //   using destruction_function_pointer_type =
-//     Lazy{Instance|Device|..}Function<PFN_vkDestroyVulkanType>;
+//     Eager{Instance|Device}Function<PFN_vkDestroyVulkanType>;
 //   static destruction_function_pointer_type* get_destruction_function(
 //       {Device|Instance|...}Functions* functions) {
 //     return &functions->vkDestroyVulkanType;
@@ -142,7 +142,7 @@ struct DeviceTraits {
 struct CommandPoolTraits {
   using type = ::VkCommandPool;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyCommandPool>*;
+      EagerDeviceFunction<PFN_vkDestroyCommandPool>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyCommandPool;
@@ -153,7 +153,7 @@ using VkCommandPool = VkSubObject<CommandPoolTraits, DeviceTraits>;
 struct DescriptorPoolTraits {
   using type = ::VkDescriptorPool;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyDescriptorPool>*;
+      EagerDeviceFunction<PFN_vkDestroyDescriptorPool>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyDescriptorPool;
@@ -164,7 +164,7 @@ using VkDescriptorPool = VkSubObject<DescriptorPoolTraits, DeviceTraits>;
 struct DescriptorSetLayoutTraits {
   using type = ::VkDescriptorSetLayout;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyDescriptorSetLayout>*;
+      EagerDeviceFunction<PFN_vkDestroyDescriptorSetLayout>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyDescriptorSetLayout;
@@ -176,7 +176,7 @@ using VkDescriptorSetLayout =
 struct SurfaceTraits {
   using type = ::VkSurfaceKHR;
   using destruction_function_pointer_type =
-      LazyInstanceFunction<PFN_vkDestroySurfaceKHR>*;
+      EagerInstanceFunction<PFN_vkDestroySurfaceKHR>*;
   static destruction_function_pointer_type get_destruction_function(
       InstanceFunctions* functions) {
     return &functions->vkDestroySurfaceKHR;
@@ -187,7 +187,7 @@ using VkSurfaceKHR = VkSubObject<SurfaceTraits, InstanceTraits>;
 struct ImageTraits {
   using type = ::VkImage;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyImage>*;
+      EagerDeviceFunction<PFN_vkDestroyImage>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyImage;
@@ -198,7 +198,7 @@ using VkImage = VkSubObject<ImageTraits, DeviceTraits>;
 struct FenceTraits {
   using type = ::VkFence;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyFence>*;
+      EagerDeviceFunction<PFN_vkDestroyFence>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyFence;
@@ -209,7 +209,7 @@ using VkFence = VkSubObject<FenceTraits, DeviceTraits>;
 struct EventTraits {
   using type = ::VkEvent;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyEvent>*;
+      EagerDeviceFunction<PFN_vkDestroyEvent>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyEvent;
@@ -220,7 +220,7 @@ using VkEvent = VkSubObject<EventTraits, DeviceTraits>;
 struct ImageViewTraits {
   using type = ::VkImageView;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyImageView>*;
+      EagerDeviceFunction<PFN_vkDestroyImageView>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyImageView;
@@ -231,7 +231,7 @@ using VkImageView = VkSubObject<ImageViewTraits, DeviceTraits>;
 struct SamplerTraits {
   using type = ::VkSampler;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroySampler>*;
+      EagerDeviceFunction<PFN_vkDestroySampler>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroySampler;
@@ -242,7 +242,7 @@ using VkSampler = VkSubObject<SamplerTraits, DeviceTraits>;
 struct RenderPassTraits {
   using type = ::VkRenderPass;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyRenderPass>*;
+      EagerDeviceFunction<PFN_vkDestroyRenderPass>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyRenderPass;
@@ -253,7 +253,7 @@ using VkRenderPass = VkSubObject<RenderPassTraits, DeviceTraits>;
 struct FramebufferTraits {
   using type = ::VkFramebuffer;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyFramebuffer>*;
+      EagerDeviceFunction<PFN_vkDestroyFramebuffer>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyFramebuffer;
@@ -264,7 +264,7 @@ using VkFramebuffer = VkSubObject<FramebufferTraits, DeviceTraits>;
 struct SemaphoreTraits {
   using type = ::VkSemaphore;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroySemaphore>*;
+      EagerDeviceFunction<PFN_vkDestroySemaphore>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroySemaphore;
@@ -275,7 +275,7 @@ using VkSemaphore = VkSubObject<SemaphoreTraits, DeviceTraits>;
 struct PipelineCacheTraits {
   using type = ::VkPipelineCache;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyPipelineCache>*;
+      EagerDeviceFunction<PFN_vkDestroyPipelineCache>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyPipelineCache;
@@ -286,7 +286,7 @@ using VkPipelineCache = VkSubObject<PipelineCacheTraits, DeviceTraits>;
 struct PipelineLayoutTraits {
   using type = ::VkPipelineLayout;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyPipelineLayout>*;
+      EagerDeviceFunction<PFN_vkDestroyPipelineLayout>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyPipelineLayout;
@@ -297,7 +297,7 @@ using VkPipelineLayout = VkSubObject<PipelineLayoutTraits, DeviceTraits>;
 struct PipelineTraits {
   using type = ::VkPipeline;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyPipeline>*;
+      EagerDeviceFunction<PFN_vkDestroyPipeline>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyPipeline;
@@ -308,7 +308,7 @@ using VkPipeline = VkSubObject<PipelineTraits, DeviceTraits>;
 struct DeviceMemoryTraits {
   using type = ::VkDeviceMemory;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkFreeMemory>*;
+      EagerDeviceFunction<PFN_vkFreeMemory>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkFreeMemory;
@@ -319,7 +319,7 @@ using VkDeviceMemory = VkSubObject<DeviceMemoryTraits, DeviceTraits>;
 struct ShaderModuleTraits {
   using type = ::VkShaderModule;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyShaderModule>*;
+      EagerDeviceFunction<PFN_vkDestroyShaderModule>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyShaderModule;
@@ -331,7 +331,7 @@ using VkShaderModule = VkSubObject<ShaderModuleTraits, DeviceTraits>;
 struct BufferTraits {
   using type = ::VkBuffer;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyBuffer>*;
+      EagerDeviceFunction<PFN_vkDestroyBuffer>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyBuffer;
@@ -342,7 +342,7 @@ using VkBuffer = VkSubObject<BufferTraits, DeviceTraits>;
 struct BufferViewTraits {
   using type = ::VkBufferView;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyBufferView>*;
+      EagerDeviceFunction<PFN_vkDestroyBufferView>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyBufferView;
@@ -353,7 +353,7 @@ using VkBufferView = VkSubObject<BufferViewTraits, DeviceTraits>;
 struct QueryPoolTraits {
   using type = ::VkQueryPool;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyQueryPool>*;
+      EagerDeviceFunction<PFN_vkDestroyQueryPool>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyQueryPool;
@@ -364,7 +364,7 @@ using VkQueryPool = VkSubObject<QueryPoolTraits, DeviceTraits>;
 struct DescriptorUpdateTemplateTraits {
   using type = ::VkDescriptorUpdateTemplate;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroyDescriptorUpdateTemplateKHR>*;
+      EagerDeviceFunction<PFN_vkDestroyDescriptorUpdateTemplateKHR>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroyDescriptorUpdateTemplateKHR;
@@ -22,7 +22,7 @@ namespace vulkan {
 struct SwapchainTraits {
   using type = ::VkSwapchainKHR;
   using destruction_function_pointer_type =
-      LazyDeviceFunction<PFN_vkDestroySwapchainKHR>*;
+      EagerDeviceFunction<PFN_vkDestroySwapchainKHR>*;
   static destruction_function_pointer_type get_destruction_function(
       DeviceFunctions* functions) {
     return &functions->vkDestroySwapchainKHR;